@@ -24,6 +24,7 @@ ParamWithoutSection = yes
 ParamWithSection = 123456
 
 confreader supports comments at the end of lines, after the parameter value. The comment must be separated by at least one space character.
+A value in double quotes may contain spaces at the ends, comment characters and C-style escape sequences.
 
 Usage:
 1 - Read content into mem and then parse it.
@@ -35,6 +36,53 @@ Usage:
 #ifndef __CONFREADER_H_
 #define __CONFREADER_H_
 
+// mkstemp(), fchmod(), syscall() and MAP_ANONYMOUS are not in ISO C, with -std=c99 they are declared only with
+// a feature-test macro. It works if confreader.h is included before the system headers, otherwise define it for
+// the compiler.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Needed for the network addresses.
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+// Needed for writing the file.
+#include <sys/uio.h>
+#include <errno.h>
+
+// The environment variables for confreaderApplyOverrides().
+extern char **environ;
+
+// Needed for the NUMA replicas.
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS		MAP_ANON
+#endif
+
+#define CONFREADER_MAX_NODES		1024	// The largest number of NUMA nodes for confreaderReplicate().
+#define CONFREADER_MPOL_BIND		2		// MPOL_BIND of mbind(), without libnuma.
+#define CONFREADER_NODE_CHECK		64		// Lookups of a thread between the reads of its CPU.
+
+// The static tracepoints for perf and bpftrace are compiled in with -DCONFREADER_USDT, and need sys/sdt.h of SystemTap.
+#ifndef CONFREADER_PROBE
+#ifdef CONFREADER_USDT
+#include <sys/sdt.h>
+#define CONFREADER_PROBE(...)		STAP_PROBEV(confreader, __VA_ARGS__)
+#else
+#define CONFREADER_PROBE(...)
+#endif
+#endif
+
 #define CONFREADER_OK				0
 #define CONFREADER_ERROR			-1
 
@@ -45,29 +93,270 @@ Usage:
 #define CONFREADER_EINVVAL			5
 #define CONFREADER_EBUSY			6
 #define CONFREADER_ENOMEM			7
+#define CONFREADER_EENCODING		8
+#define CONFREADER_EWRITEFILE		9
+
+// Options of the parsing.
+#define CONFREADER_OPT_CHECK_UTF8	1		// Fail on bytes which are not valid UTF-8.
+#define CONFREADER_OPT_ALL_ERRORS	2		// Don't stop at the first error, collect all of them into confreaderDiags.
+#define CONFREADER_OPT_RECORD_ACCESS	4	// Count the reads of each parameter for confreaderSaveProfile().
+#define CONFREADER_OPT_LOOKUP_CACHE	8	// Remember the lookups of each thread by the pointers of the names.
+
+#define CONFREADER_LOOKUP_CACHE_SIZE	64	// Entries of the lookup cache of a thread, a power of two.
+
+// Kinds of the errors in the diagnostics.
+#define CONFREADER_DIAG_CR			1		// Carriage return is not followed by line feed.
+#define CONFREADER_DIAG_SECTION		2		// No closing bracket of the section name.
+#define CONFREADER_DIAG_JUNK		3		// Something else than a comment after the section name or the quoted value.
+#define CONFREADER_DIAG_NOVALUE		4		// The parameter has no value.
+#define CONFREADER_DIAG_COMMENT		5		// The comment is not separated from the value by a space.
+#define CONFREADER_DIAG_QUOTE		6		// No closing quote.
+#define CONFREADER_DIAG_HEREDOC		7		// No line with the closing tag of the block.
+#define CONFREADER_DIAG_UTF8		8		// Not valid UTF-8.
+#define CONFREADER_DIAG_UNKNOWN_SECTION	9	// The section is not in the schema.
+#define CONFREADER_DIAG_UNKNOWN_KEY	10		// The parameter is not in the schema.
+#define CONFREADER_DIAG_MISSING_KEY	11		// The required parameter is not in the file.
+#define CONFREADER_DIAG_TYPE		12		// The value can't be converted to the type from the schema.
+#define CONFREADER_DIAG_RANGE		13		// The value is out of the range from the schema.
+#define CONFREADER_DIAG_PATTERN		14		// The value doesn't match the pattern from the schema.
+
+// Types of the values in the schema.
+#define CONFREADER_TYPE_STRING		0
+#define CONFREADER_TYPE_INT			1
+#define CONFREADER_TYPE_DOUBLE		2
+#define CONFREADER_TYPE_BOOL		3
+#define CONFREADER_TYPE_DURATION	4
+#define CONFREADER_TYPE_BYTES		5
+#define CONFREADER_TYPE_IPADDR		6
+#define CONFREADER_TYPE_ENDPOINT	7
+
+// Flags of the schema entry.
+#define CONFREADER_SCHEMA_REQUIRED	1
+#define CONFREADER_SCHEMA_RANGE		2		// Check min and max. For strings it is the length.
+
+// Types of the converted values cached on the parameter.
+#define CONFREADER_CACHE_NONE		0
+#define CONFREADER_CACHE_DURATION	1
+#define CONFREADER_CACHE_BYTES		2
+#define CONFREADER_CACHE_RATE		3
+#define CONFREADER_CACHE_ENUM		4
+#define CONFREADER_CACHE_IPADDR		5
+#define CONFREADER_CACHE_ENDPOINT	6
+#define CONFREADER_CACHE_CIDRLIST	7
+#define CONFREADER_CACHE_INTARRAY	8
+#define CONFREADER_CACHE_DOUBLEARRAY	9
+#define CONFREADER_CACHE_BUSY		-1
+
+// Flags of the parameter.
+#define CONFREADER_PARAM_ESCAPED	1		// The quoted value has escape sequences which are not decoded yet.
+#define CONFREADER_PARAM_BUSY		2		// A reader is decoding the value.
+
+typedef struct confreader_cache {
+	int type;				// CONFREADER_CACHE_... , set last so that readers never see a half-written value.
+	int chainLock;			// Taken by the reader that adds an entry to next.
+	const void *tag;		// What the value was converted with, e.g. the enum names table.
+	union {
+		long long i;
+		double d;
+		void *p;			// Allocated in the arena.
+	} v;
+	struct confreader_cache *next;	// The values of the other types, see confreader_chainClaim().
+} ConfreaderCache;
 
 typedef struct confreader_param {
 	char *key;
 	char *value;
+	int flags;				// CONFREADER_PARAM_...
+	int lineNum;
+	int valueStart;			// The value in the file with the quotes or the whole block, for confreaderPatchFile().
+	int valueEnd;
+	int hits;				// Reads counted with CONFREADER_OPT_RECORD_ACCESS.
+	ConfreaderCache cache;
 } ConfreaderParam;
 
+// What the readers change in a parameter of the frozen file, kept out of the read-only memory.
+typedef struct confreader_param_state {
+	ConfreaderCache cache;
+	int hits;
+} ConfreaderParamState;
+
 typedef struct confreader_section {
 	int size;
+	int hits;				// Reads of the parameters of the section in the profile.
 	char *name;
 	ConfreaderParam *params;
+	int lineNum;
+	unsigned int bloomMask;		// Number of bits of the Bloom filter of the keys minus one.
+	unsigned long long *bloom;	// NULL if there is no filter.
+	unsigned long long hash;	// The names and the values of the section in the file, for sectionFingerprint().
 } ConfreaderSection;
 
+// A part of the file replaced by confreaderPatchFile().
+typedef struct confreader_edit {
+	int start;
+	int end;
+	const char *text;
+	int len;
+	int seq;				// Order of the change, for the lines inserted at the same place.
+} ConfreaderEdit;
+
+// The number of reads of a parameter in the profile.
+typedef struct confreader_profile_entry {
+	const char *section;	// NULL for the parameters without section.
+	const char *key;
+	int hits;
+} ConfreaderProfileEntry;
+
+// A parameter in the hash table of the environment variable names.
+typedef struct confreader_env_slot {
+	ConfreaderParam *param;
+	const char *section;	// NULL for the parameters without section.
+} ConfreaderEnvSlot;
+
+// The copy of the parsed file in the memory of a NUMA node.
+typedef struct confreader_replica {
+	ConfreaderSection *sects;		// NULL if the node is not online.
+	void *mem;
+	size_t memSize;
+} ConfreaderReplica;
+
+// A lookup remembered by confreader_cachedLookup().
+typedef struct confreader_lookup_slot {
+	const char *key;
+	const char *section;
+	unsigned long long generation;	// 0 if the slot is empty.
+	ConfreaderParam *param;		// NULL if the parameter is not found.
+} ConfreaderLookupSlot;
+
+typedef struct confreader_enum_name {
+	const char *name;
+	int value;
+} ConfreaderEnumName;
+
+typedef struct confreader_unit {
+	const char *suffix;
+	long long mul;
+} ConfreaderUnit;
+
+// Memory for the converted values. Blocks are freed all together by confreaderClear().
+typedef struct confreader_arena_block {
+	struct confreader_arena_block *next;
+	size_t size;
+	size_t used;
+} ConfreaderArenaBlock;
+
+typedef struct confreader_ip_addr {
+	int family;					// AF_INET or AF_INET6.
+	unsigned char addr[16];		// Network byte order, the first 4 bytes for AF_INET.
+} ConfreaderIpAddr;
+
+typedef struct confreader_endpoint {
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} addr;
+	socklen_t len;				// Size of the address to pass to bind() or connect().
+} ConfreaderEndpoint;
+
+// Prefixes compiled into a binary trie, one for IPv4 and one for IPv6.
+// Node 0 is not used, so a child equal to 0 means there is no child.
+typedef struct confreader_cidr_node {
+	int child[2];
+	int match;					// A prefix ends at this node.
+} ConfreaderCidrNode;
+
+typedef struct confreader_cidr_list {
+	int count;					// Number of prefixes in the list.
+	int root4;
+	int root6;
+	ConfreaderCidrNode *nodes;
+} ConfreaderCidrList;
+
+typedef struct confreader_diagnostic {
+	int lineNum;				// 0 if the error is not on a line, e.g. a missing parameter.
+	int colNum;					// Counted in UTF-8 characters from 1, 0 for the schema errors.
+	int kind;					// CONFREADER_DIAG_...
+	const char *name;			// The parameter or section of a schema error.
+} ConfreaderDiagnostic;
+
+// A section with key NULL allows any parameters in the section.
+typedef struct confreader_schema_entry {
+	const char *section;		// NULL for the parameters without section.
+	const char *key;
+	int type;					// CONFREADER_TYPE_...
+	int flags;					// CONFREADER_SCHEMA_...
+	double min;
+	double max;
+	const char *pattern;		// Shell-style pattern of the value with *, ? and [...], or NULL.
+} ConfreaderSchemaEntry;
+
+// The old name of a parameter which is read as the new one.
+typedef struct confreader_alias {
+	const char *section;		// NULL for all sections, also for the parameters without section.
+	const char *oldKey;
+	const char *key;
+} ConfreaderAlias;
+
+typedef struct confreader_change {
+	const char *section;		// NULL for the parameters without section.
+	const char *key;
+	const char *value;			// NULL removes the parameter.
+} ConfreaderChange;
+
 
 char *confreader_fileBuf = NULL;
+int confreader_fileSize;
 
 int *confreader_lines;
+int *confreader_lineEnds;			// Index of the line feed of each line.
 int confreader_lineCount;
+int confreader_bomSize;			// The byte order mark at the beginning of the file is replaced with spaces.
 
 ConfreaderParam *confreader_params;
 int confreader_paramCount;
 
+ConfreaderArenaBlock *confreader_arena = NULL;
+int confreader_arenaLock = 0;
+
+int confreader_diagCap;
+
+// Set by confreaderSetAliases(), not changed by confreaderInit().
+const ConfreaderAlias *confreader_aliases = NULL;
+int confreader_aliasCount = 0;
+int *confreader_aliasSlots = NULL;		// Hash table of the old names, indices of confreader_aliases or -1.
+unsigned int confreader_aliasMask = 0;
+
+unsigned long long *confreader_blooms;	// The filters of all sections in one block.
+
+unsigned long long confreader_fingerprint;	// The hash of the file, 0 if no file is parsed.
+
+// Set by confreaderSetProfile(), not changed by confreaderInit().
+char *confreader_profileBuf = NULL;			// The profile file, the names of the entries point into it.
+ConfreaderProfileEntry *confreader_profile = NULL;
+int confreader_profileCount = 0;
+int *confreader_profileSlots = NULL;			// Hash table of the entries, indices of confreader_profile or -1.
+unsigned int confreader_profileMask = 0;
+
+ConfreaderReplica *confreader_replicas = NULL;	// Indexed by the node, NULL if the file is not replicated.
+int confreader_replicaCount = 0;
+int *confreader_cpuNodes = NULL;			// The node of each CPU.
+int confreader_cpuCount = 0;
+
+unsigned long long confreader_generation = 1;	// Changed with the parameters, for the lookup cache. Not reset by confreaderInit().
+
+void *confreader_frozen = NULL;			// The read-only block of the parsed data after confreaderFreeze(), NULL before.
+size_t confreader_frozenSize;
+ConfreaderParam *confreader_frozenParams;		// All the parameters in the block, in the order of the sections.
+ConfreaderParamState *confreader_states = NULL;	// The caches and the counters of the frozen parameters.
+
 int confreaderErrorNum;
 int confreaderErrorLineNum;
+int confreaderErrorColNum;			// Counted in UTF-8 characters from 1.
+int confreaderOptions = 0;			// CONFREADER_OPT_... , set before confreaderParseFile().
+ConfreaderDiagnostic *confreaderDiags;			// All the errors sorted by line, if CONFREADER_OPT_ALL_ERRORS is set.
+int confreaderDiagCount;
+int confreaderDeprecatedHits;			// The old names of the parameters found in the file and read by the get functions.
 ConfreaderSection *confreaderSects;
 int confreaderSectCount;
 
@@ -76,12 +365,159 @@ void confreaderInit(){
 	confreaderSects = NULL;
 	confreader_params = NULL;
 	confreader_lines = NULL;
+	confreader_lineEnds = NULL;
 	confreader_fileBuf = NULL;
+	confreader_arena = NULL;
+	confreader_arenaLock = 0;
+	confreader_fileSize = 0;
+	confreader_bomSize = 0;
+	confreader_blooms = NULL;
+	confreader_fingerprint = 0;
+	confreader_frozen = NULL;
+	confreader_frozenSize = 0;
+	confreader_frozenParams = NULL;
+	confreader_states = NULL;
 	confreaderErrorNum = 0;
 	confreaderErrorLineNum = 0;
+	confreaderErrorColNum = 0;
+	confreaderDiags = NULL;
+	confreaderDiagCount = 0;
+	confreader_diagCap = 0;
+	confreaderDeprecatedHits = 0;
+}
+
+// Allocates size bytes aligned to 16 from the arena. Readers may call it concurrently.
+void * confreader_alloc(size_t size){
+	ConfreaderArenaBlock *block;
+	void *ptr;
+	size_t blockSize;
+
+	size = (size + 15) & ~(size_t)15;
+	while(__atomic_exchange_n(&confreader_arenaLock, 1, __ATOMIC_ACQUIRE)){
+	}
+	if(confreader_arena == NULL || confreader_arena->size - confreader_arena->used < size){
+		blockSize = size > 16384 ? size : 16384;
+		block = (ConfreaderArenaBlock *)malloc(sizeof(ConfreaderArenaBlock) + 16 + blockSize);
+		if(block == NULL){
+			__atomic_store_n(&confreader_arenaLock, 0, __ATOMIC_RELEASE);
+			return NULL;
+		}
+		block->next = confreader_arena;
+		block->size = blockSize;
+		block->used = 0;
+		confreader_arena = block;
+	}
+	// The data starts at the first 16-byte boundary after the block header.
+	ptr = (char *)(((size_t)(confreader_arena + 1) + 15) & ~(size_t)15) + confreader_arena->used;
+	confreader_arena->used += size;
+	__atomic_store_n(&confreader_arenaLock, 0, __ATOMIC_RELEASE);
+	return ptr;
+}
+
+void confreader_freeArena(){
+	ConfreaderArenaBlock *block;
+
+	while(confreader_arena){
+		block = confreader_arena;
+		confreader_arena = block->next;
+		free(block);
+	}
+}
+
+// Reads a list of numbers like "0-3,8-11" from the file into set, up to max. Returns the largest number plus one or -1.
+int confreader_readList(const char *path, unsigned char *set, int max){
+	char text[4096];
+	ssize_t size;
+	int fd, first, last, end = 0;
+	char *s;
+
+	if((fd = open(path, O_RDONLY)) == -1) return -1;
+	size = read(fd, text, sizeof(text) - 1);
+	close(fd);
+	if(size <= 0) return -1;
+	text[size] = 0;
+
+	for(s=text; *s >= '0' && *s <= '9'; ){
+		first = last = strtol(s, &s, 10);
+		if(*s == '-') last = strtol(s + 1, &s, 10);
+		for(; first <= last; first++){
+			if(set && first < max) set[first] = 1;
+		}
+		if(last + 1 > end) end = last + 1;
+		if(*s == ',') s++;
+	}
+	return end;
+}
+
+// The NUMA node of the CPU the thread runs on. The CPU is remembered by the thread and read again
+// every CONFREADER_NODE_CHECK lookups, since the thread may be moved to another one.
+int confreader_currentNode(){
+	static __thread unsigned int calls = 0;
+	static __thread int cpu = -1;
+	unsigned int c;
+
+	if(calls++ % CONFREADER_NODE_CHECK == 0){
+#ifdef _GNU_SOURCE
+		cpu = sched_getcpu();
+		(void)c;
+#else
+		cpu = syscall(SYS_getcpu, &c, NULL, NULL) == 0 ? (int)c : -1;
+#endif
+	}
+	return cpu >= 0 && cpu < confreader_cpuCount ? confreader_cpuNodes[cpu] : 0;
+}
+
+// Moves a pointer into the file buffer to the same place in the copy of the buffer.
+char * confreader_rebase(char *ptr, char *buf){
+	return ptr >= confreader_fileBuf && ptr <= confreader_fileBuf + confreader_fileSize ? buf + (ptr - confreader_fileBuf) : ptr;
+}
+
+// The cache of the converted value of the parameter.
+ConfreaderCache * confreader_cacheOf(ConfreaderParam *p){
+	return confreader_states ? &confreader_states[p - confreader_frozenParams].cache : &p->cache;
+}
+
+// The counter of the reads of the parameter.
+int * confreader_hitsOf(ConfreaderParam *p){
+	return confreader_states ? &confreader_states[p - confreader_frozenParams].hits : &p->hits;
+}
+
+// The parameters are changed, so the lookups cached by the threads are not valid any more.
+void confreader_changed(){
+	__atomic_add_fetch(&confreader_generation, 1, __ATOMIC_RELAXED);
+}
+
+void confreader_freeReplicas(){
+	int i;
+
+	if(confreader_replicas){
+		for(i=0; i<confreader_replicaCount; i++){
+			if(confreader_replicas[i].mem) munmap(confreader_replicas[i].mem, confreader_replicas[i].memSize);
+		}
+		free(confreader_replicas);
+		confreader_replicas = NULL;
+	}
+	confreader_replicaCount = 0;
+	if(confreader_cpuNodes){
+		free(confreader_cpuNodes);
+		confreader_cpuNodes = NULL;
+	}
+	confreader_cpuCount = 0;
+	confreader_changed();
 }
 
 void confreaderClear(){
+	confreader_freeReplicas();
+	if(confreader_frozen){
+		// The sections and the file are in the block.
+		munmap(confreader_frozen, confreader_frozenSize);
+		confreader_frozen = NULL;
+		confreader_frozenParams = NULL;
+		confreaderSects = NULL;
+		confreader_fileBuf = NULL;
+		free(confreader_states);
+		confreader_states = NULL;
+	}
 	confreaderSectCount = 0;
 	if(confreaderSects){
 		free(confreaderSects);
@@ -95,164 +531,918 @@ void confreaderClear(){
 		free(confreader_lines);
 		confreader_lines = NULL;
 	}
+	if(confreader_lineEnds){
+		free(confreader_lineEnds);
+		confreader_lineEnds = NULL;
+	}
 	if(confreader_fileBuf){
 		free(confreader_fileBuf);
 		confreader_fileBuf = NULL;
 	}
+	if(confreader_blooms){
+		free(confreader_blooms);
+		confreader_blooms = NULL;
+	}
+	if(confreaderDiags){
+		free(confreaderDiags);
+		confreaderDiags = NULL;
+	}
+	confreaderDiagCount = 0;
+	confreader_diagCap = 0;
+	confreaderDeprecatedHits = 0;
+	confreader_fingerprint = 0;
+	confreader_freeArena();
 }
 
-int confreaderParseFile(const char *filename){
-	int fd, i;
-	int lineIdx, sectIdx, paramIdx;
-	ssize_t fileBufSize;
-	struct stat file_status;
-	
-	confreaderErrorLineNum = 0;
+const char * confreaderDiagMessage(int kind){
+	switch(kind){
+		case CONFREADER_DIAG_CR:		return "carriage return without line feed";
+		case CONFREADER_DIAG_SECTION:	return "no closing bracket of the section name";
+		case CONFREADER_DIAG_JUNK:		return "unexpected characters at the end of the line";
+		case CONFREADER_DIAG_NOVALUE:	return "no value of the parameter";
+		case CONFREADER_DIAG_COMMENT:	return "comment is not separated from the value by a space";
+		case CONFREADER_DIAG_QUOTE:		return "no closing quote";
+		case CONFREADER_DIAG_HEREDOC:	return "no line with the closing tag";
+		case CONFREADER_DIAG_UTF8:		return "invalid UTF-8";
+		case CONFREADER_DIAG_UNKNOWN_SECTION:	return "unknown section";
+		case CONFREADER_DIAG_UNKNOWN_KEY:	return "unknown parameter";
+		case CONFREADER_DIAG_MISSING_KEY:	return "missing required parameter";
+		case CONFREADER_DIAG_TYPE:		return "wrong type of the value";
+		case CONFREADER_DIAG_RANGE:		return "value is out of range";
+		case CONFREADER_DIAG_PATTERN:	return "value doesn't match the pattern";
+	}
+	return "unknown error";
+}
 
-	if(confreader_fileBuf){
-		confreaderErrorNum = CONFREADER_EBUSY;
-		return CONFREADER_ERROR;
+// Returns the column of the character at pos in the line, counted in UTF-8 characters from 1.
+int confreader_column(int lineIdx, int pos){
+	int i, col = 1;
+
+	i = lineIdx == 0 ? confreader_bomSize : confreader_lineEnds[lineIdx - 1] + 1;
+	for(; i<pos; i++){
+		if((confreader_fileBuf[i] & 0xC0) != 0x80) col++;
 	}
-	
-	confreaderInit();
-	
-	// Open file and read text content.
+	return col;
+}
+
+int confreader_addDiag(int lineNum, int colNum, int kind, const char *name){
+	ConfreaderDiagnostic *newDiags;
+
+	if(confreaderDiagCount == confreader_diagCap){
+		newDiags = (ConfreaderDiagnostic *)realloc(confreaderDiags, (confreader_diagCap ? confreader_diagCap * 2 : 16) * sizeof(ConfreaderDiagnostic));
+		if(newDiags == NULL) return 0;
+		confreaderDiags = newDiags;
+		confreader_diagCap = confreader_diagCap ? confreader_diagCap * 2 : 16;
+	}
+	confreaderDiags[confreaderDiagCount].lineNum = lineNum;
+	confreaderDiags[confreaderDiagCount].colNum = colNum;
+	confreaderDiags[confreaderDiagCount].kind = kind;
+	confreaderDiags[confreaderDiagCount].name = name;
+	confreaderDiagCount++;
+	return 1;
+}
+
+// Remembers where the error is and frees the memory. Returns CONFREADER_ERROR.
+// If all the errors are collected, adds the error to the diagnostics and returns CONFREADER_OK to go on.
+int confreader_error(int lineNum, int colNum, int kind){
+	if(confreaderOptions & CONFREADER_OPT_ALL_ERRORS){
+		if(!confreader_addDiag(lineNum, colNum, kind, NULL)){
+			confreaderClear();
+			confreaderErrorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		return CONFREADER_OK;
+	}
+
+	confreaderErrorLineNum = lineNum;
+	confreaderErrorColNum = colNum;
+	confreaderClear();
+	confreaderErrorNum = kind == CONFREADER_DIAG_UTF8 ? CONFREADER_EENCODING : CONFREADER_EPARSINGFILE;
+	return CONFREADER_ERROR;
+}
+
+int confreader_syntaxError(int lineIdx, int pos, int kind){
+	return confreader_error(lineIdx + 1, confreader_column(lineIdx, pos), kind);
+}
+
+int confreader_compareDiags(const void *a, const void *b){
+	const ConfreaderDiagnostic *da = (const ConfreaderDiagnostic *)a, *db = (const ConfreaderDiagnostic *)b;
+
+	if(da->lineNum != db->lineNum) return da->lineNum < db->lineNum ? -1 : 1;
+	return da->colNum < db->colNum ? -1 : (da->colNum > db->colNum ? 1 : 0);
+}
+
+// Returns the length of the valid UTF-8 character at s of size bytes, or 0.
+// Overlong forms, surrogates and code points above U+10FFFF are not valid.
+int confreader_utf8Length(const unsigned char *s, int size){
+	int k, n;
+
+	if(s[0] < 0x80) return 1;
+	if(s[0] >= 0xC2 && s[0] <= 0xDF) n = 1;
+	else if(s[0] >= 0xE0 && s[0] <= 0xEF) n = 2;
+	else if(s[0] >= 0xF0 && s[0] <= 0xF4) n = 3;
+	else return 0;
+	if(size <= n) return 0;
+
+	// The range of the second byte is narrower after E0, ED, F0 and F4.
+	if((s[1] & 0xC0) != 0x80
+		|| (s[0] == 0xE0 && s[1] < 0xA0) || (s[0] == 0xED && s[1] > 0x9F)
+		|| (s[0] == 0xF0 && s[1] < 0x90) || (s[0] == 0xF4 && s[1] > 0x8F)) return 0;
+	for(k=2; k<=n; k++){
+		if((s[k] & 0xC0) != 0x80) return 0;
+	}
+	return n + 1;
+}
+
+// Returns the index of the first byte which does not start a valid UTF-8 character, or -1.
+int confreader_checkUtf8(const char *buf, int size){
+	const unsigned char *s = (const unsigned char *)buf;
+	unsigned long long v[2];
+	int i, n;
+
+	for(i=0; i<size; ){
+		// Let's skip ASCII 16 bytes at a time, that is most of a config file.
+		if(size - i >= 16){
+			memcpy(v, &s[i], 16);
+			if(((v[0] | v[1]) & 0x8080808080808080ULL) == 0){
+				i += 16;
+				continue;
+			}
+		}
+		if((n = confreader_utf8Length(&s[i], size - i)) == 0) return i;
+		i += n;
+	}
+	return -1;
+}
+
+// Finds the end of the value which starts at i: the end of the line or the comment, without the spaces before it.
+// Puts 0 after the value and returns its index. If the comment is not separated from the value by a space,
+// returns -1 minus the index of the comment character.
+int confreader_endValue(int i){
+	for(; ; i++){
+		if(confreader_fileBuf[i] == 0) break;
+		if(confreader_fileBuf[i] == '#' || confreader_fileBuf[i] == ';'){
+			if(confreader_fileBuf[i-1] != ' ' && confreader_fileBuf[i-1] != 0x09) return -1 - i;
+			break;
+		}
+	}
+
+	// We clear the whitespace characters at the end of the value and get the end of the parameter value
+	for(--i; i>=0; i--){
+		if(confreader_fileBuf[i] != ' ' && confreader_fileBuf[i] != 0x09) break;
+	}
+	// and then put 0 after the end of the parameter value.
+	confreader_fileBuf[++i] = 0;
+	return i;
+}
+
+// The value is <<TAG, where the tag consists of letters, digits and underscores.
+int confreader_isHeredoc(const char *val){
+	int k;
+
+	if(val[0] != '<' || val[1] != '<' || val[2] == 0) return 0;
+	for(k=2; val[k] != 0; k++){
+		if(!((val[k] >= 'A' && val[k] <= 'Z') || (val[k] >= 'a' && val[k] <= 'z') || (val[k] >= '0' && val[k] <= '9') || val[k] == '_')) return 0;
+	}
+	return 1;
+}
+
+// Reads the whole file into a new buffer with one byte more at the end.
+// Returns NULL if the file is empty, with confreaderErrorNum = CONFREADER_OK, or on error.
+char * confreader_readFile(const char *filename, ssize_t *size){
+	struct stat file_status;
+	char *buf;
+	int fd;
+
 	fd = open(filename, O_RDONLY, S_IRUSR | S_IRGRP | S_IROTH);
 	if(fd == -1){
 		confreaderErrorNum = CONFREADER_EREADFILE;
-		return CONFREADER_ERROR;
+		return NULL;
 	}
-	
 	if(fstat(fd, &file_status) != 0){
+		close(fd);
 		confreaderErrorNum = CONFREADER_EREADFILE;
-		return CONFREADER_ERROR;
+		return NULL;
 	}
-	
-	fileBufSize = file_status.st_size;
-	if(fileBufSize == 0){
+
+	*size = file_status.st_size;
+	if(*size == 0){
 		close(fd);
-		confreaderErrorNum = CONFREADER_OK;
-		return CONFREADER_OK;		// File is empty.
+		confreaderErrorNum = CONFREADER_OK;		// File is empty.
+		return NULL;
 	}
-	
-	confreader_fileBuf = (char *)malloc(fileBufSize + 1);		// One byte more.
-	if(confreader_fileBuf == NULL){
+
+	buf = (char *)malloc(*size + 1);		// One byte more.
+	if(buf == NULL){
+		close(fd);
 		confreaderErrorNum = CONFREADER_ENOMEM;
-		return CONFREADER_ERROR;
+		return NULL;
 	}
-	
-	if(read(fd, confreader_fileBuf, fileBufSize) != fileBufSize){
-		free(confreader_fileBuf);
-		confreader_fileBuf = NULL;
+	if(read(fd, buf, *size) != *size){
+		close(fd);
+		free(buf);
 		confreaderErrorNum = CONFREADER_EREADFILE;
-		return CONFREADER_ERROR;
+		return NULL;
 	}
 	close(fd);
-	
-	// Let's put 0x0A in the last byte, since the last line can be without a line feed character.
-	confreader_fileBuf[fileBufSize] = 0x0A;
-	fileBufSize++;
-	
-	// Let's count how many lines are in the file.
-	confreader_lineCount = 0;
-	for(i=0; i<fileBufSize; i++){
-		if(confreader_fileBuf[i] == 0x0A) confreader_lineCount++;
-	}
+	confreaderErrorNum = CONFREADER_OK;
+	return buf;
+}
 
-	// Let's allocate memory for the array of pointers to strings.
-	confreader_lines = (int *)malloc(confreader_lineCount * sizeof(int));
-	if(confreader_lines == NULL){
-		confreaderClear();
-		confreaderErrorNum = CONFREADER_ENOMEM;
-		return CONFREADER_ERROR;
+// Checks that the name of a parameter or a section written to the file is read back as the same name.
+int confreader_isFileName(const char *name, int section){
+	if(name[0] == 0 || name[0] == '[' || name[0] == '#' || name[0] == ';') return 0;
+	for(; *name != 0; name++){
+		if(*name == 0x0A || *name == 0x0D || *name == '=' || *name == ']') return 0;
+		// The name of a parameter ends at a space.
+		if(!section && (*name == ' ' || *name == 0x09)) return 0;
 	}
+	return 1;
+}
 
-	// Let's count how many sections and how many parameters are in the file.
-	confreader_paramCount = 0;
-	confreaderSectCount = 1;			// Section with index 0 for parameters without section.
-	lineIdx = 0;
-	for(i=0; i<fileBufSize; i++){
-		// Skip the whitespace characters at the beginning of the string.
-		for(; i<fileBufSize; i++){
-			if(confreader_fileBuf[i] != ' ' && confreader_fileBuf[i] != 0x09) break;
-		}
-		// Remember the index of the beginning of the string.
-		confreader_lines[lineIdx++] = i;
+// Writes the value as it must be in the file to dst and returns its length. If dst is NULL, only counts the length.
+// The value is put in double quotes with escape sequences if it can't be read back without them.
+int confreader_formatValue(const char *val, char *dst){
+	static const char hex[] = "0123456789ABCDEF";
+	const unsigned char *s = (const unsigned char *)val;
+	int quote;
+	int len, k;
 
-		// Check the beginning of the section.
-		if(confreader_fileBuf[i] == '['){
-			confreaderSectCount++;
-		}else
-		// Check the beginning of the comment or parameter.
-		if(confreader_fileBuf[i] != '#' && confreader_fileBuf[i] != ';' && confreader_fileBuf[i] != 0x0A && confreader_fileBuf[i] != 0x0D){
-			confreader_paramCount++;
-		}
+	len = strlen(val);
+	quote = len == 0 || s[0] == ' ' || s[0] == 0x09 || s[0] == '"' || s[0] == '=' || (s[0] == '<' && s[1] == '<')
+		|| s[len - 1] == ' ' || s[len - 1] == 0x09 || s[len - 1] == '\\';
+	for(k=0; k<len && !quote; k++){
+		if(s[k] < 0x20 || s[k] == 0x7F || s[k] == '#' || s[k] == ';' || s[k] == '\\') quote = 1;
+	}
+	if(!quote){
+		if(dst) memcpy(dst, val, len);
+		return len;
+	}
 
-		for(; i<fileBufSize; i++){
-			if(confreader_fileBuf[i] == 0x0D){
-				confreader_fileBuf[i++] = 0;
-			
-				if(confreader_fileBuf[i] != 0x0A){	// After 0x0D, 0x0A must necessarily follow.
-					confreaderClear();
-					confreaderErrorLineNum = lineIdx;
-					confreaderErrorNum = CONFREADER_EPARSINGFILE;
-					return CONFREADER_ERROR;
-				}
-				confreader_fileBuf[i] = 0;
-				break;
-			//newLine = true;
-			}else
-			if(confreader_fileBuf[i] == 0x0A){
-				confreader_fileBuf[i] = 0;
-				break;
+	len = 0;
+	if(dst) dst[len] = '"';
+	len++;
+	for(; *s != 0; s++){
+		if(*s == '\\' || *s == '"' || *s == 0x0A || *s == 0x0D || *s == 0x09){
+			if(dst){
+				dst[len] = '\\';
+				dst[len + 1] = *s == 0x0A ? 'n' : (*s == 0x0D ? 'r' : (*s == 0x09 ? 't' : *s));
+			}
+			len += 2;
+		}else
+		if(*s < 0x20 || *s == 0x7F){
+			if(dst){
+				dst[len] = '\\';
+				dst[len + 1] = 'x';
+				dst[len + 2] = hex[*s >> 4];
+				dst[len + 3] = hex[*s & 15];
 			}
+			len += 4;
+		}else{
+			if(dst) dst[len] = *s;
+			len++;
 		}
 	}
+	if(dst) dst[len] = '"';
+	return len + 1;
+}
 
-	// Allocate memory for an array of pointers to lines with parameters.
-	confreader_params = (ConfreaderParam *)malloc(confreader_paramCount * sizeof(ConfreaderParam));
-	if(confreader_params == NULL){
-		confreaderClear();
+// Writes the parts into a temporary file next to the file and renames it to the file,
+// so the readers see either the old file or the new one. The parts are changed.
+int confreader_writeAtomic(const char *filename, struct iovec *iov, int iovCount){
+	struct stat file_status;
+	char *tmp;
+	ssize_t n;
+	int ok;
+	int fd;
+
+	tmp = (char *)malloc(strlen(filename) + 8);
+	if(tmp == NULL){
 		confreaderErrorNum = CONFREADER_ENOMEM;
 		return CONFREADER_ERROR;
 	}
+	strcpy(tmp, filename);
+	strcat(tmp, ".XXXXXX");
+	fd = mkstemp(tmp);
+	if(fd == -1){
+		free(tmp);
+		confreaderErrorNum = CONFREADER_EWRITEFILE;
+		return CONFREADER_ERROR;
+	}
+	// The new file gets the permissions of the old one.
+	if(stat(filename, &file_status) == 0){
+		fchmod(fd, file_status.st_mode & 07777);
+	}
 
-	// Allocate memory for an array of pointers to sections.
-	confreaderSects = (ConfreaderSection *)malloc(confreaderSectCount * sizeof(ConfreaderSection));
-	if(confreaderSects == NULL){
-		confreaderClear();
-		confreaderErrorNum = CONFREADER_ENOMEM;
+	while(iovCount > 0){
+		n = writev(fd, iov, iovCount > 1024 ? 1024 : iovCount);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) break;
+		// Let's skip what was written.
+		for(; iovCount > 0 && (size_t)n >= iov->iov_len; iov++, iovCount--){
+			n -= iov->iov_len;
+		}
+		if(iovCount > 0){
+			iov->iov_base = (char *)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	ok = iovCount == 0 && fsync(fd) == 0;
+	if(close(fd) != 0) ok = 0;
+	if(!ok || rename(tmp, filename) != 0){
+		unlink(tmp);
+		free(tmp);
+		confreaderErrorNum = CONFREADER_EWRITEFILE;
 		return CONFREADER_ERROR;
 	}
+	free(tmp);
+	confreaderErrorNum = CONFREADER_OK;
+	return CONFREADER_OK;
+}
 
-	// Link all sections and parameters.
-	sectIdx = 0;
-	confreaderSects[sectIdx].name = NULL;
-	confreaderSects[sectIdx].size = 0;
-	confreaderSects[sectIdx].params = NULL;
-	
-	paramIdx = 0;
-	for(lineIdx=0; (lineIdx<confreader_lineCount) && (paramIdx < confreader_paramCount); lineIdx++){
-		i = confreader_lines[lineIdx];
+int confreader_compareEdits(const void *a, const void *b){
+	const ConfreaderEdit *ea = (const ConfreaderEdit *)a, *eb = (const ConfreaderEdit *)b;
 
-		if(confreader_fileBuf[i] == '['){			// Found a new section.
-			sectIdx++;
-			confreaderSects[sectIdx].name = &confreader_fileBuf[++i];
-			confreaderSects[sectIdx].size = 0;
-			confreaderSects[sectIdx].params = NULL;
-			// Let's find the end of the section name.
-			for(; i<fileBufSize; i++){
-				if(confreader_fileBuf[i] == ']'){
-					confreader_fileBuf[i++] = 0;
-					break;
-				}
-				if(confreader_fileBuf[i] == 0){		// Couldn't find the closing parenthesis.
-					confreaderClear();
-					confreaderErrorLineNum = lineIdx + 1;
-					confreaderErrorNum = CONFREADER_EPARSINGFILE;
-					return CONFREADER_ERROR;
-				}
+	if(ea->start != eb->start) return ea->start < eb->start ? -1 : 1;
+	return ea->seq < eb->seq ? -1 : (ea->seq > eb->seq ? 1 : 0);
+}
+
+// Copies n bytes to dst at len, if dst is not NULL. Returns the new length.
+int confreader_put(char *dst, int len, const char *s, int n){
+	if(dst) memcpy(&dst[len], s, n);
+	return len + n;
+}
+
+// Nonzero if any of the 8 bytes is a control character, a double quote or a backslash.
+// The high bit of a byte stays the same after the xor, so ~v masks out the bytes above 0x7F for all three tests.
+unsigned long long confreader_hasJsonSpecial(unsigned long long v){
+	const unsigned long long ones = 0x0101010101010101ULL;
+	unsigned long long q = v ^ (ones * '"'), b = v ^ (ones * '\\');
+
+	return ((v - ones * 0x20) | (q - ones) | (b - ones)) & ~v & 0x8080808080808080ULL;
+}
+
+// Writes the string as a JSON string in double quotes to dst at len. If dst is NULL, only counts the length.
+// Returns the new length. The valid UTF-8 characters are copied as they are, an invalid byte gives \ufffd.
+int confreader_jsonString(const char *val, char *dst, int len){
+	static const char hex[] = "0123456789abcdef";
+	const unsigned char *s = (const unsigned char *)val;
+	unsigned long long v;
+	char esc[6];
+	int size, k, n, end;
+
+	size = strlen(val);
+	len = confreader_put(dst, len, "\"", 1);
+	for(k=0; k<size; ){
+		// Let's copy 8 bytes at a time while they are ASCII and there is nothing to escape in them.
+		if(size - k >= 8){
+			memcpy(&v, &s[k], 8);
+			if(!confreader_hasJsonSpecial(v) && (v & 0x8080808080808080ULL) == 0){
+				len = confreader_put(dst, len, (const char *)&s[k], 8);
+				k += 8;
+				continue;
 			}
+		}
+		for(end=k+(size - k < 8 ? size - k : 8); k<end; k++){
+			if(s[k] >= 0x80){
+				if((n = confreader_utf8Length(&s[k], size - k)) > 0){
+					len = confreader_put(dst, len, (const char *)&s[k], n);
+					k += n - 1;
+				}else{
+					len = confreader_put(dst, len, "\\ufffd", 6);
+				}
+				continue;
+			}
+			if(s[k] >= 0x20 && s[k] != '"' && s[k] != '\\'){
+				len = confreader_put(dst, len, (const char *)&s[k], 1);
+				continue;
+			}
+			esc[0] = '\\';
+			switch(s[k]){
+				case '"': esc[1] = '"'; break;
+				case '\\': esc[1] = '\\'; break;
+				case 0x08: esc[1] = 'b'; break;
+				case 0x09: esc[1] = 't'; break;
+				case 0x0A: esc[1] = 'n'; break;
+				case 0x0C: esc[1] = 'f'; break;
+				case 0x0D: esc[1] = 'r'; break;
+				default:
+					memcpy(&esc[1], "u00", 3);
+					esc[4] = hex[s[k] >> 4];
+					esc[5] = hex[s[k] & 15];
+					len = confreader_put(dst, len, esc, 6);
+					continue;
+			}
+			len = confreader_put(dst, len, esc, 2);
+		}
+	}
+	return confreader_put(dst, len, "\"", 1);
+}
+
+int confreader_sameName(const char *a, const char *b){
+	return a == b || (a != NULL && b != NULL && strcasecmp(a, b) == 0);
+}
+
+// The inputs are also xored into the result, so a block which makes one of them 0 doesn't drop the hash so far.
+unsigned long long confreader_mix64(unsigned long long a, unsigned long long b){
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)a * b;
+
+	return (unsigned long long)r ^ (unsigned long long)(r >> 64) ^ a ^ b;
+#else
+	// There is no 128-bit type on 32-bit targets, the product is put together from the products of the 32-bit halves.
+	unsigned long long ll, lh, hl, hh, mid;
+
+	ll = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+	lh = (a & 0xFFFFFFFFULL) * (b >> 32);
+	hl = (a >> 32) * (b & 0xFFFFFFFFULL);
+	hh = (a >> 32) * (b >> 32);
+	mid = (ll >> 32) + (lh & 0xFFFFFFFFULL) + (hl & 0xFFFFFFFFULL);
+	return ((mid << 32) | (ll & 0xFFFFFFFFULL)) ^ (hh + (lh >> 32) + (hl >> 32) + (mid >> 32)) ^ a ^ b;
+#endif
+}
+
+// 64-bit hash of len bytes, 16 bytes a step with one 128-bit multiplication, like wyhash. It goes on from h,
+// so several strings can be hashed as one.
+unsigned long long confreader_hash64(const char *s, size_t len, unsigned long long h){
+	unsigned long long a, b;
+	size_t i;
+
+	for(i=0; i + 16 <= len; i+=16){
+		memcpy(&a, s + i, 8);
+		memcpy(&b, s + i + 8, 8);
+		h = confreader_mix64(a ^ 0xa0761d6478bd642fULL, b ^ h);
+	}
+	a = b = 0;
+	memcpy(&a, s + i, len - i < 8 ? len - i : 8);
+	if(len - i > 8) memcpy(&b, s + i + 8, len - i - 8);
+	return confreader_mix64(confreader_mix64(a ^ 0xe7037ed1a0b428dbULL, b ^ h) ^ len, 0x8ebc6af09c88c6e3ULL);
+}
+
+// The hash of each section is of its name, and of the names and the values of its parameters as they are
+// written in the file, so the comments and the spaces around don't change it. The unquoted values are
+// hashed as they were joined, without the backslashes and the indentation of the continued lines.
+void confreader_hashSections(){
+	ConfreaderParam *p;
+	int i, j;
+
+	for(i=0; i<confreaderSectCount; i++){
+		confreaderSects[i].hash = confreaderSects[i].name ? confreader_hash64(confreaderSects[i].name, strlen(confreaderSects[i].name), 0) : 0;
+		for(j=0; j<confreaderSects[i].size; j++){
+			p = &confreaderSects[i].params[j];
+			confreaderSects[i].hash = confreader_hash64(p->key, strlen(p->key), confreaderSects[i].hash);
+			if(p->value == &confreader_fileBuf[p->valueStart]){
+				confreaderSects[i].hash = confreader_hash64(p->value, strlen(p->value), confreaderSects[i].hash);
+			}else{
+				confreaderSects[i].hash = confreader_hash64(&confreader_fileBuf[p->valueStart], p->valueEnd - p->valueStart, confreaderSects[i].hash);
+			}
+		}
+	}
+}
+
+// Case-insensitive FNV-1a hash of a name.
+unsigned int confreader_hashKey(const char *s, unsigned int h){
+	for(; *s != 0; s++){
+		h = (h ^ (unsigned char)((*s >= 'A' && *s <= 'Z') ? *s + 32 : *s)) * 16777619u;
+	}
+	return h;
+}
+
+// The number of reads of the parameter in the profile.
+int confreader_profileHits(const char *key, const char *section){
+	unsigned int h;
+	int i;
+
+	for(h=confreader_hashKey(key, confreader_hashKey(section ? section : "", 2166136261u)); (i = confreader_profileSlots[h & confreader_profileMask]) >= 0; h++){
+		if(confreader_sameName(confreader_profile[i].key, key) && confreader_sameName(confreader_profile[i].section, section)) return confreader_profile[i].hits;
+	}
+	return 0;
+}
+
+// The most read first, the rest in the order of the file.
+int confreader_compareHot(int hitsA, int lineA, int hitsB, int lineB){
+	if(hitsA != hitsB) return hitsA > hitsB ? -1 : 1;
+	return lineA < lineB ? -1 : (lineA > lineB ? 1 : 0);
+}
+
+int confreader_compareHotParams(const void *a, const void *b){
+	const ConfreaderParam *pa = (const ConfreaderParam *)a, *pb = (const ConfreaderParam *)b;
+
+	return confreader_compareHot(pa->hits, pa->lineNum, pb->hits, pb->lineNum);
+}
+
+int confreader_compareHotSects(const void *a, const void *b){
+	const ConfreaderSection *sa = (const ConfreaderSection *)a, *sb = (const ConfreaderSection *)b;
+
+	return confreader_compareHot(sa->hits, sa->lineNum, sb->hits, sb->lineNum);
+}
+
+// Orders the parameters of each section and the sections by the reads in the profile, so that the lookups
+// meet the most read parameters first. The section of the parameters without section stays the first.
+void confreader_orderByProfile(){
+	int i, j;
+
+	for(i=0; i<confreaderSectCount; i++){
+		for(j=0; j<confreaderSects[i].size; j++){
+			confreaderSects[i].params[j].hits = confreader_profileHits(confreaderSects[i].params[j].key, confreaderSects[i].name);
+			confreaderSects[i].hits += confreaderSects[i].params[j].hits;
+		}
+		if(confreaderSects[i].size > 1) qsort(confreaderSects[i].params, confreaderSects[i].size, sizeof(ConfreaderParam), confreader_compareHotParams);
+		// The counters are for the reads of this process.
+		for(j=0; j<confreaderSects[i].size; j++){
+			confreaderSects[i].params[j].hits = 0;
+		}
+	}
+	// The duplicates of a section get the reads of all of them, so that they keep the order of the file
+	// and the lookups still find the first of them.
+	for(i=2; i<confreaderSectCount; i++){
+		for(j=1; j<i && !confreader_sameName(confreaderSects[j].name, confreaderSects[i].name); j++);
+		if(j < i) confreaderSects[j].hits += confreaderSects[i].hits;
+	}
+	for(i=2; i<confreaderSectCount; i++){
+		for(j=1; j<i && !confreader_sameName(confreaderSects[j].name, confreaderSects[i].name); j++);
+		if(j < i) confreaderSects[i].hits = confreaderSects[j].hits;
+	}
+	if(confreaderSectCount > 2) qsort(&confreaderSects[1], confreaderSectCount - 1, sizeof(ConfreaderSection), confreader_compareHotSects);
+}
+
+// Three bits of the Bloom filter for each key. The step is odd, so the three bits are different.
+void confreader_addBloom(ConfreaderSection *sect, unsigned int h){
+	unsigned int step = (h >> 17 | h << 15) | 1;
+	int k;
+
+	for(k=0; k<3; k++, h+=step){
+		sect->bloom[(h & sect->bloomMask) >> 6] |= 1ULL << (h & 63);
+	}
+}
+
+int confreader_inBloom(const ConfreaderSection *sect, unsigned int h){
+	unsigned int step = (h >> 17 | h << 15) | 1;
+	int k;
+
+	for(k=0; k<3; k++, h+=step){
+		if((sect->bloom[(h & sect->bloomMask) >> 6] & (1ULL << (h & 63))) == 0) return 0;
+	}
+	return 1;
+}
+
+// Builds the filters of the keys of all sections, at least 12 bits for a key, so that less than 1% of
+// the missing keys have to be compared. Without memory the sections are left without filters.
+void confreader_buildBlooms(){
+	unsigned int bits;
+	size_t words = 0;
+	int i, j;
+
+	free(confreader_blooms);
+	confreader_blooms = NULL;
+	for(i=0; i<confreaderSectCount; i++){
+		for(bits=64; bits < (unsigned int)confreaderSects[i].size * 12; bits*=2);
+		confreaderSects[i].bloom = NULL;
+		confreaderSects[i].bloomMask = bits - 1;
+		words += bits / 64;
+	}
+	if((confreader_blooms = (unsigned long long *)calloc(words, sizeof(unsigned long long))) == NULL) return;
+
+	words = 0;
+	for(i=0; i<confreaderSectCount; i++){
+		confreaderSects[i].bloom = &confreader_blooms[words];
+		words += (confreaderSects[i].bloomMask + 1) / 64;
+		for(j=0; j<confreaderSects[i].size; j++){
+			confreader_addBloom(&confreaderSects[i], confreader_hashKey(confreaderSects[i].params[j].key, 2166136261u));
+		}
+	}
+}
+
+// Finds the alias of the old name of the parameter in the section.
+const ConfreaderAlias * confreader_findAlias(const char *key, const char *section){
+	unsigned int h;
+	int i;
+
+	for(h=confreader_hashKey(key, 2166136261u); (i = confreader_aliasSlots[h & confreader_aliasMask]) >= 0; h++){
+		if(strcasecmp(confreader_aliases[i].oldKey, key) == 0
+			&& (confreader_aliases[i].section == NULL || (section != NULL && strcasecmp(confreader_aliases[i].section, section) == 0))) return &confreader_aliases[i];
+	}
+	return NULL;
+}
+
+// Sets the table of the old names of the parameters, before confreaderParseFile(). The parameters with the old names
+// in the file get the new names, and the old names given to the get functions are read as the new ones.
+// confreaderDeprecatedHits counts both. The table must live while it is used; NULL removes it.
+int confreaderSetAliases(const ConfreaderAlias *aliases, int count){
+	unsigned int h, mask;
+	int i;
+
+	free(confreader_aliasSlots);
+	confreader_aliasSlots = NULL;
+	confreader_aliases = NULL;
+	confreader_aliasCount = 0;
+	confreader_changed();
+	confreaderErrorNum = CONFREADER_OK;
+	if(aliases == NULL || count <= 0) return CONFREADER_OK;
+
+	for(mask=15; mask < (unsigned int)count * 2; mask=mask*2+1);
+	confreader_aliasSlots = (int *)malloc((mask + 1) * sizeof(int));
+	if(confreader_aliasSlots == NULL){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+	memset(confreader_aliasSlots, 0xFF, (mask + 1) * sizeof(int));
+	for(i=0; i<count; i++){
+		for(h=confreader_hashKey(aliases[i].oldKey, 2166136261u); confreader_aliasSlots[h & mask] >= 0; h++);
+		confreader_aliasSlots[h & mask] = i;
+	}
+	confreader_aliases = aliases;
+	confreader_aliasCount = count;
+	confreader_aliasMask = mask;
+	return CONFREADER_OK;
+}
+
+// Reads the profile written by confreaderSaveProfile(), before parseFile(). Then parseFile() puts the parameters
+// which were read more often first in their sections, and the sections with more reads first.
+// NULL removes the profile.
+int confreaderSetProfile(const char *filename){
+	ssize_t size = 0;
+	unsigned int h, mask;
+	const char *section = NULL;
+	char *buf;
+	int count = 1, skipSect = 0, i, k;
+
+	free(confreader_profileBuf);
+	free(confreader_profile);
+	free(confreader_profileSlots);
+	confreader_profileBuf = NULL;
+	confreader_profile = NULL;
+	confreader_profileSlots = NULL;
+	confreader_profileCount = 0;
+	confreaderErrorNum = CONFREADER_OK;
+	if(filename == NULL) return CONFREADER_OK;
+
+	if((buf = confreader_readFile(filename, &size)) == NULL){
+		return confreaderErrorNum == CONFREADER_OK ? CONFREADER_OK : CONFREADER_ERROR;
+	}
+	buf[size] = 0;
+	for(i=0; i<size; i++){
+		if(buf[i] == 0x0A) count++;
+	}
+	for(mask=15; mask < (unsigned int)count * 2; mask=mask*2+1);
+	confreader_profile = (ConfreaderProfileEntry *)malloc(count * sizeof(ConfreaderProfileEntry));
+	confreader_profileSlots = (int *)malloc((mask + 1) * sizeof(int));
+	if(confreader_profile == NULL || confreader_profileSlots == NULL){
+		free(buf);
+		free(confreader_profile);
+		free(confreader_profileSlots);
+		confreader_profile = NULL;
+		confreader_profileSlots = NULL;
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+	memset(confreader_profileSlots, 0xFF, (mask + 1) * sizeof(int));
+	confreader_profileBuf = buf;
+	confreader_profileMask = mask;
+
+	// The lines are "[section]" and "key = reads".
+	for(i=0; i<size; i++){
+		for(; buf[i] == ' ' || buf[i] == 0x09; i++);
+		if(buf[i] == '['){
+			section = &buf[++i];
+			for(; i<size && buf[i] != ']' && buf[i] != 0x0A; i++);
+			// The entries after a header without the closing bracket are skipped until the next header.
+			skipSect = buf[i] != ']';
+			if(!skipSect) buf[i++] = 0;
+		}else
+		if(!skipSect && buf[i] != 0x0A && buf[i] != 0x0D && buf[i] != '#' && buf[i] != ';' && buf[i] != 0){
+			confreader_profile[confreader_profileCount].section = section;
+			confreader_profile[confreader_profileCount].key = &buf[i];
+			for(; buf[i] != '=' && buf[i] != ' ' && buf[i] != 0x09 && buf[i] != 0x0A && buf[i] != 0; i++);
+			k = i;
+			for(; buf[i] == '=' || buf[i] == ' ' || buf[i] == 0x09; i++);
+			confreader_profile[confreader_profileCount].hits = atoi(&buf[i]);
+			buf[k] = 0;
+			if(k > confreader_profile[confreader_profileCount].key - buf){
+				for(h=confreader_hashKey(confreader_profile[confreader_profileCount].key, confreader_hashKey(section ? section : "", 2166136261u)); confreader_profileSlots[h & mask] >= 0; h++);
+				confreader_profileSlots[h & mask] = confreader_profileCount++;
+			}
+		}
+		for(; i<size && buf[i] != 0x0A && buf[i] != 0; i++);
+	}
+	return CONFREADER_OK;
+}
+
+// Writes the reads of the parameters counted with CONFREADER_OPT_RECORD_ACCESS to the profile file, in the format
+// of .conf: the sections and the parameters which were read, with the number of reads as the value.
+int confreaderSaveProfile(const char *filename){
+	struct iovec iov;
+	char *buf;
+	size_t size = 0;
+	int i, j, n;
+
+	// Let's count the most the text can take first, with 11 characters for each number.
+	for(i=0; i<confreaderSectCount; i++){
+		size += (confreaderSects[i].name ? strlen(confreaderSects[i].name) : 0) + 4;
+		for(j=0; j<confreaderSects[i].size; j++){
+			size += strlen(confreaderSects[i].params[j].key) + 3 + 11 + 1;
+		}
+	}
+	if((buf = (char *)malloc(size + 1)) == NULL){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	// The reads of the copies on the NUMA nodes are counted on the copies.
+	for(n=0; n<confreader_replicaCount; n++){
+		if(confreader_replicas[n].sects == NULL) continue;
+		for(i=0; i<confreaderSectCount; i++){
+			for(j=0; j<confreaderSects[i].size; j++){
+				confreaderSects[i].params[j].hits += confreader_replicas[n].sects[i].params[j].hits;
+				confreader_replicas[n].sects[i].params[j].hits = 0;
+			}
+		}
+	}
+
+	size = 0;
+	for(i=0; i<confreaderSectCount; i++){
+		for(j=0; j<confreaderSects[i].size && *confreader_hitsOf(&confreaderSects[i].params[j]) == 0; j++);
+		if(j == confreaderSects[i].size) continue;		// Nothing was read in the section.
+		if(i > 0) size += sprintf(&buf[size], "%s[%s]\n", size > 0 ? "\n" : "", confreaderSects[i].name);
+		for(; j<confreaderSects[i].size; j++){
+			if(*confreader_hitsOf(&confreaderSects[i].params[j]) > 0) size += sprintf(&buf[size], "%s = %d\n", confreaderSects[i].params[j].key, *confreader_hitsOf(&confreaderSects[i].params[j]));
+		}
+	}
+
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	i = confreader_writeAtomic(filename, &iov, 1);
+	free(buf);
+	return i;
+}
+
+int confreader_parseFile(const char *filename){
+	int i, j, k, part;
+	int skipSect;
+	int lineIdx, sectIdx, paramIdx;
+	int lineNum, colNum;
+	char *tag;
+	size_t tagLen;
+	ssize_t fileBufSize;
+	const ConfreaderAlias *alias;
+	
+	confreaderErrorLineNum = 0;
+	confreaderErrorColNum = 0;
+
+	if(confreader_fileBuf || confreaderSects){
+		confreaderErrorNum = CONFREADER_EBUSY;
+		return CONFREADER_ERROR;
+	}
+	
+	confreaderInit();
+	
+	// Open file and read text content.
+	confreader_fileSize = 0;
+	if((confreader_fileBuf = confreader_readFile(filename, &fileBufSize)) == NULL){
+		return confreaderErrorNum == CONFREADER_OK ? CONFREADER_OK : CONFREADER_ERROR;
+	}
+	confreader_fileSize = fileBufSize;
+	confreader_fingerprint = confreader_hash64(confreader_fileBuf, fileBufSize, 0);
+	CONFREADER_PROBE(parse__read, filename, confreader_fileSize);
+	
+	// Let's put 0x0A in the last byte, since the last line can be without a line feed character.
+	confreader_fileBuf[fileBufSize] = 0x0A;
+	fileBufSize++;
+
+	// The byte order mark of UTF-8 is skipped as the whitespace characters.
+	confreader_bomSize = 0;
+	if(fileBufSize >= 4 && (unsigned char)confreader_fileBuf[0] == 0xEF && (unsigned char)confreader_fileBuf[1] == 0xBB && (unsigned char)confreader_fileBuf[2] == 0xBF){
+		memset(confreader_fileBuf, ' ', 3);
+		confreader_bomSize = 3;
+	}
+
+	if(confreaderOptions & CONFREADER_OPT_CHECK_UTF8){
+		// The lines are not known yet, let's count them up to each wrong byte.
+		lineNum = 1;
+		colNum = 1;
+		j = confreader_bomSize;
+		for(k=0; k<fileBufSize && (i = confreader_checkUtf8(&confreader_fileBuf[k], fileBufSize - k)) >= 0; k=i+1){
+			for(i+=k; j<i; j++){
+				if(confreader_fileBuf[j] == 0x0A){
+					lineNum++;
+					colNum = 1;
+				}else
+				if((confreader_fileBuf[j] & 0xC0) != 0x80){
+					colNum++;
+				}
+			}
+			if(confreader_error(lineNum, colNum, CONFREADER_DIAG_UTF8) != CONFREADER_OK) return CONFREADER_ERROR;
+		}
+	}
+	
+	// Let's count how many lines are in the file.
+	confreader_lineCount = 0;
+	for(i=0; i<fileBufSize; i++){
+		if(confreader_fileBuf[i] == 0x0A) confreader_lineCount++;
+	}
+
+	// Let's allocate memory for the array of pointers to strings.
+	confreader_lines = (int *)malloc(confreader_lineCount * sizeof(int));
+	confreader_lineEnds = (int *)malloc(confreader_lineCount * sizeof(int));
+	if(confreader_lines == NULL || confreader_lineEnds == NULL){
+		confreaderClear();
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	// Let's count how many sections and how many parameters are in the file.
+	confreader_paramCount = 0;
+	confreaderSectCount = 1;			// Section with index 0 for parameters without section.
+	lineIdx = 0;
+	for(i=0; i<fileBufSize; i++){
+		// Skip the whitespace characters at the beginning of the string.
+		for(; i<fileBufSize; i++){
+			if(confreader_fileBuf[i] != ' ' && confreader_fileBuf[i] != 0x09) break;
+		}
+		// Remember the index of the beginning of the string.
+		confreader_lines[lineIdx++] = i;
+
+		// Check the beginning of the section.
+		if(confreader_fileBuf[i] == '['){
+			confreaderSectCount++;
+		}else
+		// Check the beginning of the comment or parameter.
+		if(confreader_fileBuf[i] != '#' && confreader_fileBuf[i] != ';' && confreader_fileBuf[i] != 0x0A && confreader_fileBuf[i] != 0x0D){
+			confreader_paramCount++;
+		}
+
+		for(; i<fileBufSize; i++){
+			if(confreader_fileBuf[i] == 0x0D){
+				confreader_fileBuf[i++] = 0;
+			
+				if(confreader_fileBuf[i] != 0x0A){	// After 0x0D, 0x0A must necessarily follow.
+					if(confreader_syntaxError(lineIdx - 1, i - 1, CONFREADER_DIAG_CR) != CONFREADER_OK) return CONFREADER_ERROR;
+					i--;		// The line goes on, the carriage return ends the value.
+					continue;
+				}
+				confreader_fileBuf[i] = 0;
+				confreader_lineEnds[lineIdx - 1] = i;
+				break;
+			//newLine = true;
+			}else
+			if(confreader_fileBuf[i] == 0x0A){
+				confreader_fileBuf[i] = 0;
+				confreader_lineEnds[lineIdx - 1] = i;
+				break;
+			}
+		}
+	}
+
+	CONFREADER_PROBE(parse__counted, filename, confreader_lineCount, confreaderSectCount, confreader_paramCount);
+
+	// Allocate memory for an array of pointers to lines with parameters.
+	confreader_params = (ConfreaderParam *)malloc(confreader_paramCount * sizeof(ConfreaderParam));
+	if(confreader_params == NULL){
+		confreaderClear();
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	// Allocate memory for an array of pointers to sections.
+	confreaderSects = (ConfreaderSection *)malloc(confreaderSectCount * sizeof(ConfreaderSection));
+	if(confreaderSects == NULL){
+		confreaderClear();
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	// Link all sections and parameters.
+	sectIdx = 0;
+	confreaderSects[sectIdx].name = NULL;
+	confreaderSects[sectIdx].size = 0;
+	confreaderSects[sectIdx].params = NULL;
+	confreaderSects[sectIdx].lineNum = 0;
+	confreaderSects[sectIdx].hits = 0;
+	
+	paramIdx = 0;
+	skipSect = 0;
+	for(lineIdx=0; lineIdx<confreader_lineCount; lineIdx++){
+		i = confreader_lines[lineIdx];
+
+		if(confreader_fileBuf[i] == '['){			// Found a new section.
+			sectIdx++;
+			confreaderSects[sectIdx].name = &confreader_fileBuf[++i];
+			confreaderSects[sectIdx].size = 0;
+			confreaderSects[sectIdx].params = NULL;
+			confreaderSects[sectIdx].lineNum = lineIdx + 1;
+			confreaderSects[sectIdx].hits = 0;
+			// Let's find the end of the section name.
+			for(; confreader_fileBuf[i] != ']' && confreader_fileBuf[i] != 0; i++);
+			if(confreader_fileBuf[i] == 0){		// Couldn't find the closing parenthesis.
+				if(confreader_syntaxError(lineIdx, i, CONFREADER_DIAG_SECTION) != CONFREADER_OK) return CONFREADER_ERROR;
+				// The section is dropped, and its parameters are skipped up to the next section.
+				sectIdx--;
+				skipSect = 1;
+				continue;
+			}
+			confreader_fileBuf[i++] = 0;
+			skipSect = 0;
+			CONFREADER_PROBE(section, confreaderSects[sectIdx].name, confreaderSects[sectIdx].lineNum);
 			
 			// If there are whitespace characters in the line from the current position, we skip these characters.
 			for(; i<fileBufSize; i++){
@@ -261,15 +1451,20 @@ int confreaderParseFile(const char *filename){
 			
 			// If there is something at the end of the line but it's not a comment, it's an error.
 			if(confreader_fileBuf[i] != 0 && confreader_fileBuf[i] != '#' && confreader_fileBuf[i] != ';'){
-				confreaderClear();
-				confreaderErrorLineNum = lineIdx + 1;
-				confreaderErrorNum = CONFREADER_EPARSINGFILE;
-				return CONFREADER_ERROR;
+				if(confreader_syntaxError(lineIdx, i, CONFREADER_DIAG_JUNK) != CONFREADER_OK) return CONFREADER_ERROR;
 			}
 		}else
 		
+		if(skipSect){
+			continue;
+		}else
+
 		if(confreader_fileBuf[i] != '#' && confreader_fileBuf[i] != ';' && confreader_fileBuf[i] != 0){	// Found a line with a parameter.
 			confreader_params[paramIdx].key = &confreader_fileBuf[i];
+			confreader_params[paramIdx].flags = 0;
+			confreader_params[paramIdx].lineNum = lineIdx + 1;
+			confreader_params[paramIdx].hits = 0;
+			memset(&confreader_params[paramIdx].cache, 0, sizeof(ConfreaderCache));
 			
 			// If the current section is empty, the detected line will be the first line.
 			if(confreaderSects[sectIdx].params == NULL){
@@ -277,189 +1472,2166 @@ int confreaderParseFile(const char *filename){
 			}
 			
 			// Let's find the end of the parameter name.
-			for(; i<fileBufSize; i++){
-				if(confreader_fileBuf[i] == 0){		// Unexpected end of line after the parameter name.
-					confreaderClear();
-					confreaderErrorLineNum = lineIdx + 1;
-					confreaderErrorNum = CONFREADER_EPARSINGFILE;
-					return CONFREADER_ERROR;
-				}
-					
+			for(; confreader_fileBuf[i] != 0; i++){
 				if(confreader_fileBuf[i] == '=' || confreader_fileBuf[i] == ' ' || confreader_fileBuf[i] == 0x09) break;
 			}
+			if(confreader_fileBuf[i] == 0){		// Unexpected end of line after the parameter name.
+				if(confreader_syntaxError(lineIdx, i, CONFREADER_DIAG_NOVALUE) != CONFREADER_OK) return CONFREADER_ERROR;
+				continue;
+			}
 			confreader_fileBuf[i++] = 0;
 
-			// Let's skip the whitespace characters and get the beginning of the parameter value.
-			for(; i<fileBufSize; i++){
-				if(confreader_fileBuf[i] != '=' && confreader_fileBuf[i] != ' ' && confreader_fileBuf[i] != 0x09) break;
-			}
-			if(confreader_fileBuf[i] == 0 || confreader_fileBuf[i] == '#' || confreader_fileBuf[i] == ';'){
-				// There is no value for the parameter.
-				confreaderClear();
-				confreaderErrorLineNum = lineIdx + 1;
-				confreaderErrorNum = CONFREADER_EPARSINGFILE;
+			// Let's skip the whitespace characters and get the beginning of the parameter value.
+			for(; i<fileBufSize; i++){
+				if(confreader_fileBuf[i] != '=' && confreader_fileBuf[i] != ' ' && confreader_fileBuf[i] != 0x09) break;
+			}
+			if(confreader_fileBuf[i] == 0 || confreader_fileBuf[i] == '#' || confreader_fileBuf[i] == ';'){
+				// There is no value for the parameter.
+				if(confreader_syntaxError(lineIdx, i, CONFREADER_DIAG_NOVALUE) != CONFREADER_OK) return CONFREADER_ERROR;
+				continue;
+			}
+
+			confreader_params[paramIdx].valueStart = i;
+			if(confreader_fileBuf[i] == '"'){
+				// The value in double quotes ends at the closing quote. Only the span is recorded here,
+				// the escape sequences are decoded on the first access to the value.
+				confreader_params[paramIdx].value = &confreader_fileBuf[++i];
+				for(; confreader_fileBuf[i] != '"' && confreader_fileBuf[i] != 0; i++){
+					if(confreader_fileBuf[i] == '\\' && confreader_fileBuf[i + 1] != 0){
+						confreader_params[paramIdx].flags |= CONFREADER_PARAM_ESCAPED;
+						i++;
+					}
+				}
+				if(confreader_fileBuf[i] == 0){		// There is no closing quote.
+					if(confreader_syntaxError(lineIdx, i, CONFREADER_DIAG_QUOTE) != CONFREADER_OK) return CONFREADER_ERROR;
+					continue;
+				}
+				confreader_fileBuf[i++] = 0;
+				confreader_params[paramIdx].valueEnd = i;
+
+				// After the closing quote there can be only a comment.
+				for(; confreader_fileBuf[i] == ' ' || confreader_fileBuf[i] == 0x09; i++);
+				if(confreader_fileBuf[i] != 0 && confreader_fileBuf[i] != '#' && confreader_fileBuf[i] != ';'){
+					if(confreader_syntaxError(lineIdx, i, CONFREADER_DIAG_JUNK) != CONFREADER_OK) return CONFREADER_ERROR;
+					continue;
+				}
+			}else{
+				confreader_params[paramIdx].value = &confreader_fileBuf[i];
+				if((i = confreader_endValue(i)) < 0){
+					// Error. The comment must be separated by a space character from the value.
+					if(confreader_syntaxError(lineIdx, -1 - i, CONFREADER_DIAG_COMMENT) != CONFREADER_OK) return CONFREADER_ERROR;
+					continue;
+				}
+
+				if(confreader_isHeredoc(confreader_params[paramIdx].value)){
+					// The value is the block of lines up to the line with the tag: key <<EOF ... EOF
+					// The line feeds inside the block are put back, so the value is a part of the file buffer.
+					tag = confreader_params[paramIdx].value + 2;
+					tagLen = strlen(tag);
+					for(k=lineIdx+1; k<confreader_lineCount; k++){
+						j = confreader_lines[k];
+						if(strncmp(&confreader_fileBuf[j], tag, tagLen) != 0) continue;
+						for(j+=tagLen; confreader_fileBuf[j] == ' ' || confreader_fileBuf[j] == 0x09; j++);
+						if(confreader_fileBuf[j] == 0) break;
+					}
+					if(k == confreader_lineCount){		// There is no line with the tag.
+						if(confreader_syntaxError(lineIdx, confreader_params[paramIdx].value - confreader_fileBuf, CONFREADER_DIAG_HEREDOC) != CONFREADER_OK) return CONFREADER_ERROR;
+						continue;
+					}
+					confreader_params[paramIdx].valueEnd = confreader_lines[k] + tagLen;
+					confreader_params[paramIdx].value = &confreader_fileBuf[confreader_lineEnds[lineIdx] + (k > lineIdx + 1 ? 1 : 0)];
+					for(j=lineIdx+1; j<k-1; j++){
+						// If the 0 before the line feed is inside the line, it was a carriage return.
+						if(confreader_lineEnds[j] - 1 > confreader_lineEnds[j - 1] && confreader_fileBuf[confreader_lineEnds[j] - 1] == 0){
+							confreader_fileBuf[confreader_lineEnds[j] - 1] = 0x0D;
+						}
+						confreader_fileBuf[confreader_lineEnds[j]] = 0x0A;
+					}
+					lineIdx = k;
+				}else{
+					// A backslash after a space at the end of an unquoted value continues it on the next line, unless
+					// the line is empty, a comment or a section header. Each next part is moved over the backslash, so the joined value
+					// stays in the file buffer. k is the end of the value joined so far, part is the start of its last part.
+					k = i;
+					part = confreader_params[paramIdx].value - confreader_fileBuf;
+					while(k - part >= 2 && confreader_fileBuf[k - 1] == '\\' && (confreader_fileBuf[k - 2] == ' ' || confreader_fileBuf[k - 2] == 0x09) && lineIdx + 1 < confreader_lineCount){
+						j = confreader_lines[lineIdx + 1];
+						if(confreader_fileBuf[j] == 0 || confreader_fileBuf[j] == '#' || confreader_fileBuf[j] == ';' || confreader_fileBuf[j] == '[') break;
+						lineIdx++;
+						if((i = confreader_endValue(j)) < 0) break;
+						part = k - 1;
+						memmove(&confreader_fileBuf[part], &confreader_fileBuf[j], i - j);
+						k = part + (i - j);
+						confreader_fileBuf[k] = 0;
+					}
+					if(i < 0){
+						if(confreader_syntaxError(lineIdx, -1 - i, CONFREADER_DIAG_COMMENT) != CONFREADER_OK) return CONFREADER_ERROR;
+						continue;
+					}
+					confreader_params[paramIdx].valueEnd = i;
+				}
+			}
+			
+			confreaderSects[sectIdx].size++;
+			paramIdx++;
+		}
+	}
+	// Lines of the heredoc blocks were counted as sections and parameters too.
+	confreaderSectCount = sectIdx + 1;
+	confreader_hashSections();
+	CONFREADER_PROBE(parse__linked, filename, confreaderSectCount, confreader_paramCount);
+
+	// Let's give the new names to the parameters with the old names, so they are found by both.
+	if(confreader_aliasCount > 0){
+		for(i=0; i<confreaderSectCount; i++){
+			for(j=0; j<confreaderSects[i].size; j++){
+				if((alias = confreader_findAlias(confreaderSects[i].params[j].key, confreaderSects[i].name)) != NULL){
+					confreaderSects[i].params[j].key = (char *)alias->key;
+					confreaderDeprecatedHits++;
+				}
+			}
+		}
+	}
+	if(confreader_profileCount > 0) confreader_orderByProfile();
+	confreader_buildBlooms();
+
+	free(confreader_lines);
+	confreader_lines = NULL;
+	free(confreader_lineEnds);
+	confreader_lineEnds = NULL;
+
+	// The lines with errors were skipped, the rest of the file can be used.
+	if(confreaderDiagCount > 0){
+		qsort(confreaderDiags, confreaderDiagCount, sizeof(ConfreaderDiagnostic), confreader_compareDiags);
+		confreaderErrorLineNum = confreaderDiags[0].lineNum;
+		confreaderErrorColNum = confreaderDiags[0].colNum;
+		confreaderErrorNum = confreaderDiags[0].kind == CONFREADER_DIAG_UTF8 ? CONFREADER_EENCODING : CONFREADER_EPARSINGFILE;
+		return CONFREADER_ERROR;
+	}
+	confreaderErrorNum = CONFREADER_OK;
+	return CONFREADER_OK;
+}
+
+int confreaderParseFile(const char *filename){
+	int res;
+
+	CONFREADER_PROBE(parse__start, filename);
+	res = confreader_parseFile(filename);
+	confreader_changed();
+	CONFREADER_PROBE(parse__end, filename, confreaderErrorNum, confreaderSectCount, confreader_paramCount);
+	return res;
+}
+
+ConfreaderParam * confreader_lookup(const char *key, const char *section){
+	const ConfreaderAlias *alias;
+	ConfreaderSection *all = confreaderSects, *sect;
+	int i, j;
+
+	// The old name is read as the new one.
+	if(confreader_aliasCount > 0 && (alias = confreader_findAlias(key, section)) != NULL){
+		__atomic_add_fetch(&confreaderDeprecatedHits, 1, __ATOMIC_RELAXED);
+		key = alias->key;
+	}
+	if(confreaderSectCount == 0) return NULL;
+	// The thread reads the copy in the memory of its NUMA node.
+	if(confreader_replicas && confreader_replicas[i = confreader_currentNode()].sects) all = confreader_replicas[i].sects;
+	if(section == NULL){
+		sect = &all[0];
+	}else{
+		for(i=1; i<confreaderSectCount && strcasecmp(section, all[i].name) != 0; i++);
+		if(i == confreaderSectCount) return NULL;
+		sect = &all[i];
+	}
+
+	// Most of the missing keys are rejected by the filter without comparing the keys of the section.
+	if(sect->bloom && !confreader_inBloom(sect, confreader_hashKey(key, 2166136261u))) return NULL;
+	for(j=0; j<sect->size; j++){
+		if(strcasecmp(key, sect->params[j].key) == 0){
+			return &sect->params[j];
+		}
+	}
+	return NULL;
+}
+
+// Decodes the escape sequences of a quoted value into the arena and replaces the value with the result.
+// Unknown sequences give the character after the backslash.
+int confreader_unescape(ConfreaderParam *p){
+	const char *src;
+	char *dst, *decoded;
+	unsigned int code;
+	int k, digits;
+
+	src = p->value;
+	decoded = dst = (char *)confreader_alloc(strlen(src) + 1);		// The decoded value is never longer.
+	if(decoded == NULL) return 0;
+
+	for(; *src != 0; src++){
+		if(*src != '\\'){
+			*dst++ = *src;
+			continue;
+		}
+		switch(*++src){
+			case 'a': *dst++ = 0x07; break;
+			case 'b': *dst++ = 0x08; break;
+			case 'e': *dst++ = 0x1B; break;
+			case 'f': *dst++ = 0x0C; break;
+			case 'n': *dst++ = 0x0A; break;
+			case 'r': *dst++ = 0x0D; break;
+			case 't': *dst++ = 0x09; break;
+			case 'v': *dst++ = 0x0B; break;
+			case 'x':		// \xHH, a byte.
+			case 'u':		// \uHHHH, a character written as UTF-8.
+				digits = *src == 'x' ? 2 : 4;
+				code = 0;
+				for(k=0; k<digits; k++){
+					if(src[k + 1] >= '0' && src[k + 1] <= '9') code = code * 16 + (src[k + 1] - '0');
+					else if(src[k + 1] >= 'a' && src[k + 1] <= 'f') code = code * 16 + (src[k + 1] - 'a' + 10);
+					else if(src[k + 1] >= 'A' && src[k + 1] <= 'F') code = code * 16 + (src[k + 1] - 'A' + 10);
+					else break;
+				}
+				if(k < digits || code == 0){		// Not a valid sequence, or a zero byte which can't be in a string.
+					*dst++ = *src;
+					break;
+				}
+				src += digits;
+				if(digits == 2 || code < 0x80){
+					*dst++ = code;
+				}else
+				if(code < 0x800){
+					*dst++ = 0xC0 | (code >> 6);
+					*dst++ = 0x80 | (code & 0x3F);
+				}else{
+					*dst++ = 0xE0 | (code >> 12);
+					*dst++ = 0x80 | ((code >> 6) & 0x3F);
+					*dst++ = 0x80 | (code & 0x3F);
+				}
+				break;
+			default: *dst++ = *src; break;		// \\ \" \' and the unknown ones.
+		}
+	}
+	*dst = 0;
+
+	__atomic_store_n(&p->value, decoded, __ATOMIC_RELAXED);
+	__atomic_store_n(&p->flags, 0, __ATOMIC_RELEASE);
+	return 1;
+}
+
+// Decodes the escape sequences of the value on the first access.
+// Only one reader decodes the value, the others wait for it, so the value is never decoded twice.
+int confreader_decode(ConfreaderParam *p){
+	int flags, ok;
+
+	for(;;){
+		flags = __atomic_load_n(&p->flags, __ATOMIC_ACQUIRE);
+		if(flags == 0) return 1;
+		if(flags & CONFREADER_PARAM_BUSY){
+			sched_yield();
+			continue;
+		}
+		if(__atomic_compare_exchange_n(&p->flags, &flags, flags | CONFREADER_PARAM_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+	}
+	ok = confreader_unescape(p);
+	if(!ok) __atomic_store_n(&p->flags, flags, __ATOMIC_RELEASE);
+	return ok;
+}
+
+// The names given by the same pointers are looked up once in each thread, until the parameters are changed.
+ConfreaderParam * confreader_cachedLookup(const char *key, const char *section){
+	static __thread ConfreaderLookupSlot slots[CONFREADER_LOOKUP_CACHE_SIZE];
+	ConfreaderLookupSlot *slot = &slots[((size_t)key ^ ((size_t)section >> 4) ^ ((size_t)key >> 9)) & (CONFREADER_LOOKUP_CACHE_SIZE - 1)];
+
+	if(slot->generation != confreader_generation || slot->key != key || slot->section != section){
+		slot->param = confreader_lookup(key, section);
+		slot->key = key;
+		slot->section = section;
+		slot->generation = confreader_generation;
+	}
+	return slot->param;
+}
+
+ConfreaderParam * confreader_findParam(const char *key, const char *section){
+	ConfreaderParam *p;
+
+	p = (confreaderOptions & CONFREADER_OPT_LOOKUP_CACHE) ? confreader_cachedLookup(key, section) : confreader_lookup(key, section);
+	if(p == NULL){
+		CONFREADER_PROBE(find__miss, key, section);
+		confreaderErrorNum = CONFREADER_ENOPARAM;
+		return NULL;
+	}
+	CONFREADER_PROBE(find__hit, key, section, p->lineNum);
+	if(confreaderOptions & CONFREADER_OPT_RECORD_ACCESS){
+		__atomic_add_fetch(confreader_hitsOf(p), 1, __ATOMIC_RELAXED);
+	}
+	if(!confreader_decode(p)){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return NULL;
+	}
+	confreaderErrorNum = CONFREADER_OK;
+	return p;
+}
+
+char * confreaderFind(const char *key, const char *section){
+	ConfreaderParam *p;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		return p->value;
+	}
+	return NULL;
+}
+
+// The hash of the file read by confreaderParseFile(), 0 if there is no file. The same file gives the same hash,
+// so a program can skip reloading a file which is not changed.
+unsigned long long confreaderFingerprint(){
+	return confreader_fingerprint;
+}
+
+// The hash of the section in the file, NULL for the parameters without section. The overrides
+// don't change it. If there is no such section, confreaderErrorNum = CONFREADER_ENOSECT and 0 is returned.
+unsigned long long confreaderSectionFingerprint(const char *section){
+	int i;
+
+	confreaderErrorNum = CONFREADER_OK;
+	if(section == NULL) return confreaderSectCount > 0 ? confreaderSects[0].hash : 0;
+	for(i=1; i<confreaderSectCount; i++){
+		if(strcasecmp(section, confreaderSects[i].name) == 0) return confreaderSects[i].hash;
+	}
+	confreaderErrorNum = CONFREADER_ENOSECT;
+	return 0;
+}
+
+int confreaderHasSection(const char *section){
+	int i;
+
+	for(i=1; i<confreaderSectCount; i++){
+		if(strcasecmp(section, confreaderSects[i].name) == 0){
+			return 1;
+		}
+	}
+	confreaderErrorNum = CONFREADER_ENOSECT;
+	return 0;
+}
+
+int confreaderHas(const char *key, const char *section){
+	if(confreaderFind(key, section) != NULL){
+		return 1;
+	}
+	return 0;
+}
+
+char confreaderGetChar(const char *key, const char *section, char defaultValue){
+	char *val;
+	
+	if((val = confreaderFind(key, section)) != NULL){
+		return val[0];
+	}
+	return defaultValue;
+}
+
+char * confreaderGetString(const char *key, const char *section, const char *defaultValue){
+	char *val;
+	
+	if((val = confreaderFind(key, section)) != NULL){
+		return val;
+	}
+	return (char *)defaultValue;
+}
+
+int confreader_isInt(const char *val){
+	int k;
+
+	if((val[0] < '0' || val[0] > '9') && val[0] != '-') return 0;
+	for(k=1; val[k]!=0; k++){
+		if(val[k] < '0' || val[k] > '9') return 0;
+	}
+	return 1;
+}
+
+int confreader_isDouble(const char *val){
+	int k;
+
+	if((val[0] < '0' || val[0] > '9') && val[0] != '-') return 0;
+	for(k=1; val[k]!=0; k++){
+		if((val[k] < '0' || val[k] > '9') && val[k] != '.') return 0;
+	}
+	return 1;
+}
+
+int confreader_parseBool(const char *val, int *result){
+	if(strcasecmp(val, "yes") == 0 || strcasecmp(val, "true") == 0 || (val[0] == '1' && val[1] == 0)){
+		*result = 1;
+		return 1;
+	}
+	if(strcasecmp(val, "no") == 0 || strcasecmp(val, "false") == 0 || (val[0] == '0' && val[1] == 0)){
+		*result = 0;
+		return 1;
+	}
+	return 0;
+}
+
+int confreaderGetInt(const char *key, const char *section, int defaultValue){
+	char *val;
+	
+	if((val = confreaderFind(key, section)) != NULL){
+		if(!confreader_isInt(val)){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return defaultValue;
+		}
+
+		return strtol(val, NULL, 10);
+	}
+	return defaultValue;
+}
+
+double confreaderGetDouble(const char *key, const char *section, double defaultValue){
+	char *val;
+	
+	if((val = confreaderFind(key, section)) != NULL){
+		if(!confreader_isDouble(val)){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return defaultValue;
+		}
+
+		return strtod(val, NULL);
+	}
+	return defaultValue;
+}
+
+int confreaderGetBool(const char *key, const char *section, int defaultValue){
+	char *val;
+	int b;
+	
+	if((val = confreaderFind(key, section)) != NULL){
+		if(confreader_parseBool(val, &b)){
+			return b;
+		}
+		
+		confreaderErrorNum = CONFREADER_EINVVAL;
+		return defaultValue;
+	}
+	return defaultValue;
+}
+
+// Converts a number of len characters with an optional unit suffix. The suffix is looked up in the table,
+// the table ends with an entry having suffix NULL. An empty suffix "" means a bare number.
+int confreader_parseUnits(const char *val, int len, const ConfreaderUnit *units, long long *result){
+	long long n = 0;
+	int k;
+
+	if(len == 0 || val[0] < '0' || val[0] > '9') return 0;
+	for(k=0; k<len && val[k] >= '0' && val[k] <= '9'; k++){
+		if(n > (0x7FFFFFFFFFFFFFFFLL - (val[k] - '0')) / 10) return 0;	// Overflow.
+		n = n * 10 + (val[k] - '0');
+	}
+	// A space between the number and the unit is allowed.
+	for(; k<len && (val[k] == ' ' || val[k] == 0x09); k++);
+
+	for(; units->suffix != NULL; units++){
+		if((int)strlen(units->suffix) == len - k && strncasecmp(&val[k], units->suffix, len - k) == 0){
+			if(n > 0x7FFFFFFFFFFFFFFFLL / units->mul) return 0;	// Overflow.
+			*result = n * units->mul;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// The cache of a parameter is filled once, by the first reader that converted the value.
+// The other readers convert the value themselves until the cache is ready.
+int confreader_cached(ConfreaderParam *p, int type, const void *tag){
+	ConfreaderCache *c = confreader_cacheOf(p);
+	return __atomic_load_n(&c->type, __ATOMIC_ACQUIRE) == type && c->tag == tag;
+}
+
+int confreader_cacheLock(ConfreaderParam *p){
+	int expected = CONFREADER_CACHE_NONE;
+	return __atomic_compare_exchange_n(&confreader_cacheOf(p)->type, &expected, CONFREADER_CACHE_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void confreader_cacheUnlock(ConfreaderParam *p, int type, const void *tag){
+	ConfreaderCache *c = confreader_cacheOf(p);
+	c->tag = tag;
+	__atomic_store_n(&c->type, type, __ATOMIC_RELEASE);
+}
+
+// For the values kept in the memory of the library, where only the reader that fills the cache may allocate.
+// Returns 0 if the caller has taken the lock and must fill the cache, 1 if the cache holds the value,
+// or -1 if it holds another type. Waits while another reader is filling the cache.
+int confreader_cacheClaim(ConfreaderParam *p, int type, const void *tag){
+	ConfreaderCache *c = confreader_cacheOf(p);
+	int t;
+
+	while(!confreader_cacheLock(p)){
+		t = __atomic_load_n(&c->type, __ATOMIC_ACQUIRE);
+		if(t == CONFREADER_CACHE_BUSY){
+			sched_yield();
+			continue;
+		}
+		return t == type && c->tag == tag ? 1 : -1;
+	}
+	return 0;
+}
+
+// The values of other types than the one in the cache are kept in entries chained to it, for the getters
+// that return the memory of the library. Returns the entry of the type, or NULL if there is none.
+ConfreaderCache * confreader_chained(ConfreaderParam *p, int type){
+	ConfreaderCache *e;
+
+	for(e = __atomic_load_n(&confreader_cacheOf(p)->next, __ATOMIC_ACQUIRE); e != NULL; e = e->next){
+		if(e->type == type) return e;
+	}
+	return NULL;
+}
+
+// Returns the entry of the type, or NULL with the chain locked if the caller must add it with confreader_chainAdd().
+// Entries are added by one reader at a time, so the value of a type is allocated once.
+ConfreaderCache * confreader_chainClaim(ConfreaderParam *p, int type){
+	ConfreaderCache *c = confreader_cacheOf(p);
+	ConfreaderCache *e;
+	int expected;
+
+	for(;;){
+		if((e = confreader_chained(p, type)) != NULL) return e;
+		expected = 0;
+		if(__atomic_compare_exchange_n(&c->chainLock, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+		sched_yield();
+	}
+	if((e = confreader_chained(p, type)) != NULL){
+		__atomic_store_n(&c->chainLock, 0, __ATOMIC_RELEASE);
+	}
+	return e;
+}
+
+// Adds the entry with the value and unlocks the chain. Returns NULL if the value or the entry is not allocated.
+ConfreaderCache * confreader_chainAdd(ConfreaderParam *p, int type, void *value){
+	ConfreaderCache *c = confreader_cacheOf(p);
+	ConfreaderCache *e = NULL;
+
+	if(value != NULL && (e = (ConfreaderCache *)confreader_alloc(sizeof(ConfreaderCache))) != NULL){
+		memset(e, 0, sizeof(ConfreaderCache));
+		e->type = type;
+		e->v.p = value;
+		e->next = c->next;
+		__atomic_store_n(&c->next, e, __ATOMIC_RELEASE);
+	}
+	__atomic_store_n(&c->chainLock, 0, __ATOMIC_RELEASE);
+	return e;
+}
+
+// Parses an IPv4 or IPv6 address of len characters. An IPv6 address may be in square brackets.
+int confreader_parseIpAddr(const char *val, int len, ConfreaderIpAddr *ip){
+	char buf[INET6_ADDRSTRLEN];
+
+	if(len >= 2 && val[0] == '[' && val[len - 1] == ']'){
+		val++;
+		len -= 2;
+	}
+	if(len <= 0 || len >= (int)sizeof(buf)) return 0;
+	memcpy(buf, val, len);
+	buf[len] = 0;
+
+	memset(ip, 0, sizeof(ConfreaderIpAddr));
+	if(inet_pton(AF_INET, buf, ip->addr) == 1){
+		ip->family = AF_INET;
+		return 1;
+	}
+	if(inet_pton(AF_INET6, buf, ip->addr) == 1){
+		ip->family = AF_INET6;
+		return 1;
+	}
+	return 0;
+}
+
+// Parses 192.168.0.60:3333, [::]:8080, *:8080 or an address without a port.
+// hasPort is set to 1 if the value has a port, even :0.
+int confreader_parseEndpoint(const char *val, ConfreaderEndpoint *ep, int *hasPort){
+	ConfreaderIpAddr ip;
+	const char *colon;
+	int len, port, k;
+
+	len = strlen(val);
+	port = 0;
+	*hasPort = 0;
+	colon = strrchr(val, ':');
+	// The port follows the last colon, unless the colon is a part of an IPv6 address without brackets.
+	if(colon != NULL && (val[0] == '[' ? colon[-1] == ']' : strchr(val, ':') == colon)){
+		*hasPort = 1;
+		len = colon - val;
+		for(k=1; colon[k] != 0; k++){
+			if(colon[k] < '0' || colon[k] > '9') return 0;
+			port = port * 10 + (colon[k] - '0');
+			if(port > 65535) return 0;
+		}
+		if(k == 1) return 0;
+	}
+
+	if(len == 1 && val[0] == '*'){		// Any address.
+		memset(&ip, 0, sizeof(ip));
+		ip.family = AF_INET;
+	}else
+	if(!confreader_parseIpAddr(val, len, &ip)){
+		return 0;
+	}
+
+	memset(ep, 0, sizeof(ConfreaderEndpoint));
+	if(ip.family == AF_INET){
+		ep->addr.sin.sin_family = AF_INET;
+		ep->addr.sin.sin_port = htons(port);
+		memcpy(&ep->addr.sin.sin_addr, ip.addr, 4);
+		ep->len = sizeof(struct sockaddr_in);
+	}else{
+		ep->addr.sin6.sin6_family = AF_INET6;
+		ep->addr.sin6.sin6_port = htons(port);
+		memcpy(&ep->addr.sin6.sin6_addr, ip.addr, 16);
+		ep->len = sizeof(struct sockaddr_in6);
+	}
+	return 1;
+}
+
+// Parses one prefix of the list: 10.0.0.0/8, fd00::/8 or a single address.
+int confreader_parseCidr(const char *val, int len, ConfreaderIpAddr *ip, int *prefixLen){
+	int k, addrLen, maxLen;
+
+	*prefixLen = 0;
+	for(addrLen=0; addrLen<len && val[addrLen] != '/'; addrLen++);
+	if(!confreader_parseIpAddr(val, addrLen, ip)) return 0;
+
+	maxLen = ip->family == AF_INET ? 32 : 128;
+	if(addrLen == len){
+		*prefixLen = maxLen;
+		return 1;
+	}
+	for(k=addrLen+1; k<len; k++){
+		if(val[k] < '0' || val[k] > '9') return 0;
+		*prefixLen = *prefixLen * 10 + (val[k] - '0');
+		if(*prefixLen > maxLen) return 0;
+	}
+	return k > addrLen + 1;
+}
+
+// Checks the prefixes separated by commas or spaces and counts the nodes of the tries,
+// one node per bit of each prefix at most. Returns -1 if the list is invalid.
+int confreader_countCidrNodes(const char *val){
+	ConfreaderIpAddr ip;
+	int i, len, prefixLen, nodeCount;
+
+	nodeCount = 3;		// The unused node 0 and two roots.
+	for(i=0; val[i] != 0; i+=len){
+		for(; val[i] == ',' || val[i] == ' ' || val[i] == 0x09; i++);
+		for(len=0; val[i + len] != 0 && val[i + len] != ',' && val[i + len] != ' ' && val[i + len] != 0x09; len++);
+		if(len == 0) continue;
+		if(!confreader_parseCidr(&val[i], len, &ip, &prefixLen)) return -1;
+		nodeCount += prefixLen;
+	}
+	return nodeCount;
+}
+
+// Builds the tries of the list checked by confreader_countCidrNodes().
+ConfreaderCidrList * confreader_parseCidrList(const char *val, int nodeCount){
+	ConfreaderCidrList *list;
+	ConfreaderIpAddr ip;
+	int i, k, len, prefixLen, node, bit;
+
+	list = (ConfreaderCidrList *)confreader_alloc(sizeof(ConfreaderCidrList) + nodeCount * sizeof(ConfreaderCidrNode));
+	if(list == NULL) return NULL;
+	list->nodes = (ConfreaderCidrNode *)(list + 1);
+	memset(list->nodes, 0, nodeCount * sizeof(ConfreaderCidrNode));
+	list->count = 0;
+	list->root4 = 1;
+	list->root6 = 2;
+
+	nodeCount = 3;
+	for(i=0; val[i] != 0; i+=len){
+		for(; val[i] == ',' || val[i] == ' ' || val[i] == 0x09; i++);
+		for(len=0; val[i + len] != 0 && val[i + len] != ',' && val[i + len] != ' ' && val[i + len] != 0x09; len++);
+		if(len == 0) continue;
+		confreader_parseCidr(&val[i], len, &ip, &prefixLen);
+
+		node = ip.family == AF_INET ? list->root4 : list->root6;
+		for(k=0; k<prefixLen; k++){
+			bit = (ip.addr[k >> 3] >> (7 - (k & 7))) & 1;
+			if(list->nodes[node].child[bit] == 0){
+				list->nodes[node].child[bit] = nodeCount++;
+			}
+			node = list->nodes[node].child[bit];
+		}
+		list->nodes[node].match = 1;
+		list->count++;
+	}
+	return list;
+}
+
+// Eight ASCII digits at once, the first digit in the lowest byte.
+int confreader_isEightDigits(unsigned long long v){
+	return (((v & 0xF0F0F0F0F0F0F0F0ULL) | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
+}
+
+unsigned int confreader_parseEightDigits(unsigned long long v){
+	v -= 0x3030303030303030ULL;
+	v = (v * 10) + (v >> 8);
+	return (unsigned int)((((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+		+ (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32);
+}
+
+// Reads the digits from p up to end into n, eight at a time where possible.
+// Returns the number of digits; digits beyond 19 are counted but not added.
+int confreader_readDigits(const char *p, const char *end, unsigned long long *n){
+	unsigned long long v;
+	int count = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	while(end - p >= 8){
+		memcpy(&v, p, 8);
+		if(!confreader_isEightDigits(v)) break;
+		if(count <= 11){
+			*n = *n * 100000000ULL + confreader_parseEightDigits(v);
+		}
+		count += 8;
+		p += 8;
+	}
+#endif
+	for(; p < end && *p >= '0' && *p <= '9'; p++, count++){
+		if(count < 19) *n = *n * 10 + (*p - '0');
+	}
+	return count;
+}
+
+int confreader_isListSeparator(char c){
+	return c == ',' || c == ' ' || c == 0x09;
+}
+
+// Decodes up to maxCount integers of the list. Returns the number of elements in the list or -1 if the list is invalid.
+int confreader_decodeInts(const char *val, long long *values, int maxCount){
+	const char *end, *tokenEnd;
+	unsigned long long n;
+	int negative;
+	int count, digits;
+
+	end = val + strlen(val);
+	for(count=0; ; count++){
+		for(; val < end && confreader_isListSeparator(*val); val++);
+		if(val == end) break;
+		for(tokenEnd=val; tokenEnd < end && !confreader_isListSeparator(*tokenEnd); tokenEnd++);
+
+		negative = *val == '-';
+		if(*val == '-' || *val == '+') val++;
+		n = 0;
+		digits = confreader_readDigits(val, tokenEnd, &n);
+		if(digits == 0 || val + digits != tokenEnd || digits > 19) return -1;
+		if(n > 0x7FFFFFFFFFFFFFFFULL + (negative ? 1 : 0)) return -1;		// Overflow.
+		if(count < maxCount){
+			values[count] = negative ? (long long)(0 - n) : (long long)n;
+		}
+		val = tokenEnd;
+	}
+	return count;
+}
+
+// Decodes up to maxCount numbers of the list. Returns the number of elements in the list or -1 if the list is invalid.
+int confreader_decodeDoubles(const char *val, double *values, int maxCount){
+	static const double powersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	const char *end, *tokenEnd, *p;
+	char *strEnd;
+	unsigned long long n;
+	double d;
+	int negative;
+	int count, intDigits, fracDigits;
+
+	end = val + strlen(val);
+	for(count=0; ; count++){
+		for(; val < end && confreader_isListSeparator(*val); val++);
+		if(val == end) break;
+		for(tokenEnd=val; tokenEnd < end && !confreader_isListSeparator(*tokenEnd); tokenEnd++);
+
+		// The fast path: a mantissa of up to 15 digits is exact in double,
+		// and so is 10^k for k <= 22, so one division gives the correctly rounded result.
+		p = val;
+		negative = *p == '-';
+		if(*p == '-' || *p == '+') p++;
+		n = 0;
+		intDigits = confreader_readDigits(p, tokenEnd, &n);
+		p += intDigits;
+		fracDigits = 0;
+		if(p < tokenEnd && *p == '.'){
+			p++;
+			fracDigits = confreader_readDigits(p, tokenEnd, &n);
+			p += fracDigits;
+		}
+		if(p == tokenEnd && intDigits + fracDigits > 0 && intDigits + fracDigits <= 15){
+			d = (double)n / powersOf10[fracDigits];
+			if(negative) d = -d;
+		}else{
+			// Exponents, long mantissas, inf and nan are left to strtod.
+			d = strtod(val, &strEnd);
+			if(strEnd != tokenEnd) return -1;
+		}
+		if(count < maxCount){
+			values[count] = d;
+		}
+		val = tokenEnd;
+	}
+	return count;
+}
+
+long long confreader_getUnits(const char *key, const char *section, long long defaultValue, int type, const ConfreaderUnit *units){
+	ConfreaderParam *p;
+	long long n;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		if(confreader_cached(p, type, NULL)){
+			return confreader_cacheOf(p)->v.i;
+		}
+		if(!confreader_parseUnits(p->value, strlen(p->value), units, &n)){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return defaultValue;
+		}
+		if(confreader_cacheLock(p)){
+			confreader_cacheOf(p)->v.i = n;
+			confreader_cacheUnlock(p, type, NULL);
+		}
+		return n;
+	}
+	return defaultValue;
+}
+
+// Units of confreaderGetDuration() and confreaderGetBytes().
+const ConfreaderUnit * confreader_durationUnits(){
+	static const ConfreaderUnit units[] = {
+		{"", 1}, {"ms", 1},
+		{"s", 1000LL}, {"sec", 1000LL},
+		{"m", 60000LL}, {"min", 60000LL},
+		{"h", 3600000LL},
+		{"d", 86400000LL},
+		{"w", 604800000LL},
+		{NULL, 0}
+	};
+	return units;
+}
+
+const ConfreaderUnit * confreader_byteUnits(){
+	static const ConfreaderUnit units[] = {
+		{"", 1}, {"b", 1},
+		{"k", 1LL << 10}, {"kib", 1LL << 10}, {"kb", 1000LL},
+		{"m", 1LL << 20}, {"mib", 1LL << 20}, {"mb", 1000000LL},
+		{"g", 1LL << 30}, {"gib", 1LL << 30}, {"gb", 1000000000LL},
+		{"t", 1LL << 40}, {"tib", 1LL << 40}, {"tb", 1000000000000LL},
+		{NULL, 0}
+	};
+	return units;
+}
+
+// Duration in milliseconds: 250ms, 30s, 5m, 5min, 2h, 1d, 1w. A bare number means milliseconds.
+long long confreaderGetDuration(const char *key, const char *section, long long defaultValue){
+	return confreader_getUnits(key, section, defaultValue, CONFREADER_CACHE_DURATION, confreader_durationUnits());
+}
+
+// Size in bytes: 512, 512B, 64K, 64KiB, 64M, 64MiB, 1G, 1GiB, 1T, 1TiB are powers of 1024,
+// 64KB, 64MB, 1GB, 1TB are powers of 1000. Case doesn't matter.
+long long confreaderGetBytes(const char *key, const char *section, long long defaultValue){
+	return confreader_getUnits(key, section, defaultValue, CONFREADER_CACHE_BYTES, confreader_byteUnits());
+}
+
+// Rate in events per second: 100, 100/s, 10k/s, 2M/s, 600/min, 1000/h, 50000/d.
+// A rate per minute, hour or day is not a whole number per second, so the result is double.
+double confreaderGetRate(const char *key, const char *section, double defaultValue){
+	static const ConfreaderUnit units[] = {
+		{"", 1}, {"k", 1000LL}, {"m", 1000000LL}, {"g", 1000000000LL},
+		{NULL, 0}
+	};
+	static const ConfreaderUnit periods[] = {
+		{"s", 1}, {"sec", 1}, {"m", 60}, {"min", 60}, {"h", 3600}, {"d", 86400},
+		{NULL, 0}
+	};
+	ConfreaderParam *p;
+	const ConfreaderUnit *u;
+	long long n;
+	double rate;
+	int k;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		if(confreader_cached(p, CONFREADER_CACHE_RATE, NULL)){
+			return confreader_cacheOf(p)->v.d;
+		}
+		// The value is split into the count and the period.
+		for(k=0; p->value[k] != 0 && p->value[k] != '/'; k++);
+		if(!confreader_parseUnits(p->value, k, units, &n)){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return defaultValue;
+		}
+		rate = (double)n;		// A bare count is per second.
+		if(p->value[k] == '/'){
+			for(u=periods; u->suffix != NULL; u++){
+				if(strcasecmp(&p->value[k + 1], u->suffix) == 0) break;
+			}
+			if(u->suffix == NULL){
+				confreaderErrorNum = CONFREADER_EINVVAL;
+				return defaultValue;
+			}
+			rate /= u->mul;
+		}
+		if(confreader_cacheLock(p)){
+			confreader_cacheOf(p)->v.d = rate;
+			confreader_cacheUnlock(p, CONFREADER_CACHE_RATE, NULL);
+		}
+		return rate;
+	}
+	return defaultValue;
+}
+
+// The value is one of the names in the table: log_level = warning. Names are case-insensitive.
+// C has no compile-time hashing, so the table is scanned on the first call and the index of the name is cached.
+int confreaderGetEnum(const char *key, const char *section, const ConfreaderEnumName *names, int count, int defaultValue){
+	ConfreaderParam *p;
+	int k;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		// Another table may be at the same address later, so the cached index is used only if it has the name.
+		if(confreader_cached(p, CONFREADER_CACHE_ENUM, names)){
+			k = (int)confreader_cacheOf(p)->v.i;
+			if(k < count && strcasecmp(p->value, names[k].name) == 0) return names[k].value;
+		}
+		for(k=0; k<count; k++){
+			if(strcasecmp(p->value, names[k].name) == 0) break;
+		}
+		if(k == count){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return defaultValue;
+		}
+		if(confreader_cacheLock(p)){
+			confreader_cacheOf(p)->v.i = k;
+			confreader_cacheUnlock(p, CONFREADER_CACHE_ENUM, names);
+		}
+		return names[k].value;
+	}
+	return defaultValue;
+}
+
+// IP address: 192.168.0.60, ::1 or [::1].
+int confreaderGetIpAddr(const char *key, const char *section, ConfreaderIpAddr *ip){
+	ConfreaderParam *p;
+	ConfreaderIpAddr *cached;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		if(confreader_cached(p, CONFREADER_CACHE_IPADDR, NULL)){
+			*ip = *(ConfreaderIpAddr *)confreader_cacheOf(p)->v.p;
+			return 1;
+		}
+		if(!confreader_parseIpAddr(p->value, strlen(p->value), ip)){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return 0;
+		}
+		if(confreader_cacheLock(p)){
+			if((cached = (ConfreaderIpAddr *)confreader_alloc(sizeof(ConfreaderIpAddr))) != NULL){
+				*cached = *ip;
+				confreader_cacheOf(p)->v.p = cached;
+				confreader_cacheUnlock(p, CONFREADER_CACHE_IPADDR, NULL);
+			}else{
+				confreader_cacheUnlock(p, CONFREADER_CACHE_NONE, NULL);
+			}
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// Address and port ready for bind() or connect(): 192.168.0.60:3333, [::]:8080, *:8080.
+// If the value has no port, defaultPort is used. An explicit :0 is kept.
+int confreaderGetEndpoint(const char *key, const char *section, ConfreaderEndpoint *ep, int defaultPort){
+	ConfreaderParam *p;
+	ConfreaderEndpoint *cached;
+	int hasPort;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		if(confreader_cached(p, CONFREADER_CACHE_ENDPOINT, NULL)){
+			cached = (ConfreaderEndpoint *)confreader_cacheOf(p)->v.p;
+			*ep = *cached;
+			hasPort = *(int *)(cached + 1);
+		}else{
+			if(!confreader_parseEndpoint(p->value, ep, &hasPort)){
+				confreaderErrorNum = CONFREADER_EINVVAL;
+				return 0;
+			}
+			if(confreader_cacheLock(p)){
+				// Whether the value has a port is kept in the int after the address.
+				if((cached = (ConfreaderEndpoint *)confreader_alloc(sizeof(ConfreaderEndpoint) + sizeof(int))) != NULL){
+					*cached = *ep;
+					*(int *)(cached + 1) = hasPort;
+					confreader_cacheOf(p)->v.p = cached;
+					confreader_cacheUnlock(p, CONFREADER_CACHE_ENDPOINT, NULL);
+				}else{
+					confreader_cacheUnlock(p, CONFREADER_CACHE_NONE, NULL);
+				}
+			}
+		}
+		// The port is at the same place in sockaddr_in and sockaddr_in6.
+		if(!hasPort){
+			ep->addr.sin.sin_port = htons(defaultPort);
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// List of prefixes separated by commas or spaces: 10.0.0.0/8, 192.168.0.0/16, ::1.
+// The list is compiled once, check addresses against it with confreaderCidrMatch.
+const ConfreaderCidrList * confreaderGetCidrList(const char *key, const char *section){
+	ConfreaderParam *p;
+	ConfreaderCidrList *list;
+	ConfreaderCache *e;
+	int nodeCount, claim;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		if(confreader_cached(p, CONFREADER_CACHE_CIDRLIST, NULL)){
+			return (ConfreaderCidrList *)confreader_cacheOf(p)->v.p;
+		}
+		if((e = confreader_chained(p, CONFREADER_CACHE_CIDRLIST)) != NULL){
+			return (ConfreaderCidrList *)e->v.p;
+		}
+		// Nothing is allocated for an invalid list, and the list is built only by the reader that fills the cache.
+		if((nodeCount = confreader_countCidrNodes(p->value)) < 0){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return NULL;
+		}
+		if((claim = confreader_cacheClaim(p, CONFREADER_CACHE_CIDRLIST, NULL)) > 0){
+			return (ConfreaderCidrList *)confreader_cacheOf(p)->v.p;
+		}
+		if(claim < 0){
+			// The value is cached as another type, the list goes to an entry chained to the cache.
+			if((e = confreader_chainClaim(p, CONFREADER_CACHE_CIDRLIST)) == NULL &&
+			   (e = confreader_chainAdd(p, CONFREADER_CACHE_CIDRLIST, confreader_parseCidrList(p->value, nodeCount))) == NULL){
+				confreaderErrorNum = CONFREADER_ENOMEM;
+				return NULL;
+			}
+			return (ConfreaderCidrList *)e->v.p;
+		}
+		if((list = confreader_parseCidrList(p->value, nodeCount)) == NULL){
+			confreader_cacheUnlock(p, CONFREADER_CACHE_NONE, NULL);
+			confreaderErrorNum = CONFREADER_ENOMEM;
+			return NULL;
+		}
+		confreader_cacheOf(p)->v.p = list;
+		confreader_cacheUnlock(p, CONFREADER_CACHE_CIDRLIST, NULL);
+		return list;
+	}
+	return NULL;
+}
+
+int confreaderCidrMatch(const ConfreaderCidrList *list, const ConfreaderIpAddr *ip){
+	const unsigned char *addr;
+	int i, bits, node;
+
+	addr = ip->addr;
+	if(ip->family == AF_INET){
+		node = list->root4;
+		bits = 32;
+	}else
+	// An IPv4-mapped IPv6 address ::ffff:a.b.c.d is checked against the IPv4 prefixes.
+	if(memcmp(addr, "\0\0\0\0\0\0\0\0\0\0\xFF\xFF", 12) == 0){
+		addr += 12;
+		node = list->root4;
+		bits = 32;
+	}else{
+		node = list->root6;
+		bits = 128;
+	}
+
+	for(i=0; ; i++){
+		if(list->nodes[node].match) return 1;
+		if(i == bits) return 0;
+		node = list->nodes[node].child[(addr[i >> 3] >> (7 - (i & 7))) & 1];
+		if(node == 0) return 0;
+	}
+}
+
+int confreaderCidrMatchAddr(const ConfreaderCidrList *list, const struct sockaddr *sa){
+	ConfreaderIpAddr ip;
+
+	if(sa->sa_family == AF_INET){
+		ip.family = AF_INET;
+		memcpy(ip.addr, &((const struct sockaddr_in *)sa)->sin_addr, 4);
+	}else
+	if(sa->sa_family == AF_INET6){
+		ip.family = AF_INET6;
+		memcpy(ip.addr, &((const struct sockaddr_in6 *)sa)->sin6_addr, 16);
+	}else{
+		return 0;
+	}
+	return confreaderCidrMatch(list, &ip);
+}
+
+// List of integers separated by commas or spaces: weights = 10, 20, -30.
+// Up to maxCount values are written to values. Returns the number of elements in the list, or -1 if
+// the parameter is not found or the list is invalid.
+int confreaderGetIntArray(const char *key, const char *section, long long *values, int maxCount){
+	ConfreaderParam *p;
+	int count;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		if((count = confreader_decodeInts(p->value, values, maxCount)) < 0){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+		}
+		return count;
+	}
+	return -1;
+}
+
+// Decodes the n elements of a valid list into the arena. The number of elements is kept in the 16 bytes before the array.
+long long * confreader_newIntArray(const char *value, int n){
+	long long *values;
+
+	if((values = (long long *)confreader_alloc(16 + n * sizeof(long long))) == NULL) return NULL;
+	*(int *)values = n;
+	values += 2;
+	confreader_decodeInts(value, values, n);
+	return values;
+}
+
+// The same, but the array is decoded once into the memory of the library. The number of elements is put to count.
+const long long * confreaderGetIntArrayPtr(const char *key, const char *section, int *count){
+	ConfreaderParam *p;
+	long long *values;
+	ConfreaderCache *e;
+	int n, claim;
+
+	*count = 0;
+	if((p = confreader_findParam(key, section)) != NULL){
+		if(confreader_cached(p, CONFREADER_CACHE_INTARRAY, NULL)){
+			values = (long long *)confreader_cacheOf(p)->v.p;
+		}else
+		if((e = confreader_chained(p, CONFREADER_CACHE_INTARRAY)) != NULL){
+			values = (long long *)e->v.p;
+		}else{
+			// Nothing is allocated for an invalid list, and the array is decoded only by the reader that fills the cache.
+			if((n = confreader_decodeInts(p->value, NULL, 0)) < 0){
+				confreaderErrorNum = CONFREADER_EINVVAL;
+				return NULL;
+			}
+			if((claim = confreader_cacheClaim(p, CONFREADER_CACHE_INTARRAY, NULL)) == 0){
+				if((values = confreader_newIntArray(p->value, n)) == NULL){
+					confreader_cacheUnlock(p, CONFREADER_CACHE_NONE, NULL);
+					confreaderErrorNum = CONFREADER_ENOMEM;
+					return NULL;
+				}
+				confreader_cacheOf(p)->v.p = values;
+				confreader_cacheUnlock(p, CONFREADER_CACHE_INTARRAY, NULL);
+			}else
+			if(claim > 0){
+				values = (long long *)confreader_cacheOf(p)->v.p;
+			}else{
+				// The value is cached as another type, the array goes to an entry chained to the cache.
+				if((e = confreader_chainClaim(p, CONFREADER_CACHE_INTARRAY)) == NULL &&
+				   (e = confreader_chainAdd(p, CONFREADER_CACHE_INTARRAY, confreader_newIntArray(p->value, n))) == NULL){
+					confreaderErrorNum = CONFREADER_ENOMEM;
+					return NULL;
+				}
+				values = (long long *)e->v.p;
+			}
+		}
+		*count = *(int *)(values - 2);
+		return values;
+	}
+	return NULL;
+}
+
+// List of numbers separated by commas or spaces: weights = 0.25, 0.5, 1e-3.
+int confreaderGetDoubleArray(const char *key, const char *section, double *values, int maxCount){
+	ConfreaderParam *p;
+	int count;
+
+	if((p = confreader_findParam(key, section)) != NULL){
+		if((count = confreader_decodeDoubles(p->value, values, maxCount)) < 0){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+		}
+		return count;
+	}
+	return -1;
+}
+
+double * confreader_newDoubleArray(const char *value, int n){
+	double *values;
+
+	if((values = (double *)confreader_alloc(16 + n * sizeof(double))) == NULL) return NULL;
+	*(int *)values = n;
+	values += 2;
+	confreader_decodeDoubles(value, values, n);
+	return values;
+}
+
+const double * confreaderGetDoubleArrayPtr(const char *key, const char *section, int *count){
+	ConfreaderParam *p;
+	double *values;
+	ConfreaderCache *e;
+	int n, claim;
+
+	*count = 0;
+	if((p = confreader_findParam(key, section)) != NULL){
+		if(confreader_cached(p, CONFREADER_CACHE_DOUBLEARRAY, NULL)){
+			values = (double *)confreader_cacheOf(p)->v.p;
+		}else
+		if((e = confreader_chained(p, CONFREADER_CACHE_DOUBLEARRAY)) != NULL){
+			values = (double *)e->v.p;
+		}else{
+			// Nothing is allocated for an invalid list, and the array is decoded only by the reader that fills the cache.
+			if((n = confreader_decodeDoubles(p->value, NULL, 0)) < 0){
+				confreaderErrorNum = CONFREADER_EINVVAL;
+				return NULL;
+			}
+			if((claim = confreader_cacheClaim(p, CONFREADER_CACHE_DOUBLEARRAY, NULL)) == 0){
+				if((values = confreader_newDoubleArray(p->value, n)) == NULL){
+					confreader_cacheUnlock(p, CONFREADER_CACHE_NONE, NULL);
+					confreaderErrorNum = CONFREADER_ENOMEM;
+					return NULL;
+				}
+				confreader_cacheOf(p)->v.p = values;
+				confreader_cacheUnlock(p, CONFREADER_CACHE_DOUBLEARRAY, NULL);
+			}else
+			if(claim > 0){
+				values = (double *)confreader_cacheOf(p)->v.p;
+			}else{
+				if((e = confreader_chainClaim(p, CONFREADER_CACHE_DOUBLEARRAY)) == NULL &&
+				   (e = confreader_chainAdd(p, CONFREADER_CACHE_DOUBLEARRAY, confreader_newDoubleArray(p->value, n))) == NULL){
+					confreaderErrorNum = CONFREADER_ENOMEM;
+					return NULL;
+				}
+				values = (double *)e->v.p;
+			}
+		}
+		*count = *(int *)(values - 2);
+		return values;
+	}
+	return NULL;
+}
+
+// Matches the whole string with a shell-style pattern: * is any characters, ? is one character,
+// [abc], [a-z] and [!a-z] are one character from the set or not from the set. Case matters.
+int confreader_matchPattern(const char *pat, const char *s){
+	const char *starPat = NULL, *starS = NULL, *p;
+	int in, neg;
+
+	while(*s != 0){
+		if(*pat == '*'){
+			starPat = ++pat;
+			starS = s;
+			continue;
+		}
+		if(*pat == '['){
+			p = pat + 1;
+			neg = *p == '!';
+			if(neg) p++;
+			in = 0;
+			for(; *p != 0 && (*p != ']' || p == pat + 1 + neg); p++){
+				if(p[1] == '-' && p[2] != ']' && p[2] != 0){
+					if((unsigned char)*s >= (unsigned char)p[0] && (unsigned char)*s <= (unsigned char)p[2]) in = 1;
+					p += 2;
+				}else
+				if(*p == *s){
+					in = 1;
+				}
+			}
+			if(*p == ']' && in != neg){
+				pat = p + 1;
+				s++;
+				continue;
+			}
+		}else
+		if(*pat != 0 && (*pat == '?' || *pat == *s)){
+			pat++;
+			s++;
+			continue;
+		}
+		// Mismatch. Let the last star take one more character.
+		if(starPat == NULL) return 0;
+		pat = starPat;
+		s = ++starS;
+	}
+	while(*pat == '*') pat++;
+	return *pat == 0;
+}
+
+// Checks the value of the parameter against the schema entry and adds a diagnostic if it's wrong.
+int confreader_checkValue(ConfreaderParam *p, const ConfreaderSchemaEntry *e){
+	ConfreaderIpAddr ip;
+	ConfreaderEndpoint ep;
+	double n = 0;
+	long long units;
+	int b, hasPort;
+	int kind = 0;
+
+	switch(e->type){
+		case CONFREADER_TYPE_STRING:
+			n = (double)strlen(p->value);
+			break;
+		case CONFREADER_TYPE_INT:
+			if(confreader_isInt(p->value)) n = (double)strtoll(p->value, NULL, 10);
+			else kind = CONFREADER_DIAG_TYPE;
+			break;
+		case CONFREADER_TYPE_DOUBLE:
+			if(confreader_isDouble(p->value)) n = strtod(p->value, NULL);
+			else kind = CONFREADER_DIAG_TYPE;
+			break;
+		case CONFREADER_TYPE_BOOL:
+			if(!confreader_parseBool(p->value, &b)) kind = CONFREADER_DIAG_TYPE;
+			break;
+		case CONFREADER_TYPE_DURATION:
+		case CONFREADER_TYPE_BYTES:
+			if(confreader_parseUnits(p->value, strlen(p->value), e->type == CONFREADER_TYPE_DURATION ? confreader_durationUnits() : confreader_byteUnits(), &units)) n = (double)units;
+			else kind = CONFREADER_DIAG_TYPE;
+			break;
+		case CONFREADER_TYPE_IPADDR:
+			if(!confreader_parseIpAddr(p->value, strlen(p->value), &ip)) kind = CONFREADER_DIAG_TYPE;
+			break;
+		case CONFREADER_TYPE_ENDPOINT:
+			if(!confreader_parseEndpoint(p->value, &ep, &hasPort)) kind = CONFREADER_DIAG_TYPE;
+			break;
+	}
+	if(kind == 0 && (e->flags & CONFREADER_SCHEMA_RANGE) && (n < e->min || n > e->max)){
+		kind = CONFREADER_DIAG_RANGE;
+	}
+	if(kind == 0 && e->pattern != NULL && !confreader_matchPattern(e->pattern, p->value)){
+		kind = CONFREADER_DIAG_PATTERN;
+	}
+	return kind == 0 || confreader_addDiag(p->lineNum, 0, kind, p->key);
+}
+
+// Checks the parsed file against the schema of count entries in one pass over the parameters.
+// The errors are added to confreaderDiags. Returns CONFREADER_OK if the file matches the schema.
+// A schema with the same key twice in a section is rejected with CONFREADER_EINVVAL, without diagnostics.
+int confreaderValidate(const ConfreaderSchemaEntry *schema, int count){
+	int *keySlots, *sectSlots;
+	ConfreaderParam *p;
+	char *seen;
+	int size, mask, i, j, k, s, first;
+	unsigned int h;
+	const char *name;
+	int known, open;
+
+	// Let's put the entries into two hash tables: by the section and the key, and by the section only.
+	// The section table points to the entry with key NULL if the section has it.
+	for(size=16; size < count * 2; size*=2);
+	mask = size - 1;
+	keySlots = (int *)malloc(size * 2 * sizeof(int) + count);
+	if(keySlots == NULL){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+	sectSlots = keySlots + size;
+	seen = (char *)(sectSlots + size);
+	memset(keySlots, 0xFF, size * 2 * sizeof(int));
+	memset(seen, 0, count);
+
+	for(i=0; i<count; i++){
+		for(h=confreader_hashKey(schema[i].section ? schema[i].section : "", 2166136261u); sectSlots[h & mask] >= 0; h++){
+			if(confreader_sameName(schema[sectSlots[h & mask]].section, schema[i].section)) break;
+		}
+		if(sectSlots[h & mask] < 0 || schema[i].key == NULL) sectSlots[h & mask] = i;
+		if(schema[i].key == NULL) continue;
+
+		for(h=confreader_hashKey(schema[i].key, confreader_hashKey(schema[i].section ? schema[i].section : "", 2166136261u)); (k = keySlots[h & mask]) >= 0; h++){
+			if(strcasecmp(schema[k].key, schema[i].key) == 0 && confreader_sameName(schema[k].section, schema[i].section)){
+				free(keySlots);
+				confreaderErrorNum = CONFREADER_EINVVAL;
 				return CONFREADER_ERROR;
 			}
+		}
+		keySlots[h & mask] = i;
+	}
 
-			confreader_params[paramIdx].value = &confreader_fileBuf[i];
-			// Let's find the end of the parameter value.
-			for(; i<fileBufSize; i++){
-				//if(confreader_fileBuf[i] == 0 || confreader_fileBuf[i] == '#' || confreader_fileBuf[i] == ';') break;
-				if(confreader_fileBuf[i] == 0) break;
-				if(confreader_fileBuf[i] == '#' || confreader_fileBuf[i] == ';'){
-					if(confreader_fileBuf[i-1] != ' ' && confreader_fileBuf[i-1] != 0x09){
-						// Error. The comment must be separated by a space character from the value.
-						confreaderClear();
-						confreaderErrorLineNum = lineIdx + 1;
-						confreaderErrorNum = CONFREADER_EPARSINGFILE;
-						return CONFREADER_ERROR;
-					}
-					break;
-				}
+	first = confreaderDiagCount;
+	for(i=0; i<confreaderSectCount; i++){
+		for(h=confreader_hashKey(confreaderSects[i].name ? confreaderSects[i].name : "", 2166136261u); (s = sectSlots[h & mask]) >= 0; h++){
+			if(confreader_sameName(schema[s].section, confreaderSects[i].name)) break;
+		}
+		known = s >= 0;
+		open = known && schema[s].key == NULL;
+		if(!known && i > 0 && !confreader_addDiag(confreaderSects[i].lineNum, 0, CONFREADER_DIAG_UNKNOWN_SECTION, confreaderSects[i].name)) break;
+
+		for(j=0; j<confreaderSects[i].size; j++){
+			p = &confreaderSects[i].params[j];
+			for(h=confreader_hashKey(p->key, confreader_hashKey(confreaderSects[i].name ? confreaderSects[i].name : "", 2166136261u)); (k = keySlots[h & mask]) >= 0; h++){
+				if(strcasecmp(schema[k].key, p->key) == 0 && confreader_sameName(schema[k].section, confreaderSects[i].name)) break;
 			}
-			
-			// We clear the whitespace characters at the end of the value and get the end of the parameter value
-			for(--i; i>=0; i--){
-				if(confreader_fileBuf[i] != ' ' && confreader_fileBuf[i] != 0x09) break;
+			if(k < 0){
+				// The parameters of an unknown section are not reported one by one.
+				if(!open && (known || i == 0) && !confreader_addDiag(p->lineNum, 0, CONFREADER_DIAG_UNKNOWN_KEY, p->key)) break;
+				continue;
 			}
-			// and then put 0 after the end of the parameter value.
-			confreader_fileBuf[++i] = 0;
-			
-			confreaderSects[sectIdx].size++;
-			paramIdx++;
+			seen[k] = 1;
+			if(!confreader_decode(p) || !confreader_checkValue(p, &schema[k])) break;
 		}
+		if(j < confreaderSects[i].size) break;
 	}
 
-	free(confreader_lines);
-	confreader_lines = NULL;
+	for(k=0; k<count && i == confreaderSectCount; k++){
+		if(seen[k] || schema[k].key == NULL || !(schema[k].flags & CONFREADER_SCHEMA_REQUIRED)) continue;
+		// The line of the section is the place where the parameter is missed.
+		name = schema[k].section;
+		for(s=1; s<confreaderSectCount && name != NULL && strcasecmp(name, confreaderSects[s].name) != 0; s++);
+		if(!confreader_addDiag(name == NULL || s == confreaderSectCount ? 0 : confreaderSects[s].lineNum, 0, CONFREADER_DIAG_MISSING_KEY, schema[k].key)) i = -1;
+	}
+	free(keySlots);
+
+	if(i != confreaderSectCount){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+	if(confreaderDiagCount > first){
+		qsort(confreaderDiags, confreaderDiagCount, sizeof(ConfreaderDiagnostic), confreader_compareDiags);
+		confreaderErrorNum = CONFREADER_EINVVAL;
+		return CONFREADER_ERROR;
+	}
 	confreaderErrorNum = CONFREADER_OK;
 	return CONFREADER_OK;
 }
 
-char * confreaderFind(const char *key, const char *section){
-	int j;
+// Writes all the sections and parameters to the file, without the comments. The file is replaced atomically.
+int confreaderWriteFile(const char *filename){
+	struct iovec iov;
+	char *buf;
+	size_t size = 0, len;
+	int i, j;
 
-	if(confreader_fileBuf){
-		if(section == NULL){
-			for(j=0; j<confreaderSects[0].size; j++){
-				if(strcasecmp(key, confreaderSects[0].params[j].key) == 0){
-					confreaderErrorNum = CONFREADER_OK;
-					return confreaderSects[0].params[j].value;
+	// Let's count the size of the text first, so that it is built in one buffer.
+	for(i=0; i<confreaderSectCount; i++){
+		if(i > 0) size += (size > 0 ? 1 : 0) + strlen(confreaderSects[i].name) + 3;
+		for(j=0; j<confreaderSects[i].size; j++){
+			if(!confreader_decode(&confreaderSects[i].params[j])){
+				confreaderErrorNum = CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
+			}
+			size += strlen(confreaderSects[i].params[j].key) + 3 + confreader_formatValue(confreaderSects[i].params[j].value, NULL) + 1;
+		}
+	}
+
+	buf = (char *)malloc(size + 1);
+	if(buf == NULL){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+	size = 0;
+	for(i=0; i<confreaderSectCount; i++){
+		if(i > 0){
+			if(size > 0) buf[size++] = 0x0A;
+			buf[size++] = '[';
+			len = strlen(confreaderSects[i].name);
+			memcpy(&buf[size], confreaderSects[i].name, len);
+			size += len;
+			buf[size++] = ']';
+			buf[size++] = 0x0A;
+		}
+		for(j=0; j<confreaderSects[i].size; j++){
+			len = strlen(confreaderSects[i].params[j].key);
+			memcpy(&buf[size], confreaderSects[i].params[j].key, len);
+			size += len;
+			memcpy(&buf[size], " = ", 3);
+			size += 3;
+			size += confreader_formatValue(confreaderSects[i].params[j].value, &buf[size]);
+			buf[size++] = 0x0A;
+		}
+	}
+
+	iov.iov_base = buf;
+	iov.iov_len = size;
+	i = confreader_writeAtomic(filename, &iov, 1);
+	free(buf);
+	return i;
+}
+
+// Changes the parameters in the file this object was parsed from. Only the changed values are rewritten,
+// the comments and the layout stay. New parameters are added after the last parameter of the section,
+// new sections at the end of the file. The file is replaced atomically. The object is not changed,
+// parse the file again to read the new values. If the file was changed since parsing, confreaderErrorNum is CONFREADER_EBUSY.
+// A name that can't be written to the file, or the same parameter changed twice, gives CONFREADER_EINVVAL.
+int confreaderPatchFile(const char *filename, const ConfreaderChange *changes, int count){
+	struct iovec *iov;
+	ConfreaderEdit *edits;
+	ConfreaderParam *p;
+	char *text, *buf, *dst;
+	ssize_t size = 0;
+	size_t bufSize = 0;
+	int i, j, k, n, pos, editCount = 0, iovCount = 0;
+	int lineFeedAdded = 0;
+
+	// The names must read back as they are, and a parameter can be changed only once.
+	for(i=0; i<count; i++){
+		if(!confreader_isFileName(changes[i].key, 0) || (changes[i].section != NULL && !confreader_isFileName(changes[i].section, 1))){
+			confreaderErrorNum = CONFREADER_EINVVAL;
+			return CONFREADER_ERROR;
+		}
+		for(j=0; j<i; j++){
+			if(strcasecmp(changes[j].key, changes[i].key) == 0 && confreader_sameName(changes[j].section, changes[i].section)){
+				confreaderErrorNum = CONFREADER_EINVVAL;
+				return CONFREADER_ERROR;
+			}
+		}
+	}
+
+	// Let's read the file again, the values are replaced in the original text. The offsets of the values
+	// are right only for the same text, so it must have the size and the hash of the parsed file.
+	text = confreader_readFile(filename, &size);
+	if(text == NULL && confreaderErrorNum != CONFREADER_OK) return CONFREADER_ERROR;
+	if(size != confreader_fileSize || (size > 0 && confreader_hash64(text, size, 0) != confreader_fingerprint)){
+		free(text);
+		confreaderErrorNum = CONFREADER_EBUSY;
+		return CONFREADER_ERROR;
+	}
+
+	for(i=0; i<count; i++){
+		bufSize += strlen(changes[i].key) + (changes[i].section ? strlen(changes[i].section) : 0) + 16;
+		if(changes[i].value) bufSize += confreader_formatValue(changes[i].value, NULL);
+	}
+	edits = (ConfreaderEdit *)malloc((count + 1) * sizeof(ConfreaderEdit));
+	iov = (struct iovec *)malloc((count * 2 + 1) * sizeof(struct iovec));
+	buf = dst = (char *)malloc(bufSize + 1);
+	if(edits == NULL || iov == NULL || buf == NULL){
+		free(edits);
+		free(iov);
+		free(buf);
+		free(text);
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	for(i=0; i<count; i++){
+		edits[editCount].seq = i;
+		edits[editCount].text = dst;
+
+		if((p = confreader_lookup(changes[i].key, changes[i].section)) != NULL && p->lineNum > 0){
+			if(changes[i].value != NULL){
+				// Only the value is replaced, the comment after it stays.
+				edits[editCount].start = p->valueStart;
+				edits[editCount].end = p->valueEnd;
+				dst += confreader_formatValue(changes[i].value, dst);
+			}else{
+				// The whole line of the parameter is removed.
+				for(pos=p->valueStart; pos>confreader_bomSize && text[pos - 1] != 0x0A; pos--);
+				edits[editCount].start = pos;
+				for(pos=p->valueEnd; pos<size && text[pos++] != 0x0A; );
+				edits[editCount].end = pos;
+			}
+		}else
+		if(changes[i].value != NULL){
+			for(k=0; k<confreaderSectCount && !confreader_sameName(confreaderSects[k].name, changes[i].section); k++);
+			// The sections and parameters added by confreaderApplyOverrides() are not in the file.
+			if(k > 0 && k < confreaderSectCount && confreaderSects[k].lineNum == 0) k = confreaderSectCount;
+			for(n=(k < confreaderSectCount ? confreaderSects[k].size : 0); n > 0 && confreaderSects[k].params[n - 1].lineNum == 0; n--);
+			if(k < confreaderSectCount && (n > 0 || k > 0)){
+				// After the line of the last parameter or the section name. The parameters can be ordered by the profile.
+				pos = k > 0 ? confreaderSects[k].name - confreader_fileBuf : 0;
+				for(j=0; j<n; j++){
+					if(confreaderSects[k].params[j].valueEnd > pos) pos = confreaderSects[k].params[j].valueEnd;
 				}
+				for(; pos<size && text[pos++] != 0x0A; );
+			}else
+			if(changes[i].section == NULL){
+				pos = size > 0 ? confreader_bomSize : 0;
+			}else{
+				pos = size;
 			}
-		}else{
-			for(int i=1; i<confreaderSectCount; i++){
-				if(strcasecmp(section, confreaderSects[i].name) == 0){
-					for(j=0; j<confreaderSects[i].size; j++){
-						if(strcasecmp(key, confreaderSects[i].params[j].key) == 0){
-							confreaderErrorNum = CONFREADER_OK;
-							return confreaderSects[i].params[j].value;
-						}
-					}
-					break;
+
+			if(pos == size && size > 0 && text[size - 1] != 0x0A && !lineFeedAdded){
+				*dst++ = 0x0A;
+				lineFeedAdded = 1;
+			}
+			if(k == confreaderSectCount && changes[i].section != NULL){
+				// The first parameter of a new section adds the section.
+				for(j=0; j<i && !(changes[j].value != NULL && confreader_sameName(changes[j].section, changes[i].section)); j++);
+				if(j == i){
+					if(dst > edits[editCount].text || pos > 0) *dst++ = 0x0A;
+					dst += sprintf(dst, "[%s]\n", changes[i].section);
 				}
 			}
+			dst += sprintf(dst, "%s = ", changes[i].key);
+			dst += confreader_formatValue(changes[i].value, dst);
+			*dst++ = 0x0A;
+			edits[editCount].start = edits[editCount].end = pos;
+		}else{
+			continue;		// There is nothing to remove.
 		}
+		edits[editCount].len = dst - edits[editCount].text;
+		editCount++;
 	}
-	confreaderErrorNum = CONFREADER_ENOPARAM;
-	return NULL;
+
+	// The parts of the file between the edits are written as they are.
+	qsort(edits, editCount, sizeof(ConfreaderEdit), confreader_compareEdits);
+	pos = 0;
+	for(i=0; i<editCount; i++){
+		if(edits[i].start < pos){		// The same parameter is changed twice.
+			break;
+		}
+		if(edits[i].start > pos){
+			iov[iovCount].iov_base = &text[pos];
+			iov[iovCount++].iov_len = edits[i].start - pos;
+		}
+		if(edits[i].len > 0){
+			iov[iovCount].iov_base = (void *)edits[i].text;
+			iov[iovCount++].iov_len = edits[i].len;
+		}
+		pos = edits[i].end;
+	}
+	if(pos < size){
+		iov[iovCount].iov_base = &text[pos];
+		iov[iovCount++].iov_len = size - pos;
+	}
+
+	if(i < editCount){
+		confreaderErrorNum = CONFREADER_EINVVAL;
+		i = CONFREADER_ERROR;
+	}else{
+		i = confreader_writeAtomic(filename, iov, iovCount);
+	}
+	free(edits);
+	free(iov);
+	free(buf);
+	free(text);
+	return i;
 }
 
-int confreaderHasSection(const char *section){
-	int i;
+// Writes all the parameters as JSON or as section.key=value lines to dst. If dst is NULL, only counts the length.
+// Returns the length or -1 if a value can't be decoded.
+int confreader_dump(char *dst, int json){
+	ConfreaderParam *p;
+	int len = 0, i, j;
 
-	for(i=1; i<confreaderSectCount; i++){
-		if(strcasecmp(section, confreaderSects[i].name) == 0){
-			return 1;
+	if(json) len = confreader_put(dst, len, "{", 1);
+	for(i=0; i<confreaderSectCount; i++){
+		if(json && i > 0){
+			if(len > 1) len = confreader_put(dst, len, ",", 1);
+			len = confreader_jsonString(confreaderSects[i].name, dst, len);
+			len = confreader_put(dst, len, ":{", 2);
 		}
+		for(j=0; j<confreaderSects[i].size; j++){
+			p = &confreaderSects[i].params[j];
+			if(!confreader_decode(p)) return -1;
+			if(json){
+				if(j > 0) len = confreader_put(dst, len, ",", 1);
+				len = confreader_jsonString(p->key, dst, len);
+				len = confreader_put(dst, len, ":", 1);
+				len = confreader_jsonString(p->value, dst, len);
+			}else{
+				if(i > 0){
+					len = confreader_put(dst, len, confreaderSects[i].name, strlen(confreaderSects[i].name));
+					len = confreader_put(dst, len, ".", 1);
+				}
+				len = confreader_put(dst, len, p->key, strlen(p->key));
+				len = confreader_put(dst, len, "=", 1);
+				len += confreader_formatValue(p->value, dst ? &dst[len] : NULL);
+				len = confreader_put(dst, len, "\n", 1);
+			}
+		}
+		if(json && i > 0) len = confreader_put(dst, len, "}", 1);
 	}
-	confreaderErrorNum = CONFREADER_ENOSECT;
-	return 0;
+	if(json) len = confreader_put(dst, len, "}", 1);
+	return len;
 }
 
-int confreaderHas(const char *key, const char *section){
-	if(confreaderFind(key, section) != NULL){
-		return 1;
+// Counts the length of the text first, so that it is written into the buffer without checking the size.
+int confreader_dumpTo(char *buf, int size, int json){
+	int len;
+
+	if((len = confreader_dump(NULL, json)) < 0 || (buf && len < size && confreader_dump(buf, json) < 0)){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
 	}
-	return 0;
+	if(buf && len < size) buf[len] = 0;
+	confreaderErrorNum = CONFREADER_OK;
+	return len;
 }
 
-char confreaderGetChar(const char *key, const char *section, char defaultValue){
-	char *val;
-	
-	if((val = confreaderFind(key, section)) != NULL){
-		return val[0];
+// Writes all the sections and parameters as JSON to buf: the parameters without section are the members
+// of the object, each section is an object member. All values are strings. Works like snprintf: returns
+// the length of the text without the ending 0, so confreaderToJson(NULL, 0) gives the size of the buffer minus one.
+// If the text with the ending 0 doesn't fit into size bytes, nothing is written.
+int confreaderToJson(char *buf, int size){
+	return confreader_dumpTo(buf, size, 1);
+}
+
+// The same as confreaderToJson(), but the text is lines of section.key=value, or key=value for the parameters
+// without section. The values are written as in the file, in double quotes if it is needed.
+int confreaderToFlat(char *buf, int size){
+	return confreader_dumpTo(buf, size, 0);
+}
+
+// The character of the environment variable name: letters in upper case, "_" for all except letters and digits.
+char confreader_envChar(char c){
+	if(c >= 'a' && c <= 'z') return c - 32;
+	if((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return c;
+	return '_';
+}
+
+// FNV-1a hash of the name as in the environment variable, up to 0 or the end character.
+unsigned int confreader_envHash(const char *s, char end, unsigned int h){
+	for(; *s != 0 && *s != end; s++){
+		h = (h ^ (unsigned char)confreader_envChar(*s)) * 16777619u;
 	}
-	return defaultValue;
+	return h;
 }
 
-char * confreaderGetString(const char *key, const char *section, const char *defaultValue){
-	char *val;
-	
-	if((val = confreaderFind(key, section)) != NULL){
-		return val;
+// Compares the name of the variable up to "=" with the section, "_" and the key.
+// Returns the value of the variable or NULL.
+const char * confreader_envMatch(const char *name, const char *section, const char *key){
+	if(section){
+		for(; *section != 0; section++, name++){
+			if(*name == '=' || *name != confreader_envChar(*section)) return NULL;
+		}
+		if(*name++ != '_') return NULL;
 	}
-	return (char *)defaultValue;
+	for(; *key != 0; key++, name++){
+		if(*name == '=' || *name != confreader_envChar(*key)) return NULL;
+	}
+	return *name == '=' ? name + 1 : NULL;
 }
 
-int confreaderGetInt(const char *key, const char *section, int defaultValue){
-	char *val;
-	int k;
-	
-	if((val = confreaderFind(key, section)) != NULL){
-		if((val[0] < '0' || val[0] > '9') && val[0] != '-'){
-			confreaderErrorNum = CONFREADER_EINVVAL;
-			return defaultValue;
+// Copies the string into the arena.
+char * confreader_copyString(const char *s, size_t len){
+	char *copy;
+
+	if((copy = (char *)confreader_alloc(len + 1)) != NULL){
+		memcpy(copy, s, len);
+		copy[len] = 0;
+	}
+	return copy;
+}
+
+// Replaces the value of the parameter. The converted value cached on the parameter is dropped.
+void confreader_setValue(ConfreaderParam *p, char *val){
+	p->value = val;
+	p->flags = 0;
+	memset(&p->cache, 0, sizeof(ConfreaderCache));
+}
+
+// Overrides the parameters with the environment variables which start with the prefix. The parameters are put
+// into a hash table by the names of their variables, so environ is read once.
+int confreader_applyEnv(const char *prefix){
+	ConfreaderEnvSlot *slots;
+	const char *val;
+	char *copy;
+	unsigned int h, mask;
+	size_t prefixLen;
+	int count = 0, i, j;
+	char **env;
+
+	for(i=0; i<confreaderSectCount; i++) count += confreaderSects[i].size;
+	if(count == 0) return 1;
+	for(mask=15; mask < (unsigned int)count * 2; mask=mask*2+1);
+	slots = (ConfreaderEnvSlot *)calloc(mask + 1, sizeof(ConfreaderEnvSlot));
+	if(slots == NULL) return 0;
+
+	for(i=0; i<confreaderSectCount; i++){
+		for(j=0; j<confreaderSects[i].size; j++){
+			h = i > 0 ? confreader_envHash("_", 0, confreader_envHash(confreaderSects[i].name, 0, 2166136261u)) : 2166136261u;
+			for(h=confreader_envHash(confreaderSects[i].params[j].key, 0, h); slots[h & mask].param; h++);
+			slots[h & mask].param = &confreaderSects[i].params[j];
+			slots[h & mask].section = confreaderSects[i].name;
 		}
-		for(k=1; val[k]!=0; k++){
-			if(val[k] < '0' || val[k] > '9'){
-				confreaderErrorNum = CONFREADER_EINVVAL;
-				return defaultValue;
+	}
+
+	prefixLen = strlen(prefix);
+	for(env=environ; *env; env++){
+		if(strncmp(*env, prefix, prefixLen) != 0) continue;
+		// All the parameters with this name are overridden, e.g. a key which is repeated in the section.
+		for(h=confreader_envHash(*env + prefixLen, '=', 2166136261u); slots[h & mask].param; h++){
+			if((val = confreader_envMatch(*env + prefixLen, slots[h & mask].section, slots[h & mask].param->key)) == NULL) continue;
+			if((copy = confreader_copyString(val, strlen(val))) == NULL){
+				free(slots);
+				return 0;
 			}
+			confreader_setValue(slots[h & mask].param, copy);
 		}
+	}
+	free(slots);
+	return 1;
+}
 
-		return strtol(val, NULL, 10);
+// Adds the parameters which are not in the file, at the end of their sections. The new sections are added
+// at the end. The arrays of the sections and the parameters are built again, so that each section
+// stays a contiguous part of the parameters.
+int confreader_addParams(const ConfreaderChange *adds, int addCount){
+	ConfreaderSection *newSects;
+	ConfreaderParam *newParams, *p;
+	int *target;
+	int count = 0, newSectCount, i, j, k;
+
+	for(i=0; i<confreaderSectCount; i++) count += confreaderSects[i].size;
+	newSects = (ConfreaderSection *)malloc((confreaderSectCount + addCount + 1) * sizeof(ConfreaderSection));
+	newParams = (ConfreaderParam *)malloc((count + addCount) * sizeof(ConfreaderParam));
+	target = (int *)malloc(addCount * sizeof(int));
+	if(newSects == NULL || newParams == NULL || target == NULL){
+		free(newSects);
+		free(newParams);
+		free(target);
+		return 0;
 	}
-	return defaultValue;
+
+	if(confreaderSectCount > 0){
+		memcpy(newSects, confreaderSects, confreaderSectCount * sizeof(ConfreaderSection));
+		newSectCount = confreaderSectCount;
+	}else{
+		newSects[0].name = NULL;			// The file was empty.
+		newSects[0].size = 0;
+		newSects[0].hits = 0;
+		newSects[0].lineNum = 0;
+		newSects[0].hash = 0;
+		newSectCount = 1;
+	}
+	for(i=0; i<addCount; i++){
+		for(k=0; k<newSectCount && !confreader_sameName(newSects[k].name, adds[i].section); k++);
+		if(k == newSectCount){
+			newSects[k].name = (char *)adds[i].section;
+			newSects[k].size = 0;
+			newSects[k].hits = 0;
+			newSects[k].lineNum = 0;
+			newSects[k].hash = 0;
+			newSectCount++;
+		}
+		target[i] = k;
+	}
+
+	p = newParams;
+	for(k=0; k<newSectCount; k++){
+		if(k < confreaderSectCount && confreaderSects[k].size > 0) memcpy(p, confreaderSects[k].params, confreaderSects[k].size * sizeof(ConfreaderParam));
+		newSects[k].params = p;
+		p += newSects[k].size;
+		for(i=0; i<addCount; i++){
+			if(target[i] != k) continue;
+			p->key = (char *)adds[i].key;
+			p->value = (char *)adds[i].value;
+			p->flags = 0;
+			p->lineNum = 0;
+			p->hits = 0;
+			p->valueStart = p->valueEnd = -1;
+			memset(&p->cache, 0, sizeof(ConfreaderCache));
+			p++;
+			newSects[k].size++;
+		}
+	}
+	for(j=0; j<newSectCount; j++){
+		if(newSects[j].size == 0) newSects[j].params = NULL;
+	}
+
+	free(target);
+	free(confreaderSects);
+	free(confreader_params);
+	confreaderSects = newSects;
+	confreaderSectCount = newSectCount;
+	confreader_params = newParams;
+	confreader_paramCount = count + addCount;
+	confreader_buildBlooms();
+	confreader_changed();
+	return 1;
 }
 
-double confreaderGetDouble(const char *key, const char *section, double defaultValue){
-	char *val;
-	int k;
-	
-	if((val = confreaderFind(key, section)) != NULL){
-		if((val[0] < '0' || val[0] > '9') && val[0] != '-'){
-			confreaderErrorNum = CONFREADER_EINVVAL;
-			return defaultValue;
+// Overrides the parameters with the environment variables and the command line arguments, after parseFile().
+// The values are put into the parameters, so the lookups find the effective value at once.
+// The variable of a parameter is the prefix, the section name, "_" and the key, in upper case and with "_"
+// for the characters other than letters and digits: APP_DBACCESS_PORT for the key port of the section dbaccess.
+// The arguments are --<argPrefix>section.key=value or --<argPrefix>key=value, as main() gets them, e.g.
+// --conf.dbaccess.port=3334 with the argPrefix "conf.". They are applied after the environment and can add
+// the parameters which are not in the file. The arguments without the prefix belong to the program and are skipped.
+// envPrefix, argPrefix or argv can be NULL, no arguments are applied without argPrefix.
+// Call it before other threads read the values, and before confreaderFreeze().
+int confreaderApplyOverrides(const char *envPrefix, const char *argPrefix, int argc, char **argv){
+	ConfreaderChange *adds = NULL;
+	const char *arg, *dot, *eq;
+	char *copy;
+	ConfreaderParam *p;
+	size_t prefixLen;
+	int addCount = 0, i, k;
+	int ok = 1;
+
+	// The frozen parameters are read-only.
+	if(confreader_frozen){
+		confreaderErrorNum = CONFREADER_EBUSY;
+		return CONFREADER_ERROR;
+	}
+
+	// The values are changed in the parsed file, call confreaderReplicate() again after this.
+	confreader_freeReplicas();
+
+	if(envPrefix && !confreader_applyEnv(envPrefix)){
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	if(argPrefix && argv && argc > 1){
+		adds = (ConfreaderChange *)malloc((argc - 1) * sizeof(ConfreaderChange));
+		if(adds == NULL){
+			confreaderErrorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
 		}
-		for(k=1; val[k]!=0; k++){
-			if((val[k] < '0' || val[k] > '9') && val[k] != '.'){
-				confreaderErrorNum = CONFREADER_EINVVAL;
-				return defaultValue;
-			}
+	}
+	prefixLen = argPrefix ? strlen(argPrefix) : 0;
+	for(i=1; adds && i<argc; i++){
+		arg = argv[i];
+		if(strcmp(arg, "--") == 0) break;
+		if(arg[0] != '-' || arg[1] != '-' || strncmp(arg + 2, argPrefix, prefixLen) != 0 || (eq = strchr(arg + 2 + prefixLen, '=')) == NULL) continue;
+		arg += 2 + prefixLen;
+		// The section name can have dots, the key is after the last one.
+		for(dot=eq; dot>arg && *dot != '.'; dot--);
+		if(eq == arg || (*dot == '.' && dot + 1 == eq)) continue;
+
+		// Let's copy the section, the key and the value as strings.
+		if((copy = confreader_copyString(arg, strlen(arg))) == NULL){
+			ok = 0;
+			break;
+		}
+		copy[eq - arg] = 0;
+		adds[addCount].section = NULL;
+		adds[addCount].key = copy;
+		adds[addCount].value = &copy[eq - arg + 1];
+		if(*dot == '.'){
+			copy[dot - arg] = 0;
+			adds[addCount].section = copy;
+			adds[addCount].key = &copy[dot - arg + 1];
 		}
 
-		return strtod(val, NULL);
+		if((p = confreader_lookup(adds[addCount].key, adds[addCount].section)) != NULL){
+			confreader_setValue(p, (char *)adds[addCount].value);
+			continue;
+		}
+		// The same new parameter can be given again.
+		for(k=0; k<addCount && !(confreader_sameName(adds[k].section, adds[addCount].section) && confreader_sameName(adds[k].key, adds[addCount].key)); k++);
+		if(k < addCount){
+			adds[k].value = adds[addCount].value;
+		}else{
+			addCount++;
+		}
 	}
-	return defaultValue;
+
+	if(!ok || (addCount > 0 && !confreader_addParams(adds, addCount))){
+		free(adds);
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+	free(adds);
+	confreaderErrorNum = CONFREADER_OK;
+	return CONFREADER_OK;
 }
 
-int confreaderGetBool(const char *key, const char *section, int defaultValue){
-	char *val;
-	int ret;
-	
-	if((val = confreaderFind(key, section)) != NULL){
-		if(strcasecmp(val, "yes") == 0 || strcasecmp(val, "true") == 0 || (val[0] == '1' && val[1] == 0)){
-			return 1;
+// Copies the parsed file into the memory of each NUMA node, after confreaderParseFile() and confreaderApplyOverrides().
+// Then the lookups of a thread read the copy of its node. On a machine with one node nothing is copied.
+// The memory is bound to the node with mbind(). If the system doesn't allow it, nothing is copied, since all
+// the copies would be written by this thread and so be in the memory of its node.
+int confreaderReplicate(){
+	unsigned char nodes[CONFREADER_MAX_NODES];
+	unsigned long mask[CONFREADER_MAX_NODES / (8 * sizeof(unsigned long))];
+	unsigned char *cpus;
+	char path[64], *buf;
+	ConfreaderParam *params;
+	ConfreaderSection *rs;
+	unsigned long long *blooms;
+	size_t bufSize, bloomWords = 0, memSize;
+	int nodeCount, n, i, j;
+
+	confreader_freeReplicas();
+	confreaderErrorNum = CONFREADER_OK;
+	if(confreader_frozen){
+		confreaderErrorNum = CONFREADER_EBUSY;
+		return CONFREADER_ERROR;
+	}
+	if(confreader_fileBuf == NULL) return CONFREADER_OK;
+
+	memset(nodes, 0, sizeof(nodes));
+	nodeCount = confreader_readList("/sys/devices/system/node/online", nodes, CONFREADER_MAX_NODES);
+	confreader_cpuCount = confreader_readList("/sys/devices/system/cpu/possible", NULL, 0);
+	if(nodeCount <= 1 || nodeCount > CONFREADER_MAX_NODES || confreader_cpuCount <= 0){
+		confreader_cpuCount = 0;
+		return CONFREADER_OK;		// One node or the topology is unknown.
+	}
+
+	confreader_cpuNodes = (int *)calloc(confreader_cpuCount, sizeof(int));
+	cpus = (unsigned char *)malloc(confreader_cpuCount);
+	confreader_replicas = (ConfreaderReplica *)calloc(nodeCount, sizeof(ConfreaderReplica));
+	if(confreader_cpuNodes == NULL || cpus == NULL || confreader_replicas == NULL){
+		free(cpus);
+		confreader_freeReplicas();
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+	confreader_replicaCount = nodeCount;
+	for(n=0; n<nodeCount; n++){
+		if(!nodes[n]) continue;
+		memset(cpus, 0, confreader_cpuCount);
+		sprintf(path, "/sys/devices/system/node/node%d/cpulist", n);
+		confreader_readList(path, cpus, confreader_cpuCount);
+		for(i=0; i<confreader_cpuCount; i++){
+			if(cpus[i]) confreader_cpuNodes[i] = n;
 		}
-		if(strcasecmp(val, "no") == 0 || strcasecmp(val, "false") == 0 || (val[0] == '0' && val[1] == 0)){
-			return 0;
+	}
+	free(cpus);
+
+	// One block for each node: the file buffer, the parameters, the sections and the filters.
+	bufSize = (confreader_fileSize + 1 + 15) & ~(size_t)15;
+	for(i=0; i<confreaderSectCount; i++){
+		if(confreaderSects[i].bloom) bloomWords += (confreaderSects[i].bloomMask + 1) / 64;
+	}
+	memSize = bufSize + confreader_paramCount * sizeof(ConfreaderParam) + confreaderSectCount * sizeof(ConfreaderSection) + bloomWords * sizeof(unsigned long long);
+
+	for(n=0; n<nodeCount; n++){
+		if(!nodes[n]) continue;
+		confreader_replicas[n].mem = mmap(NULL, memSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(confreader_replicas[n].mem == MAP_FAILED){
+			confreader_replicas[n].mem = NULL;
+			confreader_freeReplicas();
+			confreaderErrorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
 		}
-		
-		confreaderErrorNum = CONFREADER_EINVVAL;
-		return defaultValue;
+		confreader_replicas[n].memSize = memSize;
+		memset(mask, 0, sizeof(mask));
+		mask[n / (8 * sizeof(unsigned long))] = 1UL << (n % (8 * sizeof(unsigned long)));
+		// The pages are not touched yet, so they are allocated on the node when they are written below.
+		if(syscall(SYS_mbind, confreader_replicas[n].mem, memSize, CONFREADER_MPOL_BIND, mask, CONFREADER_MAX_NODES, 0) != 0){
+			confreader_freeReplicas();
+			return CONFREADER_OK;
+		}
+
+		buf = (char *)confreader_replicas[n].mem;
+		params = (ConfreaderParam *)(buf + bufSize);
+		rs = (ConfreaderSection *)(params + confreader_paramCount);
+		blooms = (unsigned long long *)(rs + confreaderSectCount);
+		memcpy(buf, confreader_fileBuf, confreader_fileSize + 1);
+		memcpy(params, confreader_params, confreader_paramCount * sizeof(ConfreaderParam));
+		memcpy(rs, confreaderSects, confreaderSectCount * sizeof(ConfreaderSection));
+		if(bloomWords > 0) memcpy(blooms, confreader_blooms, bloomWords * sizeof(unsigned long long));
+
+		for(i=0; i<confreaderSectCount; i++){
+			rs[i].name = confreader_rebase(rs[i].name, buf);
+			if(rs[i].params) rs[i].params = params + (confreaderSects[i].params - confreader_params);
+			if(rs[i].bloom) rs[i].bloom = blooms + (confreaderSects[i].bloom - confreader_blooms);
+			for(j=0; j<rs[i].size; j++){
+				rs[i].params[j].key = confreader_rebase(rs[i].params[j].key, buf);
+				rs[i].params[j].value = confreader_rebase(rs[i].params[j].value, buf);
+			}
+		}
+		confreader_replicas[n].sects = rs;
 	}
-	return defaultValue;
+	confreader_changed();
+	CONFREADER_PROBE(replicate, nodeCount, memSize);
+	return CONFREADER_OK;
+}
+
+int confreader_inFile(const char *s){
+	return confreader_fileBuf != NULL && s >= confreader_fileBuf && s <= confreader_fileBuf + confreader_fileSize;
+}
+
+// Moves a string into the frozen block: into the copy of the file, or after it if it is not in the file.
+char * confreader_freezeString(char *s, char *buf, char **tail){
+	char *copy;
+
+	if(s == NULL) return NULL;
+	if(confreader_inFile(s)) return buf + (s - confreader_fileBuf);
+	copy = *tail;
+	strcpy(copy, s);
+	*tail += strlen(s) + 1;
+	return copy;
+}
+
+// Moves the parsed data into one block of memory which is made read-only, after confreaderParseFile() and
+// confreaderApplyOverrides(). In a server which forks after it, the pages of the block stay shared by the processes,
+// since nothing writes them: the values are decoded at once, and the converted values and the counters of the reads
+// are kept in other memory. confreaderReplicate() and confreaderApplyOverrides() return CONFREADER_EBUSY after it.
+// The file buffer and the arena are freed, so the strings and the arrays returned before confreaderFreeze() must not
+// be used after it, get them again. If the block can't be made read-only, the parsed data stays not frozen.
+int confreaderFreeze(){
+	ConfreaderSection *fs;
+	ConfreaderParam *fp, *p;
+	ConfreaderParamState *states;
+	unsigned long long *fb;
+	char *buf, *tail;
+	void *mem;
+	size_t bufSize, strSize = 0, bloomWords = 0, size, pageSize;
+	int paramCount = 0, i, j;
+
+	confreaderErrorNum = CONFREADER_OK;
+	if(confreader_frozen || confreaderSectCount == 0) return CONFREADER_OK;
+	confreader_freeReplicas();
+
+	// The strings which are not in the file: the decoded values and the overrides.
+	for(i=0; i<confreaderSectCount; i++){
+		if(confreaderSects[i].name && !confreader_inFile(confreaderSects[i].name)) strSize += strlen(confreaderSects[i].name) + 1;
+		if(confreaderSects[i].bloom) bloomWords += (confreaderSects[i].bloomMask + 1) / 64;
+		for(j=0; j<confreaderSects[i].size; j++){
+			p = &confreaderSects[i].params[j];
+			if(!confreader_decode(p)){
+				confreaderErrorNum = CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
+			}
+			if(!confreader_inFile(p->key)) strSize += strlen(p->key) + 1;
+			if(!confreader_inFile(p->value)) strSize += strlen(p->value) + 1;
+		}
+		paramCount += confreaderSects[i].size;
+	}
+	bufSize = confreader_fileBuf ? confreader_fileSize + 1 : 0;
+	pageSize = sysconf(_SC_PAGESIZE);
+	size = confreaderSectCount * sizeof(ConfreaderSection) + paramCount * sizeof(ConfreaderParam)
+		+ bloomWords * sizeof(unsigned long long) + bufSize + strSize;
+	size = (size + pageSize - 1) & ~(pageSize - 1);
+
+	states = (ConfreaderParamState *)calloc(paramCount > 0 ? paramCount : 1, sizeof(ConfreaderParamState));
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(states == NULL || mem == MAP_FAILED){
+		free(states);
+		if(mem != MAP_FAILED) munmap(mem, size);
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	// The sections, the parameters, the filters, the file and the other strings.
+	fs = (ConfreaderSection *)mem;
+	fp = (ConfreaderParam *)(fs + confreaderSectCount);
+	fb = (unsigned long long *)(fp + paramCount);
+	buf = (char *)(fb + bloomWords);
+	tail = buf + bufSize;
+	if(bufSize > 0) memcpy(buf, confreader_fileBuf, bufSize);
+	memcpy(fs, confreaderSects, confreaderSectCount * sizeof(ConfreaderSection));
+	p = fp;
+	for(i=0; i<confreaderSectCount; i++){
+		fs[i].name = confreader_freezeString(fs[i].name, buf, &tail);
+		if(fs[i].params){
+			memcpy(p, confreaderSects[i].params, confreaderSects[i].size * sizeof(ConfreaderParam));
+			fs[i].params = p;
+			for(j=0; j<fs[i].size; j++, p++){
+				p->key = confreader_freezeString(p->key, buf, &tail);
+				p->value = confreader_freezeString(p->value, buf, &tail);
+				memset(&p->cache, 0, sizeof(ConfreaderCache));
+				states[p - fp].hits = p->hits;
+			}
+		}
+		if(fs[i].bloom){
+			memcpy(fb, confreaderSects[i].bloom, (confreaderSects[i].bloomMask + 1) / 8);
+			fs[i].bloom = fb;
+			fb += (confreaderSects[i].bloomMask + 1) / 64;
+		}
+	}
+	if(mprotect(mem, size, PROT_READ) != 0){
+		munmap(mem, size);
+		free(states);
+		confreaderErrorNum = CONFREADER_ENOMEM;
+		return CONFREADER_ERROR;
+	}
+
+	// The parsed data is not needed any more, the converted values are converted again.
+	free(confreader_fileBuf);
+	free(confreader_params);
+	free(confreader_blooms);
+	free(confreaderSects);
+	free(confreader_lines);
+	free(confreader_lineEnds);
+	confreader_freeArena();
+	confreader_lines = NULL;
+	confreader_lineEnds = NULL;
+	confreader_params = NULL;
+	confreader_blooms = NULL;
+
+	confreaderSects = fs;
+	confreader_fileBuf = bufSize > 0 ? buf : NULL;
+	confreader_frozen = mem;
+	confreader_frozenSize = size;
+	confreader_frozenParams = fp;
+	confreader_states = states;
+	confreader_changed();
+	return CONFREADER_OK;
 }
 
 #endif	// __CONFREADER_H_
@@ -24,6 +24,7 @@ ParamWithoutSection = yes
 ParamWithSection = 123456
 
 confreader supports comments at the end of lines, after the parameter value. The comment must be separated by at least one space character.
+A value in double quotes may contain spaces at the ends, comment characters and C-style escape sequences.
 
 Usage:
 1 - Read content into mem and then parse it.
@@ -35,6 +36,43 @@ Usage:
 #ifndef __CONFREADER_HPP_
 #define __CONFREADER_HPP_
 
+// Needed for the network addresses.
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+// Needed for writing the file.
+#include <sys/uio.h>
+#include <errno.h>
+
+// The environment variables for applyOverrides().
+extern char **environ;
+
+// Needed for the NUMA replicas.
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS		MAP_ANON
+#endif
+
+#define CONFREADER_MAX_NODES		1024	// The largest number of NUMA nodes for replicate().
+#define CONFREADER_MPOL_BIND		2		// MPOL_BIND of mbind(), without libnuma.
+#define CONFREADER_NODE_CHECK		64		// Lookups of a thread between the reads of its CPU.
+
+// The static tracepoints for perf and bpftrace are compiled in with -DCONFREADER_USDT, and need sys/sdt.h of SystemTap.
+#ifndef CONFREADER_PROBE
+#ifdef CONFREADER_USDT
+#include <sys/sdt.h>
+#define CONFREADER_PROBE(...)		STAP_PROBEV(confreader, __VA_ARGS__)
+#else
+#define CONFREADER_PROBE(...)
+#endif
+#endif
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
 #define CONFREADER_OK				0
 #define CONFREADER_ERROR			-1
 
@@ -45,434 +83,4320 @@ Usage:
 #define CONFREADER_EINVVAL			5
 #define CONFREADER_EBUSY			6
 #define CONFREADER_ENOMEM			7
+#define CONFREADER_EENCODING		8
+#define CONFREADER_EWRITEFILE		9
+
+// Options of the parsing.
+#define CONFREADER_OPT_CHECK_UTF8	1		// Fail on bytes which are not valid UTF-8.
+#define CONFREADER_OPT_ALL_ERRORS	2		// Don't stop at the first error, collect all of them into diags.
+#define CONFREADER_OPT_RECORD_ACCESS	4	// Count the reads of each parameter for saveProfile().
+#define CONFREADER_OPT_LOOKUP_CACHE	8	// Remember the lookups of each thread by the pointers of the names.
+
+#define CONFREADER_LOOKUP_CACHE_SIZE	64	// Entries of the lookup cache of a thread, a power of two.
+
+// Kinds of the errors in the diagnostics.
+#define CONFREADER_DIAG_CR			1		// Carriage return is not followed by line feed.
+#define CONFREADER_DIAG_SECTION		2		// No closing bracket of the section name.
+#define CONFREADER_DIAG_JUNK		3		// Something else than a comment after the section name or the quoted value.
+#define CONFREADER_DIAG_NOVALUE		4		// The parameter has no value.
+#define CONFREADER_DIAG_COMMENT		5		// The comment is not separated from the value by a space.
+#define CONFREADER_DIAG_QUOTE		6		// No closing quote.
+#define CONFREADER_DIAG_HEREDOC		7		// No line with the closing tag of the block.
+#define CONFREADER_DIAG_UTF8		8		// Not valid UTF-8.
+#define CONFREADER_DIAG_UNKNOWN_SECTION	9	// The section is not in the schema.
+#define CONFREADER_DIAG_UNKNOWN_KEY	10		// The parameter is not in the schema.
+#define CONFREADER_DIAG_MISSING_KEY	11		// The required parameter is not in the file.
+#define CONFREADER_DIAG_TYPE		12		// The value can't be converted to the type from the schema.
+#define CONFREADER_DIAG_RANGE		13		// The value is out of the range from the schema.
+#define CONFREADER_DIAG_PATTERN		14		// The value doesn't match the pattern from the schema.
+
+// Types of the values in the schema.
+#define CONFREADER_TYPE_STRING		0
+#define CONFREADER_TYPE_INT			1
+#define CONFREADER_TYPE_DOUBLE		2
+#define CONFREADER_TYPE_BOOL		3
+#define CONFREADER_TYPE_DURATION	4
+#define CONFREADER_TYPE_BYTES		5
+#define CONFREADER_TYPE_IPADDR		6
+#define CONFREADER_TYPE_ENDPOINT	7
+
+// Flags of the schema entry.
+#define CONFREADER_SCHEMA_REQUIRED	1
+#define CONFREADER_SCHEMA_RANGE		2		// Check min and max. For strings it is the length.
+
+// Types of the converted values cached on the parameter.
+#define CONFREADER_CACHE_NONE		0
+#define CONFREADER_CACHE_DURATION	1
+#define CONFREADER_CACHE_BYTES		2
+#define CONFREADER_CACHE_RATE		3
+#define CONFREADER_CACHE_ENUM		4
+#define CONFREADER_CACHE_IPADDR		5
+#define CONFREADER_CACHE_ENDPOINT	6
+#define CONFREADER_CACHE_CIDRLIST	7
+#define CONFREADER_CACHE_INTARRAY	8
+#define CONFREADER_CACHE_DOUBLEARRAY	9
+#define CONFREADER_CACHE_BUSY		-1
+
+// Flags of the parameter.
+#define CONFREADER_PARAM_ESCAPED	1		// The quoted value has escape sequences which are not decoded yet.
+#define CONFREADER_PARAM_BUSY		2		// A reader is decoding the value.
 
 class Confreader {
+public:
+	typedef struct ipAddr {
+		int family;					// AF_INET or AF_INET6.
+		unsigned char addr[16];		// Network byte order, the first 4 bytes for AF_INET.
+	} IpAddr;
+
+	typedef struct endpoint {
+		union {
+			struct sockaddr sa;
+			struct sockaddr_in sin;
+			struct sockaddr_in6 sin6;
+		} addr;
+		socklen_t len;				// Size of the address to pass to bind() or connect().
+	} Endpoint;
+
+	// Prefixes compiled into a binary trie, one for IPv4 and one for IPv6.
+	// Node 0 is not used, so a child equal to 0 means there is no child.
+	typedef struct cidrNode {
+		int child[2];
+		int match;					// A prefix ends at this node.
+	} CidrNode;
+
+	typedef struct cidrList {
+		int count;					// Number of prefixes in the list.
+		int root4;
+		int root6;
+		CidrNode *nodes;
+	} CidrList;
+
+	typedef struct diagnostic {
+		int lineNum;				// 0 if the error is not on a line, e.g. a missing parameter.
+		int colNum;					// Counted in UTF-8 characters from 1, 0 for the schema errors.
+		int kind;					// CONFREADER_DIAG_...
+		const char *name;			// The parameter or section of a schema error.
+	} Diagnostic;
+
+	// A section with key nullptr allows any parameters in the section.
+	typedef struct schemaEntry {
+		const char *section;		// nullptr for the parameters without section.
+		const char *key;
+		int type;					// CONFREADER_TYPE_...
+		int flags;					// CONFREADER_SCHEMA_...
+		double min;
+		double max;
+		const char *pattern;		// Shell-style pattern of the value with *, ? and [...], or nullptr.
+	} SchemaEntry;
+
+	// The old name of a parameter which is read as the new one.
+	typedef struct alias {
+		const char *section;		// nullptr for all sections, also for the parameters without section.
+		const char *oldKey;
+		const char *key;
+	} Alias;
+
+	typedef struct change {
+		const char *section;		// nullptr for the parameters without section.
+		const char *key;
+		const char *value;			// nullptr removes the parameter.
+	} Change;
+
+	// The name of a parameter or a section for the get methods. It is made from a string, from a std::string_view
+	// which may not end with 0, or by the literal "name"_ck which has the length and the hash computed at compile time.
+	struct Name {
+		const char *str;			// nullptr for the parameters without section.
+		int len;					// -1 if the string ends with 0 and the length is not known.
+		unsigned int hash;			// The hash of a key, 0 if it is not computed yet.
+
+		constexpr Name(const char *s = nullptr) : str(s), len(-1), hash(0) {}
+		constexpr Name(const char *s, int n, unsigned int h) : str(s), len(n), hash(h) {}
+		constexpr Name(const char *s, int n) : str(s), len(n), hash(_hashKeyN(s, n)) {}
+#if __cplusplus >= 201703L
+		constexpr Name(std::string_view s) : str(s.data()), len((int)s.size()), hash(0) {}
+#endif
+	};
+
 private:
+	typedef struct cache {
+		int type;				// CONFREADER_CACHE_... , set last so that readers never see a half-written value.
+		int chainLock;			// Taken by the reader that adds an entry to next.
+		const void *tag;		// What the value was converted with, e.g. the enum names table.
+		union {
+			long long i;
+			double d;
+			void *p;			// Allocated in the arena.
+		} v;
+		struct cache *next;		// The values of the other types, see _chainClaim().
+	} Cache;
+
 	typedef struct param {
 		char *key;
 		char *value;
+		int flags;				// CONFREADER_PARAM_...
+		int lineNum;
+		int valueStart;			// The value in the file with the quotes or the whole block, for patchFile().
+		int valueEnd;
+		int hits;				// Reads counted with CONFREADER_OPT_RECORD_ACCESS.
+		Cache cache;
 	} Param;
+
+	// What the readers change in a parameter of a frozen object, kept out of the read-only memory.
+	typedef struct paramState {
+		Cache cache;
+		int hits;
+	} ParamState;
+
+	typedef struct unit {
+		const char *suffix;
+		long long mul;
+	} Unit;
+
+	// Memory for the converted values. Blocks are freed all together by clear().
+	typedef struct arenaBlock {
+		struct arenaBlock *next;
+		size_t size;
+		size_t used;
+	} ArenaBlock;
+
+	typedef struct arena {
+		ArenaBlock *blocks;
+		int lock;
+	} Arena;
+
+	// The memory of the parsed file which the snapshots made by derive() share. The last of them frees it.
+	// The converted values and the sections changed by derive() are in its arena.
+	typedef struct shared {
+		int refs;
+		size_t copied;			// Bytes of the sections copied into the arena, for History.
+		char *fileBuf;
+		Param *params;
+		unsigned long long *blooms;
+		Arena arena;
+	} Shared;
 	
 	typedef struct section {
 		int size;
+		int hits;				// Reads of the parameters of the section in the profile.
 		char *name;
 		Param *params;
+		int lineNum;
+		unsigned int bloomMask;		// Number of bits of the Bloom filter of the keys minus one.
+		unsigned long long *bloom;	// nullptr if there is no filter.
+		unsigned long long hash;	// The names and the values of the section in the file, for sectionFingerprint().
 	} Section;
 
+	// A part of the file replaced by patchFile().
+	typedef struct edit {
+		int start;
+		int end;
+		const char *text;
+		int len;
+		int seq;				// Order of the change, for the lines inserted at the same place.
+	} Edit;
+
+	// The number of reads of a parameter in the profile.
+	typedef struct profileEntry {
+		const char *section;	// nullptr for the parameters without section.
+		const char *key;
+		int hits;
+	} ProfileEntry;
+
+	// The copy of the parsed file in the memory of a NUMA node.
+	typedef struct replica {
+		Section *sects;			// nullptr if the node is not online.
+		void *mem;
+		size_t memSize;
+	} Replica;
+
+	// A lookup remembered by _cachedLookup().
+	typedef struct lookupSlot {
+		const char *key;
+		const char *section;
+		int keyLen;
+		int sectLen;
+		unsigned long long generation;	// 0 if the slot is empty.
+		Param *param;			// nullptr if the parameter is not found.
+	} LookupSlot;
+
+	// A parameter in the hash table of the environment variable names.
+	typedef struct envSlot {
+		Param *param;
+		const char *section;	// nullptr for the parameters without section.
+	} EnvSlot;
+
 	char *_fileBuf;
+	int _fileSize;
 	
 	int *_lines;
+	int *_lineEnds;			// Index of the line feed of each line.
 	int _lineCount;
+	int _bomSize;			// The byte order mark at the beginning of the file is replaced with spaces.
 
 	Param *_params;
 	int _paramCount;
 
-public:
-	int errorNum;
-	int errorLineNum;
-	Section *sects;
-	int sectCount;
-	
-	Confreader(){
-		init();
+	Arena _ownArena;
+	Arena *_arena;			// _ownArena, or the arena of the shared memory after derive().
+	Shared *_shared;		// nullptr until derive() is called.
+
+	int _diagCap;
+
+	const Alias *_aliases;
+	int _aliasCount;
+	int *_aliasSlots;		// Hash table of the old names, indices of _aliases or -1.
+	unsigned int _aliasMask;
+
+	unsigned long long *_blooms;	// The filters of all sections in one block.
+
+	unsigned long long _fingerprint;	// The hash of the file, 0 if no file is parsed.
+	unsigned long long _fileHash;		// The hash of the file as it was read, for patchFile(). derive() doesn't change it.
+
+	char *_profileBuf;			// The profile file, the names of the entries point into it.
+	ProfileEntry *_profile;
+	int _profileCount;
+	int *_profileSlots;			// Hash table of the entries, indices of _profile or -1.
+	unsigned int _profileMask;
+
+	Replica *_replicas;			// Indexed by the node, nullptr if the file is not replicated.
+	int _replicaCount;
+	int *_cpuNodes;				// The node of each CPU.
+	int _cpuCount;
+
+	unsigned long long _generation;	// Unique for each state of the parameters of all objects, for the lookup cache.
+
+	void *_frozen;				// The read-only block of the parsed data after freeze(), nullptr before.
+	size_t _frozenSize;
+	Param *_frozenParams;		// All the parameters in the block, in the order of the sections.
+	ParamState *_states;		// The caches and the counters of the frozen parameters.
+
+	// The cache of the converted value of the parameter.
+	Cache * _cacheOf(Param *p){
+		return _states ? &_states[p - _frozenParams].cache : &p->cache;
 	}
-	Confreader(char *filename){
-		init();
-		parseFile(filename);
+
+	// The counter of the reads of the parameter.
+	int * _hitsOf(Param *p){
+		return _states ? &_states[p - _frozenParams].hits : &p->hits;
 	}
-	~Confreader(){
-		clear();
+
+	// Allocates size bytes aligned to 16 from the arena. Readers may call it concurrently.
+	void * _alloc(size_t size){
+		ArenaBlock *block;
+		Arena *arena;
+		void *ptr;
+		size_t blockSize;
+
+		size = (size + 15) & ~(size_t)15;
+		// derive() can move the arena into the shared memory while the lock is waited for.
+		for(;;){
+			arena = __atomic_load_n(&_arena, __ATOMIC_ACQUIRE);
+			while(__atomic_exchange_n(&arena->lock, 1, __ATOMIC_ACQUIRE)){
+			}
+			if(arena == __atomic_load_n(&_arena, __ATOMIC_ACQUIRE)) break;
+			__atomic_store_n(&arena->lock, 0, __ATOMIC_RELEASE);
+		}
+		if(arena->blocks == nullptr || arena->blocks->size - arena->blocks->used < size){
+			blockSize = size > 16384 ? size : 16384;
+			block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + 16 + blockSize);
+			if(block == nullptr){
+				__atomic_store_n(&arena->lock, 0, __ATOMIC_RELEASE);
+				return nullptr;
+			}
+			block->next = arena->blocks;
+			block->size = blockSize;
+			block->used = 0;
+			arena->blocks = block;
+		}
+		// The data starts at the first 16-byte boundary after the block header.
+		ptr = (char *)(((size_t)(arena->blocks + 1) + 15) & ~(size_t)15) + arena->blocks->used;
+		arena->blocks->used += size;
+		__atomic_store_n(&arena->lock, 0, __ATOMIC_RELEASE);
+		return ptr;
 	}
 
-	void init(){
-		sectCount = 0;
-		sects = nullptr;
-		_params = nullptr;
-		_lines = nullptr;
-		_fileBuf = nullptr;
-		errorNum = 0;
-		errorLineNum = 0;
+	static void _freeArena(Arena *arena){
+		ArenaBlock *block;
+
+		while(arena->blocks){
+			block = arena->blocks;
+			arena->blocks = block->next;
+			free(block);
+		}
 	}
 
-	void clear(){
-		sectCount = 0;
-		if(sects){
-			free(sects);
-			sects = nullptr;
+	// Finds the alias of the old name of the parameter in the section.
+	const Alias * _findAlias(const Name &key, const Name &section){
+		unsigned int h;
+		int i;
+
+		for(h=_nameHash(key); (i = _aliasSlots[h & _aliasMask]) >= 0; h++){
+			if(_equalName(_aliases[i].oldKey, key)
+				&& (_aliases[i].section == nullptr || (section.str != nullptr && _equalName(_aliases[i].section, section)))) return &_aliases[i];
 		}
-		if(_params){
-			free(_params);
-			_params = nullptr;
+		return nullptr;
+	}
+
+	Param * _lookup(Name key, const Name &section){
+		const Alias *alias;
+		Section *all = sects, *sect;
+		int i, j;
+
+		// The old name is read as the new one.
+		if(_aliasCount > 0 && (alias = _findAlias(key, section)) != nullptr){
+			__atomic_add_fetch(&deprecatedHits, 1, __ATOMIC_RELAXED);
+			key = alias->key;
 		}
-		if(_lines){
-			free(_lines);
-			_lines = nullptr;
+		if(sectCount == 0) return nullptr;
+		// The thread reads the copy in the memory of its NUMA node.
+		if(_replicas && _replicas[i = _currentNode()].sects) all = _replicas[i].sects;
+		if(section.str == nullptr){
+			sect = &all[0];
+		}else{
+			for(i=1; i<sectCount && !_equalName(all[i].name, section); i++);
+			if(i == sectCount) return nullptr;
+			sect = &all[i];
 		}
-		if(_fileBuf){
-			free(_fileBuf);
-			_fileBuf = nullptr;
+
+		// Most of the missing keys are rejected by the filter without comparing the keys of the section.
+		if(sect->bloom && !_inBloom(sect, _nameHash(key))) return nullptr;
+		for(j=0; j<sect->size; j++){
+			if(_equalName(sect->params[j].key, key)){
+				return &sect->params[j];
+			}
 		}
+		return nullptr;
 	}
 
-	int parseFile(const char *filename){
-		int fd, i;
-		int lineIdx, sectIdx, paramIdx;
-		ssize_t fileBufSize;
-		struct stat file_status;
-		
-		errorLineNum = 0;
-		
-		if(_fileBuf){
-			errorNum = CONFREADER_EBUSY;
-			return CONFREADER_ERROR;
+	// Returns the column of the character at pos in the line, counted in UTF-8 characters from 1.
+	int _column(int lineIdx, int pos){
+		int i, col = 1;
+
+		i = lineIdx == 0 ? _bomSize : _lineEnds[lineIdx - 1] + 1;
+		for(; i<pos; i++){
+			if((_fileBuf[i] & 0xC0) != 0x80) col++;
 		}
-		
-		// Open file and read text content.
-		fd = open(filename, O_RDONLY, S_IRUSR | S_IRGRP | S_IROTH);
-		if(fd == -1){
-			errorNum = CONFREADER_EREADFILE;
-			return CONFREADER_ERROR;
+		return col;
+	}
+
+	bool _addDiag(int lineNum, int colNum, int kind, const char *name){
+		Diagnostic *newDiags;
+
+		if(diagCount == _diagCap){
+			newDiags = (Diagnostic *)realloc(diags, (_diagCap ? _diagCap * 2 : 16) * sizeof(Diagnostic));
+			if(newDiags == nullptr) return false;
+			diags = newDiags;
+			_diagCap = _diagCap ? _diagCap * 2 : 16;
 		}
-		
-		if(fstat(fd, &file_status) != 0){
-			errorNum = CONFREADER_EREADFILE;
-			return CONFREADER_ERROR;
+		diags[diagCount].lineNum = lineNum;
+		diags[diagCount].colNum = colNum;
+		diags[diagCount].kind = kind;
+		diags[diagCount].name = name;
+		diagCount++;
+		return true;
+	}
+
+	// Remembers where the error is and frees the memory. Returns CONFREADER_ERROR.
+	// If all the errors are collected, adds the error to the diagnostics and returns CONFREADER_OK to go on.
+	int _error(int lineNum, int colNum, int kind){
+		if(options & CONFREADER_OPT_ALL_ERRORS){
+			if(!_addDiag(lineNum, colNum, kind, nullptr)){
+				clear();
+				errorNum = CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
+			}
+			return CONFREADER_OK;
 		}
-		
-		fileBufSize = file_status.st_size;
-		if(fileBufSize == 0){
-			close(fd);
-			errorNum = CONFREADER_OK;
-			return CONFREADER_OK;		// File is empty.
+
+		errorLineNum = lineNum;
+		errorColNum = colNum;
+		clear();
+		errorNum = kind == CONFREADER_DIAG_UTF8 ? CONFREADER_EENCODING : CONFREADER_EPARSINGFILE;
+		return CONFREADER_ERROR;
+	}
+
+	int _syntaxError(int lineIdx, int pos, int kind){
+		return _error(lineIdx + 1, _column(lineIdx, pos), kind);
+	}
+
+	static int _compareDiags(const void *a, const void *b){
+		const Diagnostic *da = (const Diagnostic *)a, *db = (const Diagnostic *)b;
+
+		if(da->lineNum != db->lineNum) return da->lineNum < db->lineNum ? -1 : 1;
+		return da->colNum < db->colNum ? -1 : (da->colNum > db->colNum ? 1 : 0);
+	}
+
+	// Returns the length of the valid UTF-8 character at s of size bytes, or 0.
+	// Overlong forms, surrogates and code points above U+10FFFF are not valid.
+	static int _utf8Length(const unsigned char *s, int size){
+		int k, n;
+
+		if(s[0] < 0x80) return 1;
+		if(s[0] >= 0xC2 && s[0] <= 0xDF) n = 1;
+		else if(s[0] >= 0xE0 && s[0] <= 0xEF) n = 2;
+		else if(s[0] >= 0xF0 && s[0] <= 0xF4) n = 3;
+		else return 0;
+		if(size <= n) return 0;
+
+		// The range of the second byte is narrower after E0, ED, F0 and F4.
+		if((s[1] & 0xC0) != 0x80
+			|| (s[0] == 0xE0 && s[1] < 0xA0) || (s[0] == 0xED && s[1] > 0x9F)
+			|| (s[0] == 0xF0 && s[1] < 0x90) || (s[0] == 0xF4 && s[1] > 0x8F)) return 0;
+		for(k=2; k<=n; k++){
+			if((s[k] & 0xC0) != 0x80) return 0;
 		}
-		
-		_fileBuf = (char *)malloc(fileBufSize + 1);		// One byte more.
-		if(_fileBuf == nullptr){
-			errorNum = CONFREADER_ENOMEM;
-			return CONFREADER_ERROR;
+		return n + 1;
+	}
+
+	// Returns the index of the first byte which does not start a valid UTF-8 character, or -1.
+	static int _checkUtf8(const char *buf, int size){
+		const unsigned char *s = (const unsigned char *)buf;
+		unsigned long long v[2];
+		int i, n;
+
+		for(i=0; i<size; ){
+			// Let's skip ASCII 16 bytes at a time, that is most of a config file.
+			if(size - i >= 16){
+				memcpy(v, &s[i], 16);
+				if(((v[0] | v[1]) & 0x8080808080808080ULL) == 0){
+					i += 16;
+					continue;
+				}
+			}
+			if((n = _utf8Length(&s[i], size - i)) == 0) return i;
+			i += n;
 		}
-		
-		if(read(fd, _fileBuf, fileBufSize) != fileBufSize){
-			free(_fileBuf);
-			_fileBuf = nullptr;
-			errorNum = CONFREADER_EREADFILE;
-			return CONFREADER_ERROR;
+		return -1;
+	}
+
+	// Finds the end of the value which starts at i: the end of the line or the comment, without the spaces before it.
+	// Puts 0 after the value and returns its index. If the comment is not separated from the value by a space,
+	// returns -1 minus the index of the comment character.
+	int _endValue(int i){
+		for(; ; i++){
+			if(_fileBuf[i] == 0) break;
+			if(_fileBuf[i] == '#' || _fileBuf[i] == ';'){
+				if(_fileBuf[i-1] != ' ' && _fileBuf[i-1] != 0x09) return -1 - i;
+				break;
+			}
 		}
-		close(fd);
-		
-		// Let's put 0x0A in the last byte, since the last line can be without a line feed character.
-		_fileBuf[fileBufSize] = 0x0A;
-		fileBufSize++;
-		
-		// Let's count how many lines are in the file.
-		_lineCount = 0;
-		for(i=0; i<fileBufSize; i++){
-			if(_fileBuf[i] == 0x0A) _lineCount++;
+
+		// We clear the whitespace characters at the end of the value and get the end of the parameter value
+		for(--i; i>=0; i--){
+			if(_fileBuf[i] != ' ' && _fileBuf[i] != 0x09) break;
 		}
+		// and then put 0 after the end of the parameter value.
+		_fileBuf[++i] = 0;
+		return i;
+	}
 
-		// Let's allocate memory for the array of pointers to strings.
-		_lines = (int *)malloc(_lineCount * sizeof(int));
-		if(_lines == nullptr){
-			clear();
-			errorNum = CONFREADER_ENOMEM;
-			return CONFREADER_ERROR;
+	// The value is <<TAG, where the tag consists of letters, digits and underscores.
+	static bool _isHeredoc(const char *val){
+		int k;
+
+		if(val[0] != '<' || val[1] != '<' || val[2] == 0) return false;
+		for(k=2; val[k] != 0; k++){
+			if(!((val[k] >= 'A' && val[k] <= 'Z') || (val[k] >= 'a' && val[k] <= 'z') || (val[k] >= '0' && val[k] <= '9') || val[k] == '_')) return false;
 		}
+		return true;
+	}
 
-		// Let's count how many sections and how many parameters are in the file.
-		_paramCount = 0;
-		sectCount = 1;			// Section with index 0 for parameters without section.
-		lineIdx = 0;
-		for(i=0; i<fileBufSize; i++){
-			// Skip the whitespace characters at the beginning of the string.
-			for(; i<fileBufSize; i++){
-				if(_fileBuf[i] != ' ' && _fileBuf[i] != 0x09) break;
-			}
-			// Remember the index of the beginning of the string.
-			_lines[lineIdx++] = i;
+	// Decodes the escape sequences of a quoted value into the arena and replaces the value with the result.
+	// Unknown sequences give the character after the backslash.
+	bool _unescape(Param *p){
+		const char *src;
+		char *dst, *decoded;
+		unsigned int code;
+		int k, digits;
 
-			// Check the beginning of the section.
-			if(_fileBuf[i] == '['){
-				sectCount++;
-			}else
-			// Check the beginning of the comment or parameter.
-			if(_fileBuf[i] != '#' && _fileBuf[i] != ';' && _fileBuf[i] != 0x0A && _fileBuf[i] != 0x0D){
-				_paramCount++;
-			}
+		src = p->value;
+		decoded = dst = (char *)_alloc(strlen(src) + 1);		// The decoded value is never longer.
+		if(decoded == nullptr) return false;
 
-			for(; i<fileBufSize; i++){
-				if(_fileBuf[i] == 0x0D){
-					_fileBuf[i++] = 0;
-				
-					if(_fileBuf[i] != 0x0A){	// After 0x0D, 0x0A must necessarily follow.
-						clear();
-						errorLineNum = lineIdx;
-						errorNum = CONFREADER_EPARSINGFILE;
-						return CONFREADER_ERROR;
+		for(; *src != 0; src++){
+			if(*src != '\\'){
+				*dst++ = *src;
+				continue;
+			}
+			switch(*++src){
+				case 'a': *dst++ = 0x07; break;
+				case 'b': *dst++ = 0x08; break;
+				case 'e': *dst++ = 0x1B; break;
+				case 'f': *dst++ = 0x0C; break;
+				case 'n': *dst++ = 0x0A; break;
+				case 'r': *dst++ = 0x0D; break;
+				case 't': *dst++ = 0x09; break;
+				case 'v': *dst++ = 0x0B; break;
+				case 'x':		// \xHH, a byte.
+				case 'u':		// \uHHHH, a character written as UTF-8.
+					digits = *src == 'x' ? 2 : 4;
+					code = 0;
+					for(k=0; k<digits; k++){
+						if(src[k + 1] >= '0' && src[k + 1] <= '9') code = code * 16 + (src[k + 1] - '0');
+						else if(src[k + 1] >= 'a' && src[k + 1] <= 'f') code = code * 16 + (src[k + 1] - 'a' + 10);
+						else if(src[k + 1] >= 'A' && src[k + 1] <= 'F') code = code * 16 + (src[k + 1] - 'A' + 10);
+						else break;
+					}
+					if(k < digits || code == 0){		// Not a valid sequence, or a zero byte which can't be in a string.
+						*dst++ = *src;
+						break;
+					}
+					src += digits;
+					if(digits == 2 || code < 0x80){
+						*dst++ = code;
+					}else
+					if(code < 0x800){
+						*dst++ = 0xC0 | (code >> 6);
+						*dst++ = 0x80 | (code & 0x3F);
+					}else{
+						*dst++ = 0xE0 | (code >> 12);
+						*dst++ = 0x80 | ((code >> 6) & 0x3F);
+						*dst++ = 0x80 | (code & 0x3F);
 					}
-					_fileBuf[i] = 0;
-					break;
-				//newLine = true;
-				}else
-				if(_fileBuf[i] == 0x0A){
-					_fileBuf[i] = 0;
 					break;
-				}
+				default: *dst++ = *src; break;		// \\ \" \' and the unknown ones.
 			}
 		}
+		*dst = 0;
 
-		// Allocate memory for an array of pointers to lines with parameters.
-		_params = (Param *)malloc(_paramCount * sizeof(Param));
-		if(_params == nullptr){
-			clear();
-			errorNum = CONFREADER_ENOMEM;
-			return CONFREADER_ERROR;
+		__atomic_store_n(&p->value, decoded, __ATOMIC_RELAXED);
+		__atomic_store_n(&p->flags, 0, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	// Decodes the escape sequences of the value on the first access.
+	// Only one reader decodes the value, the others wait for it, so the value is never decoded twice.
+	bool _decode(Param *p){
+		int flags;
+		bool ok;
+
+		for(;;){
+			flags = __atomic_load_n(&p->flags, __ATOMIC_ACQUIRE);
+			if(flags == 0) return true;
+			if(flags & CONFREADER_PARAM_BUSY){
+				sched_yield();
+				continue;
+			}
+			if(__atomic_compare_exchange_n(&p->flags, &flags, flags | CONFREADER_PARAM_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
 		}
+		ok = _unescape(p);
+		if(!ok) __atomic_store_n(&p->flags, flags, __ATOMIC_RELEASE);
+		return ok;
+	}
 
-		// Allocate memory for an array of pointers to sections.
-		sects = (Section *)malloc(sectCount * sizeof(Section));
-		if(sects == nullptr){
-			clear();
+	// The names given by the same pointers are looked up once in each thread, until the parameters are changed.
+	// The cache is shared by all objects, the generation tells them apart.
+	Param * _cachedLookup(const Name &key, const Name &section){
+		static thread_local LookupSlot slots[CONFREADER_LOOKUP_CACHE_SIZE];
+		LookupSlot *slot = &slots[((size_t)key.str ^ ((size_t)section.str >> 4) ^ ((size_t)key.str >> 9)) & (CONFREADER_LOOKUP_CACHE_SIZE - 1)];
+
+		if(slot->generation != _generation || slot->key != key.str || slot->section != section.str
+			|| slot->keyLen != key.len || slot->sectLen != section.len){
+			slot->param = _lookup(key, section);
+			slot->key = key.str;
+			slot->section = section.str;
+			slot->keyLen = key.len;
+			slot->sectLen = section.len;
+			slot->generation = _generation;
+		}
+		return slot->param;
+	}
+
+	Param * _findParam(const Name &key, const Name &section){
+		Param *p;
+
+		p = (options & CONFREADER_OPT_LOOKUP_CACHE) ? _cachedLookup(key, section) : _lookup(key, section);
+		if(p == nullptr){
+			CONFREADER_PROBE(find__miss, key.str, section.str);
+			errorNum = CONFREADER_ENOPARAM;
+			return nullptr;
+		}
+		CONFREADER_PROBE(find__hit, key.str, section.str, p->lineNum);
+		if(options & CONFREADER_OPT_RECORD_ACCESS){
+			__atomic_add_fetch(_hitsOf(p), 1, __ATOMIC_RELAXED);
+		}
+		if(!_decode(p)){
 			errorNum = CONFREADER_ENOMEM;
-			return CONFREADER_ERROR;
+			return nullptr;
 		}
+		errorNum = CONFREADER_OK;
+		return p;
+	}
 
-		// Link all sections and parameters.
-		sectIdx = 0;
-		sects[sectIdx].name = nullptr;
-		sects[sectIdx].size = 0;
-		sects[sectIdx].params = nullptr;
-		
-		paramIdx = 0;
-		for(lineIdx=0; (lineIdx<_lineCount) && (paramIdx < _paramCount); lineIdx++){
-			i = _lines[lineIdx];
+	// Converts a number of len characters with an optional unit suffix. The suffix is looked up in the table,
+	// the table ends with an entry having suffix nullptr. An empty suffix "" means a bare number.
+	bool _parseUnits(const char *val, int len, const Unit *units, long long *result){
+		long long n = 0;
+		int k;
 
-			if(_fileBuf[i] == '['){			// Found a new section.
-				sectIdx++;
-				sects[sectIdx].name = &_fileBuf[++i];
-				sects[sectIdx].size = 0;
-				sects[sectIdx].params = nullptr;
-				// Let's find the end of the section name.
-				for(; i<fileBufSize; i++){
-					if(_fileBuf[i] == ']'){
-						_fileBuf[i++] = 0;
-						break;
-					}
-					if(_fileBuf[i] == 0){		// Couldn't find the closing parenthesis.
-						clear();
-						errorLineNum = lineIdx + 1;
-						errorNum = CONFREADER_EPARSINGFILE;
-						return CONFREADER_ERROR;
-					}
-				}
-				
-				// If there are whitespace characters in the line from the current position, we skip these characters.
+		if(len == 0 || val[0] < '0' || val[0] > '9') return false;
+		for(k=0; k<len && val[k] >= '0' && val[k] <= '9'; k++){
+			if(n > (0x7FFFFFFFFFFFFFFFLL - (val[k] - '0')) / 10) return false;	// Overflow.
+			n = n * 10 + (val[k] - '0');
+		}
+		// A space between the number and the unit is allowed.
+		for(; k<len && (val[k] == ' ' || val[k] == 0x09); k++);
+
+		for(; units->suffix != nullptr; units++){
+			if((int)strlen(units->suffix) == len - k && strncasecmp(&val[k], units->suffix, len - k) == 0){
+				if(n > 0x7FFFFFFFFFFFFFFFLL / units->mul) return false;	// Overflow.
+				*result = n * units->mul;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// The cache of a parameter is filled once, by the first reader that converted the value.
+	// The other readers convert the value themselves until the cache is ready.
+	bool _cached(Param *p, int type, const void *tag){
+		Cache *c = _cacheOf(p);
+		return __atomic_load_n(&c->type, __ATOMIC_ACQUIRE) == type && c->tag == tag;
+	}
+
+	bool _cacheLock(Param *p){
+		int expected = CONFREADER_CACHE_NONE;
+		return __atomic_compare_exchange_n(&_cacheOf(p)->type, &expected, CONFREADER_CACHE_BUSY, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+	}
+
+	void _cacheUnlock(Param *p, int type, const void *tag){
+		Cache *c = _cacheOf(p);
+		c->tag = tag;
+		__atomic_store_n(&c->type, type, __ATOMIC_RELEASE);
+	}
+
+	// For the values kept in the memory of the object, where only the reader that fills the cache may allocate.
+	// Returns 0 if the caller has taken the lock and must fill the cache, 1 if the cache holds the value,
+	// or -1 if it holds another type. Waits while another reader is filling the cache.
+	int _cacheClaim(Param *p, int type, const void *tag){
+		Cache *c = _cacheOf(p);
+		int t;
+
+		while(!_cacheLock(p)){
+			t = __atomic_load_n(&c->type, __ATOMIC_ACQUIRE);
+			if(t == CONFREADER_CACHE_BUSY){
+				sched_yield();
+				continue;
+			}
+			return t == type && c->tag == tag ? 1 : -1;
+		}
+		return 0;
+	}
+
+	// The values of other types than the one in the cache are kept in entries chained to it, for the getters
+	// that return the memory of the object. Returns the entry of the type, or nullptr if there is none.
+	Cache * _chained(Param *p, int type){
+		Cache *e;
+
+		for(e = __atomic_load_n(&_cacheOf(p)->next, __ATOMIC_ACQUIRE); e != nullptr; e = e->next){
+			if(e->type == type) return e;
+		}
+		return nullptr;
+	}
+
+	// Returns the entry of the type, or nullptr with the chain locked if the caller must add it with _chainAdd().
+	// Entries are added by one reader at a time, so the value of a type is allocated once.
+	Cache * _chainClaim(Param *p, int type){
+		Cache *c = _cacheOf(p);
+		Cache *e;
+		int expected;
+
+		for(;;){
+			if((e = _chained(p, type)) != nullptr) return e;
+			expected = 0;
+			if(__atomic_compare_exchange_n(&c->chainLock, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+			sched_yield();
+		}
+		if((e = _chained(p, type)) != nullptr){
+			__atomic_store_n(&c->chainLock, 0, __ATOMIC_RELEASE);
+		}
+		return e;
+	}
+
+	// Adds the entry with the value and unlocks the chain. Returns nullptr if the value or the entry is not allocated.
+	Cache * _chainAdd(Param *p, int type, void *value){
+		Cache *c = _cacheOf(p);
+		Cache *e = nullptr;
+
+		if(value != nullptr && (e = (Cache *)_alloc(sizeof(Cache))) != nullptr){
+			memset(e, 0, sizeof(Cache));
+			e->type = type;
+			e->v.p = value;
+			e->next = c->next;
+			__atomic_store_n(&c->next, e, __ATOMIC_RELEASE);
+		}
+		__atomic_store_n(&c->chainLock, 0, __ATOMIC_RELEASE);
+		return e;
+	}
+
+	long long _getUnits(const Name &key, const Name &section, long long defaultValue, int type, const Unit *units){
+		Param *p;
+		long long n;
+
+		if((p = _findParam(key, section)) != nullptr){
+			if(_cached(p, type, nullptr)){
+				return _cacheOf(p)->v.i;
+			}
+			if(!_parseUnits(p->value, strlen(p->value), units, &n)){
+				errorNum = CONFREADER_EINVVAL;
+				return defaultValue;
+			}
+			if(_cacheLock(p)){
+				_cacheOf(p)->v.i = n;
+				_cacheUnlock(p, type, nullptr);
+			}
+			return n;
+		}
+		return defaultValue;
+	}
+
+	// Parses an IPv4 or IPv6 address of len characters. An IPv6 address may be in square brackets.
+	static bool _parseIpAddr(const char *val, int len, IpAddr *ip){
+		char buf[INET6_ADDRSTRLEN];
+
+		if(len >= 2 && val[0] == '[' && val[len - 1] == ']'){
+			val++;
+			len -= 2;
+		}
+		if(len <= 0 || len >= (int)sizeof(buf)) return false;
+		memcpy(buf, val, len);
+		buf[len] = 0;
+
+		memset(ip, 0, sizeof(IpAddr));
+		if(inet_pton(AF_INET, buf, ip->addr) == 1){
+			ip->family = AF_INET;
+			return true;
+		}
+		if(inet_pton(AF_INET6, buf, ip->addr) == 1){
+			ip->family = AF_INET6;
+			return true;
+		}
+		return false;
+	}
+
+	// Parses 192.168.0.60:3333, [::]:8080, *:8080 or an address without a port.
+	// hasPort is set if the value has a port, even :0.
+	static bool _parseEndpoint(const char *val, Endpoint *ep, bool *hasPort){
+		IpAddr ip;
+		const char *colon;
+		int len, port, k;
+
+		len = strlen(val);
+		port = 0;
+		*hasPort = false;
+		colon = strrchr(val, ':');
+		// The port follows the last colon, unless the colon is a part of an IPv6 address without brackets.
+		if(colon != nullptr && (val[0] == '[' ? colon[-1] == ']' : strchr(val, ':') == colon)){
+			*hasPort = true;
+			len = colon - val;
+			for(k=1; colon[k] != 0; k++){
+				if(colon[k] < '0' || colon[k] > '9') return false;
+				port = port * 10 + (colon[k] - '0');
+				if(port > 65535) return false;
+			}
+			if(k == 1) return false;
+		}
+
+		if(len == 1 && val[0] == '*'){		// Any address.
+			memset(&ip, 0, sizeof(ip));
+			ip.family = AF_INET;
+		}else
+		if(!_parseIpAddr(val, len, &ip)){
+			return false;
+		}
+
+		memset(ep, 0, sizeof(Endpoint));
+		if(ip.family == AF_INET){
+			ep->addr.sin.sin_family = AF_INET;
+			ep->addr.sin.sin_port = htons(port);
+			memcpy(&ep->addr.sin.sin_addr, ip.addr, 4);
+			ep->len = sizeof(struct sockaddr_in);
+		}else{
+			ep->addr.sin6.sin6_family = AF_INET6;
+			ep->addr.sin6.sin6_port = htons(port);
+			memcpy(&ep->addr.sin6.sin6_addr, ip.addr, 16);
+			ep->len = sizeof(struct sockaddr_in6);
+		}
+		return true;
+	}
+
+	// Parses one prefix of the list: 10.0.0.0/8, fd00::/8 or a single address.
+	static bool _parseCidr(const char *val, int len, IpAddr *ip, int *prefixLen){
+		int k, addrLen, maxLen;
+
+		*prefixLen = 0;
+		for(addrLen=0; addrLen<len && val[addrLen] != '/'; addrLen++);
+		if(!_parseIpAddr(val, addrLen, ip)) return false;
+
+		maxLen = ip->family == AF_INET ? 32 : 128;
+		if(addrLen == len){
+			*prefixLen = maxLen;
+			return true;
+		}
+		for(k=addrLen+1; k<len; k++){
+			if(val[k] < '0' || val[k] > '9') return false;
+			*prefixLen = *prefixLen * 10 + (val[k] - '0');
+			if(*prefixLen > maxLen) return false;
+		}
+		return k > addrLen + 1;
+	}
+
+	// Checks the prefixes separated by commas or spaces and counts the nodes of the tries,
+	// one node per bit of each prefix at most. Returns -1 if the list is invalid.
+	static int _countCidrNodes(const char *val){
+		IpAddr ip;
+		int i, len, prefixLen, nodeCount;
+
+		nodeCount = 3;		// The unused node 0 and two roots.
+		for(i=0; val[i] != 0; i+=len){
+			for(; val[i] == ',' || val[i] == ' ' || val[i] == 0x09; i++);
+			for(len=0; val[i + len] != 0 && val[i + len] != ',' && val[i + len] != ' ' && val[i + len] != 0x09; len++);
+			if(len == 0) continue;
+			if(!_parseCidr(&val[i], len, &ip, &prefixLen)) return -1;
+			nodeCount += prefixLen;
+		}
+		return nodeCount;
+	}
+
+	// Builds the tries of the list checked by _countCidrNodes().
+	CidrList * _parseCidrList(const char *val, int nodeCount){
+		CidrList *list;
+		IpAddr ip;
+		int i, k, len, prefixLen, node, bit;
+
+		list = (CidrList *)_alloc(sizeof(CidrList) + nodeCount * sizeof(CidrNode));
+		if(list == nullptr) return nullptr;
+		list->nodes = (CidrNode *)(list + 1);
+		memset(list->nodes, 0, nodeCount * sizeof(CidrNode));
+		list->count = 0;
+		list->root4 = 1;
+		list->root6 = 2;
+
+		nodeCount = 3;
+		for(i=0; val[i] != 0; i+=len){
+			for(; val[i] == ',' || val[i] == ' ' || val[i] == 0x09; i++);
+			for(len=0; val[i + len] != 0 && val[i + len] != ',' && val[i + len] != ' ' && val[i + len] != 0x09; len++);
+			if(len == 0) continue;
+			_parseCidr(&val[i], len, &ip, &prefixLen);
+
+			node = ip.family == AF_INET ? list->root4 : list->root6;
+			for(k=0; k<prefixLen; k++){
+				bit = (ip.addr[k >> 3] >> (7 - (k & 7))) & 1;
+				if(list->nodes[node].child[bit] == 0){
+					list->nodes[node].child[bit] = nodeCount++;
+				}
+				node = list->nodes[node].child[bit];
+			}
+			list->nodes[node].match = 1;
+			list->count++;
+		}
+		return list;
+	}
+
+	// Eight ASCII digits at once, the first digit in the lowest byte.
+	static bool _isEightDigits(unsigned long long v){
+		return (((v & 0xF0F0F0F0F0F0F0F0ULL) | (((v + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
+	}
+
+	static unsigned int _parseEightDigits(unsigned long long v){
+		v -= 0x3030303030303030ULL;
+		v = (v * 10) + (v >> 8);
+		return (unsigned int)((((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+			+ (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32);
+	}
+
+	// Reads the digits from p up to end into n, eight at a time where possible.
+	// Returns the number of digits; digits beyond 19 are counted but not added.
+	static int _readDigits(const char *p, const char *end, unsigned long long *n){
+		unsigned long long v;
+		int count = 0;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		while(end - p >= 8){
+			memcpy(&v, p, 8);
+			if(!_isEightDigits(v)) break;
+			if(count <= 11){
+				*n = *n * 100000000ULL + _parseEightDigits(v);
+			}
+			count += 8;
+			p += 8;
+		}
+#endif
+		for(; p < end && *p >= '0' && *p <= '9'; p++, count++){
+			if(count < 19) *n = *n * 10 + (*p - '0');
+		}
+		return count;
+	}
+
+	static bool _isListSeparator(char c){
+		return c == ',' || c == ' ' || c == 0x09;
+	}
+
+	// Decodes up to maxCount integers of the list. Returns the number of elements in the list or -1 if the list is invalid.
+	static int _decodeInts(const char *val, long long *values, int maxCount){
+		const char *end, *tokenEnd;
+		unsigned long long n;
+		bool negative;
+		int count, digits;
+
+		end = val + strlen(val);
+		for(count=0; ; count++){
+			for(; val < end && _isListSeparator(*val); val++);
+			if(val == end) break;
+			for(tokenEnd=val; tokenEnd < end && !_isListSeparator(*tokenEnd); tokenEnd++);
+
+			negative = *val == '-';
+			if(*val == '-' || *val == '+') val++;
+			n = 0;
+			digits = _readDigits(val, tokenEnd, &n);
+			if(digits == 0 || val + digits != tokenEnd || digits > 19) return -1;
+			if(n > 0x7FFFFFFFFFFFFFFFULL + (negative ? 1 : 0)) return -1;		// Overflow.
+			if(count < maxCount){
+				values[count] = negative ? (long long)(0 - n) : (long long)n;
+			}
+			val = tokenEnd;
+		}
+		return count;
+	}
+
+	// Decodes up to maxCount numbers of the list. Returns the number of elements in the list or -1 if the list is invalid.
+	static int _decodeDoubles(const char *val, double *values, int maxCount){
+		static const double powersOf10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		const char *end, *tokenEnd, *p;
+		char *strEnd;
+		unsigned long long n;
+		double d;
+		bool negative;
+		int count, intDigits, fracDigits;
+
+		end = val + strlen(val);
+		for(count=0; ; count++){
+			for(; val < end && _isListSeparator(*val); val++);
+			if(val == end) break;
+			for(tokenEnd=val; tokenEnd < end && !_isListSeparator(*tokenEnd); tokenEnd++);
+
+			// The fast path: a mantissa of up to 15 digits is exact in double,
+			// and so is 10^k for k <= 22, so one division gives the correctly rounded result.
+			p = val;
+			negative = *p == '-';
+			if(*p == '-' || *p == '+') p++;
+			n = 0;
+			intDigits = _readDigits(p, tokenEnd, &n);
+			p += intDigits;
+			fracDigits = 0;
+			if(p < tokenEnd && *p == '.'){
+				p++;
+				fracDigits = _readDigits(p, tokenEnd, &n);
+				p += fracDigits;
+			}
+			if(p == tokenEnd && intDigits + fracDigits > 0 && intDigits + fracDigits <= 15){
+				d = (double)n / powersOf10[fracDigits];
+				if(negative) d = -d;
+			}else{
+				// Exponents, long mantissas, inf and nan are left to strtod.
+				d = strtod(val, &strEnd);
+				if(strEnd != tokenEnd) return -1;
+			}
+			if(count < maxCount){
+				values[count] = d;
+			}
+			val = tokenEnd;
+		}
+		return count;
+	}
+
+	static bool _isInt(const char *val){
+		int k;
+
+		if((val[0] < '0' || val[0] > '9') && val[0] != '-') return false;
+		for(k=1; val[k]!=0; k++){
+			if(val[k] < '0' || val[k] > '9') return false;
+		}
+		return true;
+	}
+
+	static bool _isDouble(const char *val){
+		int k;
+
+		if((val[0] < '0' || val[0] > '9') && val[0] != '-') return false;
+		for(k=1; val[k]!=0; k++){
+			if((val[k] < '0' || val[k] > '9') && val[k] != '.') return false;
+		}
+		return true;
+	}
+
+	static bool _parseBool(const char *val, bool *result){
+		if(strcasecmp(val, "yes") == 0 || strcasecmp(val, "true") == 0 || (val[0] == '1' && val[1] == 0)){
+			*result = true;
+			return true;
+		}
+		if(strcasecmp(val, "no") == 0 || strcasecmp(val, "false") == 0 || (val[0] == '0' && val[1] == 0)){
+			*result = false;
+			return true;
+		}
+		return false;
+	}
+
+	// Units of getDuration() and getBytes().
+	static const Unit * _durationUnits(){
+		static const Unit units[] = {
+			{"", 1}, {"ms", 1},
+			{"s", 1000LL}, {"sec", 1000LL},
+			{"m", 60000LL}, {"min", 60000LL},
+			{"h", 3600000LL},
+			{"d", 86400000LL},
+			{"w", 604800000LL},
+			{nullptr, 0}
+		};
+		return units;
+	}
+
+	static const Unit * _byteUnits(){
+		static const Unit units[] = {
+			{"", 1}, {"b", 1},
+			{"k", 1LL << 10}, {"kib", 1LL << 10}, {"kb", 1000LL},
+			{"m", 1LL << 20}, {"mib", 1LL << 20}, {"mb", 1000000LL},
+			{"g", 1LL << 30}, {"gib", 1LL << 30}, {"gb", 1000000000LL},
+			{"t", 1LL << 40}, {"tib", 1LL << 40}, {"tb", 1000000000000LL},
+			{nullptr, 0}
+		};
+		return units;
+	}
+
+	// Matches the whole string with a shell-style pattern: * is any characters, ? is one character,
+	// [abc], [a-z] and [!a-z] are one character from the set or not from the set. Case matters.
+	static bool _matchPattern(const char *pat, const char *s){
+		const char *starPat = nullptr, *starS = nullptr, *p;
+		bool in, neg;
+
+		while(*s != 0){
+			if(*pat == '*'){
+				starPat = ++pat;
+				starS = s;
+				continue;
+			}
+			if(*pat == '['){
+				p = pat + 1;
+				neg = *p == '!';
+				if(neg) p++;
+				in = false;
+				for(; *p != 0 && (*p != ']' || p == pat + 1 + neg); p++){
+					if(p[1] == '-' && p[2] != ']' && p[2] != 0){
+						if((unsigned char)*s >= (unsigned char)p[0] && (unsigned char)*s <= (unsigned char)p[2]) in = true;
+						p += 2;
+					}else
+					if(*p == *s){
+						in = true;
+					}
+				}
+				if(*p == ']' && in != neg){
+					pat = p + 1;
+					s++;
+					continue;
+				}
+			}else
+			if(*pat != 0 && (*pat == '?' || *pat == *s)){
+				pat++;
+				s++;
+				continue;
+			}
+			// Mismatch. Let the last star take one more character.
+			if(starPat == nullptr) return false;
+			pat = starPat;
+			s = ++starS;
+		}
+		while(*pat == '*') pat++;
+		return *pat == 0;
+	}
+
+	static bool _sameName(const char *a, const char *b){
+		return a == b || (a != nullptr && b != nullptr && strcasecmp(a, b) == 0);
+	}
+
+	// Checks the value of the parameter against the schema entry and adds a diagnostic if it's wrong.
+	bool _checkValue(Param *p, const SchemaEntry *e){
+		IpAddr ip;
+		Endpoint ep;
+		double n = 0;
+		long long units;
+		bool b, hasPort;
+		int kind = 0;
+
+		switch(e->type){
+			case CONFREADER_TYPE_STRING:
+				n = (double)strlen(p->value);
+				break;
+			case CONFREADER_TYPE_INT:
+				if(_isInt(p->value)) n = (double)strtoll(p->value, NULL, 10);
+				else kind = CONFREADER_DIAG_TYPE;
+				break;
+			case CONFREADER_TYPE_DOUBLE:
+				if(_isDouble(p->value)) n = strtod(p->value, NULL);
+				else kind = CONFREADER_DIAG_TYPE;
+				break;
+			case CONFREADER_TYPE_BOOL:
+				if(!_parseBool(p->value, &b)) kind = CONFREADER_DIAG_TYPE;
+				break;
+			case CONFREADER_TYPE_DURATION:
+			case CONFREADER_TYPE_BYTES:
+				if(_parseUnits(p->value, strlen(p->value), e->type == CONFREADER_TYPE_DURATION ? _durationUnits() : _byteUnits(), &units)) n = (double)units;
+				else kind = CONFREADER_DIAG_TYPE;
+				break;
+			case CONFREADER_TYPE_IPADDR:
+				if(!_parseIpAddr(p->value, strlen(p->value), &ip)) kind = CONFREADER_DIAG_TYPE;
+				break;
+			case CONFREADER_TYPE_ENDPOINT:
+				if(!_parseEndpoint(p->value, &ep, &hasPort)) kind = CONFREADER_DIAG_TYPE;
+				break;
+		}
+		if(kind == 0 && (e->flags & CONFREADER_SCHEMA_RANGE) && (n < e->min || n > e->max)){
+			kind = CONFREADER_DIAG_RANGE;
+		}
+		if(kind == 0 && e->pattern != nullptr && !_matchPattern(e->pattern, p->value)){
+			kind = CONFREADER_DIAG_PATTERN;
+		}
+		return kind == 0 || _addDiag(p->lineNum, 0, kind, p->key);
+	}
+
+	// Reads the whole file into a new buffer with one byte more at the end.
+	// Returns nullptr if the file is empty, with errorNum = CONFREADER_OK, or on error.
+	char * _readFile(const char *filename, ssize_t *size){
+		struct stat file_status;
+		char *buf;
+		int fd;
+
+		fd = open(filename, O_RDONLY, S_IRUSR | S_IRGRP | S_IROTH);
+		if(fd == -1){
+			errorNum = CONFREADER_EREADFILE;
+			return nullptr;
+		}
+		if(fstat(fd, &file_status) != 0){
+			close(fd);
+			errorNum = CONFREADER_EREADFILE;
+			return nullptr;
+		}
+
+		*size = file_status.st_size;
+		if(*size == 0){
+			close(fd);
+			errorNum = CONFREADER_OK;		// File is empty.
+			return nullptr;
+		}
+
+		buf = (char *)malloc(*size + 1);		// One byte more.
+		if(buf == nullptr){
+			close(fd);
+			errorNum = CONFREADER_ENOMEM;
+			return nullptr;
+		}
+		if(read(fd, buf, *size) != *size){
+			close(fd);
+			free(buf);
+			errorNum = CONFREADER_EREADFILE;
+			return nullptr;
+		}
+		close(fd);
+		errorNum = CONFREADER_OK;
+		return buf;
+	}
+
+	// Checks that the name of a parameter or a section written to the file is read back as the same name.
+	static bool _isFileName(const char *name, bool section){
+		if(name[0] == 0 || name[0] == '[' || name[0] == '#' || name[0] == ';') return false;
+		for(; *name != 0; name++){
+			if(*name == 0x0A || *name == 0x0D || *name == '=' || *name == ']') return false;
+			// The name of a parameter ends at a space.
+			if(!section && (*name == ' ' || *name == 0x09)) return false;
+		}
+		return true;
+	}
+
+	// Writes the value as it must be in the file to dst and returns its length. If dst is nullptr, only counts the length.
+	// The value is put in double quotes with escape sequences if it can't be read back without them.
+	static int _formatValue(const char *val, char *dst){
+		static const char hex[] = "0123456789ABCDEF";
+		const unsigned char *s = (const unsigned char *)val;
+		bool quote;
+		int len, k;
+
+		len = strlen(val);
+		quote = len == 0 || s[0] == ' ' || s[0] == 0x09 || s[0] == '"' || s[0] == '=' || (s[0] == '<' && s[1] == '<')
+			|| s[len - 1] == ' ' || s[len - 1] == 0x09 || s[len - 1] == '\\';
+		for(k=0; k<len && !quote; k++){
+			if(s[k] < 0x20 || s[k] == 0x7F || s[k] == '#' || s[k] == ';' || s[k] == '\\') quote = true;
+		}
+		if(!quote){
+			if(dst) memcpy(dst, val, len);
+			return len;
+		}
+
+		len = 0;
+		if(dst) dst[len] = '"';
+		len++;
+		for(; *s != 0; s++){
+			if(*s == '\\' || *s == '"' || *s == 0x0A || *s == 0x0D || *s == 0x09){
+				if(dst){
+					dst[len] = '\\';
+					dst[len + 1] = *s == 0x0A ? 'n' : (*s == 0x0D ? 'r' : (*s == 0x09 ? 't' : *s));
+				}
+				len += 2;
+			}else
+			if(*s < 0x20 || *s == 0x7F){
+				if(dst){
+					dst[len] = '\\';
+					dst[len + 1] = 'x';
+					dst[len + 2] = hex[*s >> 4];
+					dst[len + 3] = hex[*s & 15];
+				}
+				len += 4;
+			}else{
+				if(dst) dst[len] = *s;
+				len++;
+			}
+		}
+		if(dst) dst[len] = '"';
+		return len + 1;
+	}
+
+	// Writes the parts into a temporary file next to the file and renames it to the file,
+	// so the readers see either the old file or the new one. The parts are changed.
+	int _writeAtomic(const char *filename, struct iovec *iov, int iovCount){
+		struct stat file_status;
+		char *tmp;
+		ssize_t n;
+		bool ok;
+		int fd;
+
+		tmp = (char *)malloc(strlen(filename) + 8);
+		if(tmp == nullptr){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		strcpy(tmp, filename);
+		strcat(tmp, ".XXXXXX");
+		fd = mkstemp(tmp);
+		if(fd == -1){
+			free(tmp);
+			errorNum = CONFREADER_EWRITEFILE;
+			return CONFREADER_ERROR;
+		}
+		// The new file gets the permissions of the old one.
+		if(stat(filename, &file_status) == 0){
+			fchmod(fd, file_status.st_mode & 07777);
+		}
+
+		while(iovCount > 0){
+			n = writev(fd, iov, iovCount > 1024 ? 1024 : iovCount);
+			if(n < 0 && errno == EINTR) continue;
+			if(n <= 0) break;
+			// Let's skip what was written.
+			for(; iovCount > 0 && (size_t)n >= iov->iov_len; iov++, iovCount--){
+				n -= iov->iov_len;
+			}
+			if(iovCount > 0){
+				iov->iov_base = (char *)iov->iov_base + n;
+				iov->iov_len -= n;
+			}
+		}
+		ok = iovCount == 0 && fsync(fd) == 0;
+		if(close(fd) != 0) ok = false;
+		if(!ok || rename(tmp, filename) != 0){
+			unlink(tmp);
+			free(tmp);
+			errorNum = CONFREADER_EWRITEFILE;
+			return CONFREADER_ERROR;
+		}
+		free(tmp);
+		errorNum = CONFREADER_OK;
+		return CONFREADER_OK;
+	}
+
+	static int _compareEdits(const void *a, const void *b){
+		const Edit *ea = (const Edit *)a, *eb = (const Edit *)b;
+
+		if(ea->start != eb->start) return ea->start < eb->start ? -1 : 1;
+		return ea->seq < eb->seq ? -1 : (ea->seq > eb->seq ? 1 : 0);
+	}
+
+	// Copies n bytes to dst at len, if dst is not nullptr. Returns the new length.
+	static int _put(char *dst, int len, const char *s, int n){
+		if(dst) memcpy(&dst[len], s, n);
+		return len + n;
+	}
+
+	// Nonzero if any of the 8 bytes is a control character, a double quote or a backslash.
+	// The high bit of a byte stays the same after the xor, so ~v masks out the bytes above 0x7F for all three tests.
+	static unsigned long long _hasJsonSpecial(unsigned long long v){
+		const unsigned long long ones = 0x0101010101010101ULL;
+		unsigned long long q = v ^ (ones * '"'), b = v ^ (ones * '\\');
+
+		return ((v - ones * 0x20) | (q - ones) | (b - ones)) & ~v & 0x8080808080808080ULL;
+	}
+
+	// Writes the string as a JSON string in double quotes to dst at len. If dst is nullptr, only counts the length.
+	// Returns the new length. The valid UTF-8 characters are copied as they are, an invalid byte gives \ufffd.
+	static int _jsonString(const char *val, char *dst, int len){
+		static const char hex[] = "0123456789abcdef";
+		const unsigned char *s = (const unsigned char *)val;
+		unsigned long long v;
+		char esc[6];
+		int size, k, n, end;
+
+		size = strlen(val);
+		len = _put(dst, len, "\"", 1);
+		for(k=0; k<size; ){
+			// Let's copy 8 bytes at a time while they are ASCII and there is nothing to escape in them.
+			if(size - k >= 8){
+				memcpy(&v, &s[k], 8);
+				if(!_hasJsonSpecial(v) && (v & 0x8080808080808080ULL) == 0){
+					len = _put(dst, len, (const char *)&s[k], 8);
+					k += 8;
+					continue;
+				}
+			}
+			for(end=k+(size - k < 8 ? size - k : 8); k<end; k++){
+				if(s[k] >= 0x80){
+					if((n = _utf8Length(&s[k], size - k)) > 0){
+						len = _put(dst, len, (const char *)&s[k], n);
+						k += n - 1;
+					}else{
+						len = _put(dst, len, "\\ufffd", 6);
+					}
+					continue;
+				}
+				if(s[k] >= 0x20 && s[k] != '"' && s[k] != '\\'){
+					len = _put(dst, len, (const char *)&s[k], 1);
+					continue;
+				}
+				esc[0] = '\\';
+				switch(s[k]){
+					case '"': esc[1] = '"'; break;
+					case '\\': esc[1] = '\\'; break;
+					case 0x08: esc[1] = 'b'; break;
+					case 0x09: esc[1] = 't'; break;
+					case 0x0A: esc[1] = 'n'; break;
+					case 0x0C: esc[1] = 'f'; break;
+					case 0x0D: esc[1] = 'r'; break;
+					default:
+						memcpy(&esc[1], "u00", 3);
+						esc[4] = hex[s[k] >> 4];
+						esc[5] = hex[s[k] & 15];
+						len = _put(dst, len, esc, 6);
+						continue;
+				}
+				len = _put(dst, len, esc, 2);
+			}
+		}
+		return _put(dst, len, "\"", 1);
+	}
+
+	// Writes all the parameters as JSON or as section.key=value lines to dst. If dst is nullptr, only counts the length.
+	// Returns the length or -1 if a value can't be decoded.
+	int _dump(char *dst, bool json){
+		Param *p;
+		int len = 0, i, j;
+
+		if(json) len = _put(dst, len, "{", 1);
+		for(i=0; i<sectCount; i++){
+			if(json && i > 0){
+				if(len > 1) len = _put(dst, len, ",", 1);
+				len = _jsonString(sects[i].name, dst, len);
+				len = _put(dst, len, ":{", 2);
+			}
+			for(j=0; j<sects[i].size; j++){
+				p = &sects[i].params[j];
+				if(!_decode(p)) return -1;
+				if(json){
+					if(j > 0) len = _put(dst, len, ",", 1);
+					len = _jsonString(p->key, dst, len);
+					len = _put(dst, len, ":", 1);
+					len = _jsonString(p->value, dst, len);
+				}else{
+					if(i > 0){
+						len = _put(dst, len, sects[i].name, strlen(sects[i].name));
+						len = _put(dst, len, ".", 1);
+					}
+					len = _put(dst, len, p->key, strlen(p->key));
+					len = _put(dst, len, "=", 1);
+					len += _formatValue(p->value, dst ? &dst[len] : nullptr);
+					len = _put(dst, len, "\n", 1);
+				}
+			}
+			if(json && i > 0) len = _put(dst, len, "}", 1);
+		}
+		if(json) len = _put(dst, len, "}", 1);
+		return len;
+	}
+
+	// Counts the length of the text first, so that it is written into the buffer without checking the size.
+	int _dumpTo(char *buf, int size, bool json){
+		int len;
+
+		if((len = _dump(nullptr, json)) < 0 || (buf && len < size && _dump(buf, json) < 0)){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		if(buf && len < size) buf[len] = 0;
+		errorNum = CONFREADER_OK;
+		return len;
+	}
+
+	// The character of the environment variable name: letters in upper case, "_" for all except letters and digits.
+	static char _envChar(char c){
+		if(c >= 'a' && c <= 'z') return c - 32;
+		if((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) return c;
+		return '_';
+	}
+
+	// FNV-1a hash of the name as in the environment variable, up to 0 or the end character.
+	static unsigned int _envHash(const char *s, char end, unsigned int h){
+		for(; *s != 0 && *s != end; s++){
+			h = (h ^ (unsigned char)_envChar(*s)) * 16777619u;
+		}
+		return h;
+	}
+
+	// Compares the name of the variable up to "=" with the section, "_" and the key.
+	// Returns the value of the variable or nullptr.
+	static const char * _envMatch(const char *name, const char *section, const char *key){
+		if(section){
+			for(; *section != 0; section++, name++){
+				if(*name == '=' || *name != _envChar(*section)) return nullptr;
+			}
+			if(*name++ != '_') return nullptr;
+		}
+		for(; *key != 0; key++, name++){
+			if(*name == '=' || *name != _envChar(*key)) return nullptr;
+		}
+		return *name == '=' ? name + 1 : nullptr;
+	}
+
+	// Copies the string into the arena.
+	char * _copyString(const char *s, size_t len){
+		char *copy;
+
+		if((copy = (char *)(_shared ? _sharedAlloc(len + 1) : _alloc(len + 1))) != nullptr){
+			memcpy(copy, s, len);
+			copy[len] = 0;
+		}
+		return copy;
+	}
+
+	// Replaces the value of the parameter. The converted value cached on the parameter is dropped.
+	static void _setValue(Param *p, char *val){
+		p->value = val;
+		p->flags = 0;
+		memset(&p->cache, 0, sizeof(Cache));
+	}
+
+	// Overrides the parameters with the environment variables which start with the prefix. The parameters are put
+	// into a hash table by the names of their variables, so environ is read once.
+	bool _applyEnv(const char *prefix){
+		EnvSlot *slots;
+		const char *val;
+		char *copy;
+		unsigned int h, mask;
+		size_t prefixLen;
+		int count = 0, i, j;
+		char **env;
+
+		for(i=0; i<sectCount; i++) count += sects[i].size;
+		if(count == 0) return true;
+		for(mask=15; mask < (unsigned int)count * 2; mask=mask*2+1);
+		slots = (EnvSlot *)calloc(mask + 1, sizeof(EnvSlot));
+		if(slots == nullptr) return false;
+
+		for(i=0; i<sectCount; i++){
+			for(j=0; j<sects[i].size; j++){
+				h = i > 0 ? _envHash("_", 0, _envHash(sects[i].name, 0, 2166136261u)) : 2166136261u;
+				for(h=_envHash(sects[i].params[j].key, 0, h); slots[h & mask].param; h++);
+				slots[h & mask].param = &sects[i].params[j];
+				slots[h & mask].section = sects[i].name;
+			}
+		}
+
+		prefixLen = strlen(prefix);
+		for(env=environ; *env; env++){
+			if(strncmp(*env, prefix, prefixLen) != 0) continue;
+			// All the parameters with this name are overridden, e.g. a key which is repeated in the section.
+			for(h=_envHash(*env + prefixLen, '=', 2166136261u); slots[h & mask].param; h++){
+				if((val = _envMatch(*env + prefixLen, slots[h & mask].section, slots[h & mask].param->key)) == nullptr) continue;
+				if((copy = _copyString(val, strlen(val))) == nullptr){
+					free(slots);
+					return false;
+				}
+				_setValue(slots[h & mask].param, copy);
+			}
+		}
+		free(slots);
+		return true;
+	}
+
+	// Adds the parameters which are not in the file, at the end of their sections. The new sections are added
+	// at the end. The arrays of the sections and the parameters are built again, so that each section
+	// stays a contiguous part of the parameters.
+	bool _addParams(const Change *adds, int addCount){
+		Section *newSects;
+		Param *newParams, *p;
+		int *target;
+		int count = 0, newSectCount, i, j, k;
+
+		for(i=0; i<sectCount; i++) count += sects[i].size;
+		newSects = (Section *)malloc((sectCount + addCount + 1) * sizeof(Section));
+		newParams = (Param *)malloc((count + addCount) * sizeof(Param));
+		target = (int *)malloc(addCount * sizeof(int));
+		if(newSects == nullptr || newParams == nullptr || target == nullptr){
+			free(newSects);
+			free(newParams);
+			free(target);
+			return false;
+		}
+
+		if(sectCount > 0){
+			memcpy(newSects, sects, sectCount * sizeof(Section));
+			newSectCount = sectCount;
+		}else{
+			newSects[0].name = nullptr;			// The file was empty.
+			newSects[0].size = 0;
+			newSects[0].hits = 0;
+			newSects[0].lineNum = 0;
+			newSects[0].hash = 0;
+			newSectCount = 1;
+		}
+		for(i=0; i<addCount; i++){
+			for(k=0; k<newSectCount && !_sameName(newSects[k].name, adds[i].section); k++);
+			if(k == newSectCount){
+				newSects[k].name = (char *)adds[i].section;
+				newSects[k].size = 0;
+				newSects[k].hits = 0;
+				newSects[k].lineNum = 0;
+				newSects[k].hash = 0;
+				newSectCount++;
+			}
+			target[i] = k;
+		}
+
+		p = newParams;
+		for(k=0; k<newSectCount; k++){
+			if(k < sectCount && sects[k].size > 0) memcpy(p, sects[k].params, sects[k].size * sizeof(Param));
+			newSects[k].params = p;
+			p += newSects[k].size;
+			for(i=0; i<addCount; i++){
+				if(target[i] != k) continue;
+				p->key = (char *)adds[i].key;
+				p->value = (char *)adds[i].value;
+				p->flags = 0;
+				p->lineNum = 0;
+				p->hits = 0;
+				p->valueStart = p->valueEnd = -1;
+				memset(&p->cache, 0, sizeof(Cache));
+				p++;
+				newSects[k].size++;
+			}
+		}
+		for(j=0; j<newSectCount; j++){
+			if(newSects[j].size == 0) newSects[j].params = nullptr;
+		}
+
+		free(target);
+		free(sects);
+		free(_params);
+		sects = newSects;
+		sectCount = newSectCount;
+		_params = newParams;
+		_paramCount = count + addCount;
+		_buildBlooms();
+		_changed();
+		return true;
+	}
+
+	// Three bits of the Bloom filter for each key. The step is odd, so the three bits are different.
+	static void _addBloom(Section *sect, unsigned int h){
+		unsigned int step = (h >> 17 | h << 15) | 1;
+		int k;
+
+		for(k=0; k<3; k++, h+=step){
+			sect->bloom[(h & sect->bloomMask) >> 6] |= 1ULL << (h & 63);
+		}
+	}
+
+	static bool _inBloom(const Section *sect, unsigned int h){
+		unsigned int step = (h >> 17 | h << 15) | 1;
+		int k;
+
+		for(k=0; k<3; k++, h+=step){
+			if((sect->bloom[(h & sect->bloomMask) >> 6] & (1ULL << (h & 63))) == 0) return false;
+		}
+		return true;
+	}
+
+	// Builds the filters of the keys of all sections, at least 12 bits for a key, so that less than 1% of
+	// the missing keys have to be compared. Without memory the sections are left without filters.
+	void _buildBlooms(){
+		unsigned int bits;
+		size_t words = 0;
+		int i, j;
+
+		free(_blooms);
+		_blooms = nullptr;
+		for(i=0; i<sectCount; i++){
+			for(bits=64; bits < (unsigned int)sects[i].size * 12; bits*=2);
+			sects[i].bloom = nullptr;
+			sects[i].bloomMask = bits - 1;
+			words += bits / 64;
+		}
+		if((_blooms = (unsigned long long *)calloc(words, sizeof(unsigned long long))) == nullptr) return;
+
+		words = 0;
+		for(i=0; i<sectCount; i++){
+			sects[i].bloom = &_blooms[words];
+			words += (sects[i].bloomMask + 1) / 64;
+			for(j=0; j<sects[i].size; j++){
+				_addBloom(&sects[i], _hashKey(sects[i].params[j].key));
+			}
+		}
+	}
+
+	// Builds the filter of a section changed by derive() in the arena.
+	bool _arenaBloom(Section *sect){
+		unsigned int bits;
+		int j;
+
+		for(bits=64; bits < (unsigned int)sect->size * 12; bits*=2);
+		sect->bloomMask = bits - 1;
+		if((sect->bloom = (unsigned long long *)_sharedAlloc(bits / 8)) == nullptr) return false;
+		memset(sect->bloom, 0, bits / 8);
+		for(j=0; j<sect->size; j++){
+			_addBloom(sect, _hashKey(sect->params[j].key));
+		}
+		return true;
+	}
+
+	// The number of reads of the parameter in the profile.
+	int _profileHits(const char *key, const char *section){
+		unsigned int h;
+		int i;
+
+		for(h=_hashKey(key, _hashKey(section ? section : "")); (i = _profileSlots[h & _profileMask]) >= 0; h++){
+			if(_sameName(_profile[i].key, key) && _sameName(_profile[i].section, section)) return _profile[i].hits;
+		}
+		return 0;
+	}
+
+	// The most read first, the rest in the order of the file.
+	static int _compareHot(int hitsA, int lineA, int hitsB, int lineB){
+		if(hitsA != hitsB) return hitsA > hitsB ? -1 : 1;
+		return lineA < lineB ? -1 : (lineA > lineB ? 1 : 0);
+	}
+
+	static int _compareHotParams(const void *a, const void *b){
+		const Param *pa = (const Param *)a, *pb = (const Param *)b;
+
+		return _compareHot(pa->hits, pa->lineNum, pb->hits, pb->lineNum);
+	}
+
+	static int _compareHotSects(const void *a, const void *b){
+		const Section *sa = (const Section *)a, *sb = (const Section *)b;
+
+		return _compareHot(sa->hits, sa->lineNum, sb->hits, sb->lineNum);
+	}
+
+	// Orders the parameters of each section and the sections by the reads in the profile, so that the lookups
+	// meet the most read parameters first. The section of the parameters without section stays the first.
+	void _orderByProfile(){
+		int i, j;
+
+		for(i=0; i<sectCount; i++){
+			for(j=0; j<sects[i].size; j++){
+				sects[i].params[j].hits = _profileHits(sects[i].params[j].key, sects[i].name);
+				sects[i].hits += sects[i].params[j].hits;
+			}
+			if(sects[i].size > 1) qsort(sects[i].params, sects[i].size, sizeof(Param), _compareHotParams);
+			// The counters are for the reads of this process.
+			for(j=0; j<sects[i].size; j++){
+				sects[i].params[j].hits = 0;
+			}
+		}
+		// The duplicates of a section get the reads of all of them, so that they keep the order of the file
+		// and the lookups still find the first of them.
+		for(i=2; i<sectCount; i++){
+			for(j=1; j<i && !_sameName(sects[j].name, sects[i].name); j++);
+			if(j < i) sects[j].hits += sects[i].hits;
+		}
+		for(i=2; i<sectCount; i++){
+			for(j=1; j<i && !_sameName(sects[j].name, sects[i].name); j++);
+			if(j < i) sects[i].hits = sects[j].hits;
+		}
+		if(sectCount > 2) qsort(&sects[1], sectCount - 1, sizeof(Section), _compareHotSects);
+	}
+
+	// Reads a list of numbers like "0-3,8-11" from the file into set, up to max. Returns the largest number plus one or -1.
+	static int _readList(const char *path, unsigned char *set, int max){
+		char text[4096];
+		ssize_t size;
+		int fd, first, last, end = 0;
+		char *s;
+
+		if((fd = open(path, O_RDONLY)) == -1) return -1;
+		size = read(fd, text, sizeof(text) - 1);
+		close(fd);
+		if(size <= 0) return -1;
+		text[size] = 0;
+
+		for(s=text; *s >= '0' && *s <= '9'; ){
+			first = last = strtol(s, &s, 10);
+			if(*s == '-') last = strtol(s + 1, &s, 10);
+			for(; first <= last; first++){
+				if(set && first < max) set[first] = 1;
+			}
+			if(last + 1 > end) end = last + 1;
+			if(*s == ',') s++;
+		}
+		return end;
+	}
+
+	// The NUMA node of the CPU the thread runs on. The CPU is remembered by the thread and read again
+	// every CONFREADER_NODE_CHECK lookups, since the thread may be moved to another one.
+	int _currentNode(){
+		static thread_local unsigned int calls = 0;
+		static thread_local int cpu = -1;
+
+		if(calls++ % CONFREADER_NODE_CHECK == 0) cpu = sched_getcpu();
+		return cpu >= 0 && cpu < _cpuCount ? _cpuNodes[cpu] : 0;
+	}
+
+	// Moves a pointer into the file buffer to the same place in the copy of the buffer.
+	char * _rebase(char *ptr, char *buf){
+		return ptr >= _fileBuf && ptr <= _fileBuf + _fileSize ? buf + (ptr - _fileBuf) : ptr;
+	}
+
+	bool _inFile(const char *s){
+		return _fileBuf != nullptr && s >= _fileBuf && s <= _fileBuf + _fileSize;
+	}
+
+	// Moves a string into the frozen block: into the copy of the file, or after it if it is not in the file.
+	char * _freezeString(char *s, char *buf, char **tail){
+		char *copy;
+
+		if(s == nullptr) return nullptr;
+		if(_inFile(s)) return buf + (s - _fileBuf);
+		copy = *tail;
+		strcpy(copy, s);
+		*tail += strlen(s) + 1;
+		return copy;
+	}
+
+	void _freeReplicas(){
+		int i;
+
+		if(_replicas){
+			for(i=0; i<_replicaCount; i++){
+				if(_replicas[i].mem) munmap(_replicas[i].mem, _replicas[i].memSize);
+			}
+			free(_replicas);
+			_replicas = nullptr;
+		}
+		_replicaCount = 0;
+		if(_cpuNodes){
+			free(_cpuNodes);
+			_cpuNodes = nullptr;
+		}
+		_cpuCount = 0;
+		_changed();
+	}
+
+	// Moves the file, the parameters and the arena into the memory shared with the snapshots made by derive().
+	bool _share(){
+		Shared *s;
+
+		if(_shared) return true;
+		if(_frozen) return false;		// The frozen data is in one block, it can't be freed apart.
+		if((s = (Shared *)malloc(sizeof(Shared))) == nullptr) return false;
+		s->refs = 1;
+		s->copied = 0;
+		s->fileBuf = _fileBuf;
+		s->params = _params;
+		s->blooms = _blooms;
+		s->arena.lock = 0;
+		// The readers may be converting values at the same time, they allocate from the shared arena after this.
+		while(__atomic_exchange_n(&_ownArena.lock, 1, __ATOMIC_ACQUIRE)){
+		}
+		s->arena.blocks = _ownArena.blocks;
+		_ownArena.blocks = nullptr;
+		__atomic_store_n(&_arena, &s->arena, __ATOMIC_RELEASE);
+		__atomic_store_n(&_ownArena.lock, 0, __ATOMIC_RELEASE);
+		_shared = s;
+		return true;
+	}
+
+	// Leaves the shared memory, the last object frees it.
+	void _release(){
+		Shared *s = _shared;
+
+		if(s == nullptr) return;
+		if(__atomic_sub_fetch(&s->refs, 1, __ATOMIC_ACQ_REL) == 0){
+			free(s->fileBuf);
+			free(s->params);
+			free(s->blooms);
+			_freeArena(&s->arena);
+			free(s);
+		}
+		_shared = nullptr;
+		_arena = &_ownArena;
+		_fileBuf = nullptr;
+		_params = nullptr;
+		_blooms = nullptr;
+	}
+
+	// Makes an empty object which shares the memory of this one, with the room for sectCap sections.
+	// The options, the aliases and the fingerprint are taken from the object from. Returns nullptr if there is no memory.
+	Confreader * _snapshot(int sectCap, Confreader *from){
+		Confreader *snap = new Confreader();
+
+		snap->sects = (Section *)malloc(sectCap * sizeof(Section));
+		if(snap->sects == nullptr || !_share()){
+			delete snap;
+			return nullptr;
+		}
+		__atomic_add_fetch(&_shared->refs, 1, __ATOMIC_RELAXED);
+		snap->_shared = _shared;
+		snap->_arena = &_shared->arena;
+		snap->_fileBuf = _fileBuf;
+		snap->_fileSize = _fileSize;
+		snap->_bomSize = _bomSize;
+		snap->_fingerprint = from->_fingerprint;
+		snap->_fileHash = from->_fileHash;
+		snap->options = from->options;
+		if(from->_aliasCount > 0 && snap->setAliases(from->_aliases, from->_aliasCount) != CONFREADER_OK){
+			delete snap;
+			return nullptr;
+		}
+		return snap;
+	}
+
+	// Allocates the memory of a copied section from the shared arena and counts it.
+	void * _sharedAlloc(size_t size){
+		__atomic_add_fetch(&_shared->copied, size, __ATOMIC_RELAXED);
+		return _alloc(size);
+	}
+
+	// The hash of other in base matched the one of sect, so let's check that the keys and the values are the same.
+	bool _sameSection(Section *sect, Confreader *base, Section *other){
+		Param *a, *b;
+		int j;
+
+		if(sect->size != other->size || !(sect->name == other->name || (sect->name && other->name && strcmp(sect->name, other->name) == 0))) return false;
+		for(j=0; j<sect->size; j++){
+			a = &sect->params[j];
+			b = &other->params[j];
+			if(!_decode(a) || !base->_decode(b)) return false;
+			if(strcmp(a->key, b->key) != 0 || strcmp(a->value, b->value) != 0) return false;
+		}
+		return true;
+	}
+
+	// Makes a copy of this object in the memory shared with base. The sections with the same names and values
+	// as a section of base are taken from it, the others are copied. Returns nullptr if there is no memory.
+	Confreader * _dedup(Confreader *base){
+		Confreader *snap;
+		Section *sect;
+		Param *p;
+		int i, j, k;
+		bool ok = true;
+
+		if((snap = base->_snapshot(sectCount > 0 ? sectCount : 1, this)) == nullptr) return nullptr;
+		memset(snap->sects, 0, sizeof(Section));		// No file was parsed.
+		snap->sectCount = sectCount > 0 ? sectCount : 1;
+		for(i=0; i<sectCount && ok; i++){
+			sect = &snap->sects[i];
+			for(k=0; k<base->sectCount && !(base->sects[k].hash == sects[i].hash && _sameSection(&sects[i], base, &base->sects[k])); k++);
+			if(k < base->sectCount){
+				*sect = base->sects[k];
+				continue;
+			}
+
+			// The section is not in the file of base, so its names and values are copied.
+			*sect = sects[i];
+			sect->lineNum = 0;
+			sect->bloom = nullptr;
+			if(sects[i].name && (sect->name = snap->_copyString(sects[i].name, strlen(sects[i].name))) == nullptr){
+				ok = false;
+				break;
+			}
+			if(sect->size == 0) continue;
+			if((sect->params = (Param *)snap->_sharedAlloc(sect->size * sizeof(Param))) == nullptr){
+				ok = false;
+				break;
+			}
+			for(j=0; j<sect->size && ok; j++){
+				p = &sect->params[j];
+				if(!_decode(&sects[i].params[j])){
+					ok = false;
+					break;
+				}
+				*p = sects[i].params[j];
+				p->key = snap->_copyString(p->key, strlen(p->key));
+				p->value = snap->_copyString(p->value, strlen(p->value));
+				p->lineNum = 0;
+				p->hits = 0;
+				p->valueStart = p->valueEnd = -1;
+				memset(&p->cache, 0, sizeof(Cache));
+				ok = p->key != nullptr && p->value != nullptr;
+			}
+			if(ok) ok = snap->_arenaBloom(sect);
+		}
+
+		if(!ok){
+			delete snap;
+			return nullptr;
+		}
+		return snap;
+	}
+
+	// The parameters are changed, so the lookups cached by the threads are not valid any more.
+	void _changed(){
+		static unsigned long long lastGeneration = 0;
+
+		_generation = __atomic_add_fetch(&lastGeneration, 1, __ATOMIC_RELAXED);
+	}
+
+	// The inputs are also xored into the result, so a block which makes one of them 0 doesn't drop the hash so far.
+	static unsigned long long _mix64(unsigned long long a, unsigned long long b){
+#ifdef __SIZEOF_INT128__
+		__uint128_t r = (__uint128_t)a * b;
+
+		return (unsigned long long)r ^ (unsigned long long)(r >> 64) ^ a ^ b;
+#else
+		// There is no 128-bit type on 32-bit targets, the product is put together from the products of the 32-bit halves.
+		unsigned long long ll, lh, hl, hh, mid;
+
+		ll = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+		lh = (a & 0xFFFFFFFFULL) * (b >> 32);
+		hl = (a >> 32) * (b & 0xFFFFFFFFULL);
+		hh = (a >> 32) * (b >> 32);
+		mid = (ll >> 32) + (lh & 0xFFFFFFFFULL) + (hl & 0xFFFFFFFFULL);
+		return ((mid << 32) | (ll & 0xFFFFFFFFULL)) ^ (hh + (lh >> 32) + (hl >> 32) + (mid >> 32)) ^ a ^ b;
+#endif
+	}
+
+	// 64-bit hash of len bytes, 16 bytes a step with one 128-bit multiplication, like wyhash. It goes on from h,
+	// so several strings can be hashed as one.
+	static unsigned long long _hash64(const char *s, size_t len, unsigned long long h){
+		unsigned long long a, b;
+		size_t i;
+
+		for(i=0; i + 16 <= len; i+=16){
+			memcpy(&a, s + i, 8);
+			memcpy(&b, s + i + 8, 8);
+			h = _mix64(a ^ 0xa0761d6478bd642fULL, b ^ h);
+		}
+		a = b = 0;
+		memcpy(&a, s + i, len - i < 8 ? len - i : 8);
+		if(len - i > 8) memcpy(&b, s + i + 8, len - i - 8);
+		return _mix64(_mix64(a ^ 0xe7037ed1a0b428dbULL, b ^ h) ^ len, 0x8ebc6af09c88c6e3ULL);
+	}
+
+	// The hash of a section is of its name, and of the names and the values of its parameters as they are
+	// written in the file, so the comments and the spaces around don't change it. The unquoted values are
+	// hashed as they were joined, without the backslashes and the indentation of the continued lines.
+	// The values which are not in the file any more, e.g. set by derive(), are hashed as they are.
+	void _hashSection(Section *sect){
+		Param *p;
+		int j;
+
+		sect->hash = sect->name ? _hash64(sect->name, strlen(sect->name), 0) : 0;
+		for(j=0; j<sect->size; j++){
+			p = &sect->params[j];
+			sect->hash = _hash64(p->key, strlen(p->key), sect->hash);
+			if(p->valueStart >= 0 && p->value >= _fileBuf && p->value <= _fileBuf + _fileSize && p->value != &_fileBuf[p->valueStart]){
+				sect->hash = _hash64(&_fileBuf[p->valueStart], p->valueEnd - p->valueStart, sect->hash);
+			}else{
+				sect->hash = _hash64(p->value, strlen(p->value), sect->hash);
+			}
+		}
+	}
+
+	void _hashSections(){
+		int i;
+
+		for(i=0; i<sectCount; i++){
+			_hashSection(&sects[i]);
+		}
+	}
+
+	// Case-insensitive FNV-1a hash of a name.
+	static constexpr unsigned int _hashKey(const char *s, unsigned int h = 2166136261u){
+		return *s == 0 ? h : _hashKey(s + 1, (h ^ (unsigned char)((*s >= 'A' && *s <= 'Z') ? *s + 32 : *s)) * 16777619u);
+	}
+
+	// The same hash of the first len characters.
+	static constexpr unsigned int _hashKeyN(const char *s, int len, unsigned int h = 2166136261u){
+		return len == 0 ? h : _hashKeyN(s + 1, len - 1, (h ^ (unsigned char)((*s >= 'A' && *s <= 'Z') ? *s + 32 : *s)) * 16777619u);
+	}
+
+	static unsigned int _nameHash(const Name &name){
+		return name.hash != 0 ? name.hash : name.len < 0 ? _hashKey(name.str) : _hashKeyN(name.str, name.len);
+	}
+
+	// A name with the length may have 0 inside, then strncasecmp() would stop at it and s[name.len] would be
+	// after the end of the stored name. Such a name is never equal to a stored one.
+	static bool _equalName(const char *s, const Name &name){
+		if(name.len < 0) return strcasecmp(s, name.str) == 0;
+		return memchr(name.str, 0, name.len) == nullptr && strncasecmp(s, name.str, name.len) == 0 && s[name.len] == 0;
+	}
+
+public:
+	int errorNum;
+	int errorLineNum;
+	int errorColNum;			// Counted in UTF-8 characters from 1.
+	int options;				// CONFREADER_OPT_... , used by parseFile().
+	Diagnostic *diags;			// All the errors sorted by line, if CONFREADER_OPT_ALL_ERRORS is set.
+	int diagCount;
+	int deprecatedHits;			// The old names of the parameters found in the file and read by the get methods.
+	Section *sects;
+	int sectCount;
+	
+	Confreader(){
+		init();
+	}
+	Confreader(char *filename, int opts = 0){
+		init();
+		options = opts;
+		parseFile(filename);
+	}
+	~Confreader(){
+		clear();
+		free(_aliasSlots);
+		setProfile(nullptr);
+	}
+
+	void init(){
+		sectCount = 0;
+		sects = nullptr;
+		_params = nullptr;
+		_lines = nullptr;
+		_lineEnds = nullptr;
+		_fileBuf = nullptr;
+		_ownArena.blocks = nullptr;
+		_ownArena.lock = 0;
+		_arena = &_ownArena;
+		_shared = nullptr;
+		_fileSize = 0;
+		_bomSize = 0;
+		errorNum = 0;
+		errorLineNum = 0;
+		errorColNum = 0;
+		options = 0;
+		diags = nullptr;
+		diagCount = 0;
+		_diagCap = 0;
+		deprecatedHits = 0;
+		_aliases = nullptr;
+		_aliasCount = 0;
+		_aliasSlots = nullptr;
+		_aliasMask = 0;
+		_blooms = nullptr;
+		_fingerprint = 0;
+		_fileHash = 0;
+		_profileBuf = nullptr;
+		_profile = nullptr;
+		_profileCount = 0;
+		_profileSlots = nullptr;
+		_profileMask = 0;
+		_replicas = nullptr;
+		_replicaCount = 0;
+		_cpuNodes = nullptr;
+		_cpuCount = 0;
+		_frozen = nullptr;
+		_frozenSize = 0;
+		_frozenParams = nullptr;
+		_states = nullptr;
+		_changed();
+	}
+
+	void clear(){
+		_freeReplicas();
+		_release();
+		if(_frozen){
+			// The sections and the file are in the block.
+			munmap(_frozen, _frozenSize);
+			_frozen = nullptr;
+			_frozenParams = nullptr;
+			sects = nullptr;
+			_fileBuf = nullptr;
+			free(_states);
+			_states = nullptr;
+		}
+		sectCount = 0;
+		if(sects){
+			free(sects);
+			sects = nullptr;
+		}
+		if(_params){
+			free(_params);
+			_params = nullptr;
+		}
+		if(_lines){
+			free(_lines);
+			_lines = nullptr;
+		}
+		if(_lineEnds){
+			free(_lineEnds);
+			_lineEnds = nullptr;
+		}
+		if(_fileBuf){
+			free(_fileBuf);
+			_fileBuf = nullptr;
+		}
+		if(_blooms){
+			free(_blooms);
+			_blooms = nullptr;
+		}
+		if(diags){
+			free(diags);
+			diags = nullptr;
+		}
+		diagCount = 0;
+		_diagCap = 0;
+		deprecatedHits = 0;
+		_fingerprint = 0;
+		_fileHash = 0;
+		_freeArena(&_ownArena);
+	}
+
+	static const char * diagMessage(int kind){
+		switch(kind){
+			case CONFREADER_DIAG_CR:		return "carriage return without line feed";
+			case CONFREADER_DIAG_SECTION:	return "no closing bracket of the section name";
+			case CONFREADER_DIAG_JUNK:		return "unexpected characters at the end of the line";
+			case CONFREADER_DIAG_NOVALUE:	return "no value of the parameter";
+			case CONFREADER_DIAG_COMMENT:	return "comment is not separated from the value by a space";
+			case CONFREADER_DIAG_QUOTE:		return "no closing quote";
+			case CONFREADER_DIAG_HEREDOC:	return "no line with the closing tag";
+			case CONFREADER_DIAG_UTF8:		return "invalid UTF-8";
+			case CONFREADER_DIAG_UNKNOWN_SECTION:	return "unknown section";
+			case CONFREADER_DIAG_UNKNOWN_KEY:	return "unknown parameter";
+			case CONFREADER_DIAG_MISSING_KEY:	return "missing required parameter";
+			case CONFREADER_DIAG_TYPE:		return "wrong type of the value";
+			case CONFREADER_DIAG_RANGE:		return "value is out of range";
+			case CONFREADER_DIAG_PATTERN:	return "value doesn't match the pattern";
+		}
+		return "unknown error";
+	}
+
+	// Sets the table of the old names of the parameters, before parseFile(). The parameters with the old names
+	// in the file get the new names, and the old names given to the get methods are read as the new ones.
+	// deprecatedHits counts both. The table must live as long as the object; nullptr removes it.
+	int setAliases(const Alias *aliases, int count){
+		unsigned int h, mask;
+		int i;
+
+		free(_aliasSlots);
+		_aliasSlots = nullptr;
+		_aliases = nullptr;
+		_aliasCount = 0;
+		_changed();
+		errorNum = CONFREADER_OK;
+		if(aliases == nullptr || count <= 0) return CONFREADER_OK;
+
+		for(mask=15; mask < (unsigned int)count * 2; mask=mask*2+1);
+		_aliasSlots = (int *)malloc((mask + 1) * sizeof(int));
+		if(_aliasSlots == nullptr){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		memset(_aliasSlots, 0xFF, (mask + 1) * sizeof(int));
+		for(i=0; i<count; i++){
+			for(h=_hashKey(aliases[i].oldKey); _aliasSlots[h & mask] >= 0; h++);
+			_aliasSlots[h & mask] = i;
+		}
+		_aliases = aliases;
+		_aliasCount = count;
+		_aliasMask = mask;
+		return CONFREADER_OK;
+	}
+
+	// Reads the profile written by saveProfile(), before parseFile(). Then parseFile() puts the parameters
+	// which were read more often first in their sections, and the sections with more reads first.
+	// nullptr removes the profile.
+	int setProfile(const char *filename){
+		ssize_t size = 0;
+		unsigned int h, mask;
+		const char *section = nullptr;
+		bool skipSect = false;
+		char *buf;
+		int count = 1, i, k;
+
+		free(_profileBuf);
+		free(_profile);
+		free(_profileSlots);
+		_profileBuf = nullptr;
+		_profile = nullptr;
+		_profileSlots = nullptr;
+		_profileCount = 0;
+		errorNum = CONFREADER_OK;
+		if(filename == nullptr) return CONFREADER_OK;
+
+		if((buf = _readFile(filename, &size)) == nullptr){
+			return errorNum == CONFREADER_OK ? CONFREADER_OK : CONFREADER_ERROR;
+		}
+		buf[size] = 0;
+		for(i=0; i<size; i++){
+			if(buf[i] == 0x0A) count++;
+		}
+		for(mask=15; mask < (unsigned int)count * 2; mask=mask*2+1);
+		_profile = (ProfileEntry *)malloc(count * sizeof(ProfileEntry));
+		_profileSlots = (int *)malloc((mask + 1) * sizeof(int));
+		if(_profile == nullptr || _profileSlots == nullptr){
+			free(buf);
+			free(_profile);
+			free(_profileSlots);
+			_profile = nullptr;
+			_profileSlots = nullptr;
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		memset(_profileSlots, 0xFF, (mask + 1) * sizeof(int));
+		_profileBuf = buf;
+		_profileMask = mask;
+
+		// The lines are "[section]" and "key = reads".
+		for(i=0; i<size; i++){
+			for(; buf[i] == ' ' || buf[i] == 0x09; i++);
+			if(buf[i] == '['){
+				section = &buf[++i];
+				for(; i<size && buf[i] != ']' && buf[i] != 0x0A; i++);
+				// The entries after a header without the closing bracket are skipped until the next header.
+				skipSect = buf[i] != ']';
+				if(!skipSect) buf[i++] = 0;
+			}else
+			if(!skipSect && buf[i] != 0x0A && buf[i] != 0x0D && buf[i] != '#' && buf[i] != ';' && buf[i] != 0){
+				_profile[_profileCount].section = section;
+				_profile[_profileCount].key = &buf[i];
+				for(; buf[i] != '=' && buf[i] != ' ' && buf[i] != 0x09 && buf[i] != 0x0A && buf[i] != 0; i++);
+				k = i;
+				for(; buf[i] == '=' || buf[i] == ' ' || buf[i] == 0x09; i++);
+				_profile[_profileCount].hits = atoi(&buf[i]);
+				buf[k] = 0;
+				if(k > _profile[_profileCount].key - buf){
+					for(h=_hashKey(_profile[_profileCount].key, _hashKey(section ? section : "")); _profileSlots[h & mask] >= 0; h++);
+					_profileSlots[h & mask] = _profileCount++;
+				}
+			}
+			for(; i<size && buf[i] != 0x0A && buf[i] != 0; i++);
+		}
+		return CONFREADER_OK;
+	}
+
+	// Writes the reads of the parameters counted with CONFREADER_OPT_RECORD_ACCESS to the profile file, in the format
+	// of .conf: the sections and the parameters which were read, with the number of reads as the value.
+	int saveProfile(const char *filename){
+		struct iovec iov;
+		char *buf;
+		size_t size = 0;
+		int i, j, n;
+
+		// Let's count the most the text can take first, with 11 characters for each number.
+		for(i=0; i<sectCount; i++){
+			size += (sects[i].name ? strlen(sects[i].name) : 0) + 4;
+			for(j=0; j<sects[i].size; j++){
+				size += strlen(sects[i].params[j].key) + 3 + 11 + 1;
+			}
+		}
+		if((buf = (char *)malloc(size + 1)) == nullptr){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+
+		// The reads of the copies on the NUMA nodes are counted on the copies.
+		for(n=0; n<_replicaCount; n++){
+			if(_replicas[n].sects == nullptr) continue;
+			for(i=0; i<sectCount; i++){
+				for(j=0; j<sects[i].size; j++){
+					sects[i].params[j].hits += _replicas[n].sects[i].params[j].hits;
+					_replicas[n].sects[i].params[j].hits = 0;
+				}
+			}
+		}
+
+		size = 0;
+		for(i=0; i<sectCount; i++){
+			for(j=0; j<sects[i].size && *_hitsOf(&sects[i].params[j]) == 0; j++);
+			if(j == sects[i].size) continue;		// Nothing was read in the section.
+			if(i > 0) size += sprintf(&buf[size], "%s[%s]\n", size > 0 ? "\n" : "", sects[i].name);
+			for(; j<sects[i].size; j++){
+				if(*_hitsOf(&sects[i].params[j]) > 0) size += sprintf(&buf[size], "%s = %d\n", sects[i].params[j].key, *_hitsOf(&sects[i].params[j]));
+			}
+		}
+
+		iov.iov_base = buf;
+		iov.iov_len = size;
+		i = _writeAtomic(filename, &iov, 1);
+		free(buf);
+		return i;
+	}
+
+private:
+	int _parseFile(const char *filename){
+		int i, j, k, part;
+		bool skipSect;
+		int lineIdx, sectIdx, paramIdx;
+		int lineNum, colNum;
+		char *tag;
+		size_t tagLen;
+		ssize_t fileBufSize;
+		const Alias *alias;
+		
+		errorLineNum = 0;
+		errorColNum = 0;
+		
+		if(_fileBuf || sects){
+			errorNum = CONFREADER_EBUSY;
+			return CONFREADER_ERROR;
+		}
+		
+		// Open file and read text content.
+		_fileSize = 0;
+		if((_fileBuf = _readFile(filename, &fileBufSize)) == nullptr){
+			return errorNum == CONFREADER_OK ? CONFREADER_OK : CONFREADER_ERROR;
+		}
+		_fileSize = fileBufSize;
+		_fingerprint = _fileHash = _hash64(_fileBuf, fileBufSize, 0);
+		CONFREADER_PROBE(parse__read, filename, _fileSize);
+		
+		// Let's put 0x0A in the last byte, since the last line can be without a line feed character.
+		_fileBuf[fileBufSize] = 0x0A;
+		fileBufSize++;
+
+		// The byte order mark of UTF-8 is skipped as the whitespace characters.
+		_bomSize = 0;
+		if(fileBufSize >= 4 && (unsigned char)_fileBuf[0] == 0xEF && (unsigned char)_fileBuf[1] == 0xBB && (unsigned char)_fileBuf[2] == 0xBF){
+			memset(_fileBuf, ' ', 3);
+			_bomSize = 3;
+		}
+
+		if(options & CONFREADER_OPT_CHECK_UTF8){
+			// The lines are not known yet, let's count them up to each wrong byte.
+			lineNum = 1;
+			colNum = 1;
+			j = _bomSize;
+			for(k=0; k<fileBufSize && (i = _checkUtf8(&_fileBuf[k], fileBufSize - k)) >= 0; k=i+1){
+				for(i+=k; j<i; j++){
+					if(_fileBuf[j] == 0x0A){
+						lineNum++;
+						colNum = 1;
+					}else
+					if((_fileBuf[j] & 0xC0) != 0x80){
+						colNum++;
+					}
+				}
+				if(_error(lineNum, colNum, CONFREADER_DIAG_UTF8) != CONFREADER_OK) return CONFREADER_ERROR;
+			}
+		}
+		
+		// Let's count how many lines are in the file.
+		_lineCount = 0;
+		for(i=0; i<fileBufSize; i++){
+			if(_fileBuf[i] == 0x0A) _lineCount++;
+		}
+
+		// Let's allocate memory for the array of pointers to strings.
+		_lines = (int *)malloc(_lineCount * sizeof(int));
+		_lineEnds = (int *)malloc(_lineCount * sizeof(int));
+		if(_lines == nullptr || _lineEnds == nullptr){
+			clear();
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+
+		// Let's count how many sections and how many parameters are in the file.
+		_paramCount = 0;
+		sectCount = 1;			// Section with index 0 for parameters without section.
+		lineIdx = 0;
+		for(i=0; i<fileBufSize; i++){
+			// Skip the whitespace characters at the beginning of the string.
+			for(; i<fileBufSize; i++){
+				if(_fileBuf[i] != ' ' && _fileBuf[i] != 0x09) break;
+			}
+			// Remember the index of the beginning of the string.
+			_lines[lineIdx++] = i;
+
+			// Check the beginning of the section.
+			if(_fileBuf[i] == '['){
+				sectCount++;
+			}else
+			// Check the beginning of the comment or parameter.
+			if(_fileBuf[i] != '#' && _fileBuf[i] != ';' && _fileBuf[i] != 0x0A && _fileBuf[i] != 0x0D){
+				_paramCount++;
+			}
+
+			for(; i<fileBufSize; i++){
+				if(_fileBuf[i] == 0x0D){
+					_fileBuf[i++] = 0;
+				
+					if(_fileBuf[i] != 0x0A){	// After 0x0D, 0x0A must necessarily follow.
+						if(_syntaxError(lineIdx - 1, i - 1, CONFREADER_DIAG_CR) != CONFREADER_OK) return CONFREADER_ERROR;
+						i--;		// The line goes on, the carriage return ends the value.
+						continue;
+					}
+					_fileBuf[i] = 0;
+					_lineEnds[lineIdx - 1] = i;
+					break;
+				//newLine = true;
+				}else
+				if(_fileBuf[i] == 0x0A){
+					_fileBuf[i] = 0;
+					_lineEnds[lineIdx - 1] = i;
+					break;
+				}
+			}
+		}
+
+		CONFREADER_PROBE(parse__counted, filename, _lineCount, sectCount, _paramCount);
+
+		// Allocate memory for an array of pointers to lines with parameters.
+		_params = (Param *)malloc(_paramCount * sizeof(Param));
+		if(_params == nullptr){
+			clear();
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+
+		// Allocate memory for an array of pointers to sections.
+		sects = (Section *)malloc(sectCount * sizeof(Section));
+		if(sects == nullptr){
+			clear();
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+
+		// Link all sections and parameters.
+		sectIdx = 0;
+		sects[sectIdx].name = nullptr;
+		sects[sectIdx].size = 0;
+		sects[sectIdx].params = nullptr;
+		sects[sectIdx].lineNum = 0;
+		sects[sectIdx].hits = 0;
+		
+		paramIdx = 0;
+		skipSect = false;
+		for(lineIdx=0; lineIdx<_lineCount; lineIdx++){
+			i = _lines[lineIdx];
+
+			if(_fileBuf[i] == '['){			// Found a new section.
+				sectIdx++;
+				sects[sectIdx].name = &_fileBuf[++i];
+				sects[sectIdx].size = 0;
+				sects[sectIdx].params = nullptr;
+				sects[sectIdx].lineNum = lineIdx + 1;
+				sects[sectIdx].hits = 0;
+				// Let's find the end of the section name.
+				for(; _fileBuf[i] != ']' && _fileBuf[i] != 0; i++);
+				if(_fileBuf[i] == 0){		// Couldn't find the closing parenthesis.
+					if(_syntaxError(lineIdx, i, CONFREADER_DIAG_SECTION) != CONFREADER_OK) return CONFREADER_ERROR;
+					// The section is dropped, and its parameters are skipped up to the next section.
+					sectIdx--;
+					skipSect = true;
+					continue;
+				}
+				_fileBuf[i++] = 0;
+				skipSect = false;
+				CONFREADER_PROBE(section, sects[sectIdx].name, sects[sectIdx].lineNum);
+				
+				// If there are whitespace characters in the line from the current position, we skip these characters.
 				for(; i<fileBufSize; i++){
 					if(_fileBuf[i] != ' ' && _fileBuf[i] != 0x09) break;
 				}
-				
-				// If there is something at the end of the line but it's not a comment, it's an error.
-				if(_fileBuf[i] != 0 && _fileBuf[i] != '#' && _fileBuf[i] != ';'){
-					clear();
-					errorLineNum = lineIdx + 1;
-					errorNum = CONFREADER_EPARSINGFILE;
+				
+				// If there is something at the end of the line but it's not a comment, it's an error.
+				if(_fileBuf[i] != 0 && _fileBuf[i] != '#' && _fileBuf[i] != ';'){
+					if(_syntaxError(lineIdx, i, CONFREADER_DIAG_JUNK) != CONFREADER_OK) return CONFREADER_ERROR;
+				}
+			}else
+			
+			if(skipSect){
+				continue;
+			}else
+
+			if(_fileBuf[i] != '#' && _fileBuf[i] != ';' && _fileBuf[i] != 0){	// Found a line with a parameter.
+				_params[paramIdx].key = &_fileBuf[i];
+				_params[paramIdx].flags = 0;
+				_params[paramIdx].lineNum = lineIdx + 1;
+				_params[paramIdx].hits = 0;
+				memset(&_params[paramIdx].cache, 0, sizeof(Cache));
+				
+				// If the current section is empty, the detected line will be the first line.
+				if(sects[sectIdx].params == nullptr){
+					sects[sectIdx].params = &_params[paramIdx];
+				}
+				
+				// Let's find the end of the parameter name.
+				for(; _fileBuf[i] != 0; i++){
+					if(_fileBuf[i] == '=' || _fileBuf[i] == ' ' || _fileBuf[i] == 0x09) break;
+				}
+				if(_fileBuf[i] == 0){		// Unexpected end of line after the parameter name.
+					if(_syntaxError(lineIdx, i, CONFREADER_DIAG_NOVALUE) != CONFREADER_OK) return CONFREADER_ERROR;
+					continue;
+				}
+				_fileBuf[i++] = 0;
+
+				// Let's skip the whitespace characters and get the beginning of the parameter value.
+				for(; i<fileBufSize; i++){
+					if(_fileBuf[i] != '=' && _fileBuf[i] != ' ' && _fileBuf[i] != 0x09) break;
+				}
+				if(_fileBuf[i] == 0 || _fileBuf[i] == '#' || _fileBuf[i] == ';'){
+					// There is no value for the parameter.
+					if(_syntaxError(lineIdx, i, CONFREADER_DIAG_NOVALUE) != CONFREADER_OK) return CONFREADER_ERROR;
+					continue;
+				}
+
+				_params[paramIdx].valueStart = i;
+				if(_fileBuf[i] == '"'){
+					// The value in double quotes ends at the closing quote. Only the span is recorded here,
+					// the escape sequences are decoded on the first access to the value.
+					_params[paramIdx].value = &_fileBuf[++i];
+					for(; _fileBuf[i] != '"' && _fileBuf[i] != 0; i++){
+						if(_fileBuf[i] == '\\' && _fileBuf[i + 1] != 0){
+							_params[paramIdx].flags |= CONFREADER_PARAM_ESCAPED;
+							i++;
+						}
+					}
+					if(_fileBuf[i] == 0){		// There is no closing quote.
+						if(_syntaxError(lineIdx, i, CONFREADER_DIAG_QUOTE) != CONFREADER_OK) return CONFREADER_ERROR;
+						continue;
+					}
+					_fileBuf[i++] = 0;
+					_params[paramIdx].valueEnd = i;
+
+					// After the closing quote there can be only a comment.
+					for(; _fileBuf[i] == ' ' || _fileBuf[i] == 0x09; i++);
+					if(_fileBuf[i] != 0 && _fileBuf[i] != '#' && _fileBuf[i] != ';'){
+						if(_syntaxError(lineIdx, i, CONFREADER_DIAG_JUNK) != CONFREADER_OK) return CONFREADER_ERROR;
+						continue;
+					}
+				}else{
+					_params[paramIdx].value = &_fileBuf[i];
+					if((i = _endValue(i)) < 0){
+						// Error. The comment must be separated by a space character from the value.
+						if(_syntaxError(lineIdx, -1 - i, CONFREADER_DIAG_COMMENT) != CONFREADER_OK) return CONFREADER_ERROR;
+						continue;
+					}
+
+					if(_isHeredoc(_params[paramIdx].value)){
+						// The value is the block of lines up to the line with the tag: key <<EOF ... EOF
+						// The line feeds inside the block are put back, so the value is a part of the file buffer.
+						tag = _params[paramIdx].value + 2;
+						tagLen = strlen(tag);
+						for(k=lineIdx+1; k<_lineCount; k++){
+							j = _lines[k];
+							if(strncmp(&_fileBuf[j], tag, tagLen) != 0) continue;
+							for(j+=tagLen; _fileBuf[j] == ' ' || _fileBuf[j] == 0x09; j++);
+							if(_fileBuf[j] == 0) break;
+						}
+						if(k == _lineCount){		// There is no line with the tag.
+							if(_syntaxError(lineIdx, _params[paramIdx].value - _fileBuf, CONFREADER_DIAG_HEREDOC) != CONFREADER_OK) return CONFREADER_ERROR;
+							continue;
+						}
+						_params[paramIdx].valueEnd = _lines[k] + tagLen;
+						_params[paramIdx].value = &_fileBuf[_lineEnds[lineIdx] + (k > lineIdx + 1 ? 1 : 0)];
+						for(j=lineIdx+1; j<k-1; j++){
+							// If the 0 before the line feed is inside the line, it was a carriage return.
+							if(_lineEnds[j] - 1 > _lineEnds[j - 1] && _fileBuf[_lineEnds[j] - 1] == 0){
+								_fileBuf[_lineEnds[j] - 1] = 0x0D;
+							}
+							_fileBuf[_lineEnds[j]] = 0x0A;
+						}
+						lineIdx = k;
+					}else{
+						// A backslash after a space at the end of an unquoted value continues it on the next line, unless
+						// the line is empty, a comment or a section header. Each next part is moved over the backslash, so the joined value
+						// stays in the file buffer. k is the end of the value joined so far, part is the start of its last part.
+						k = i;
+						part = _params[paramIdx].value - _fileBuf;
+						while(k - part >= 2 && _fileBuf[k - 1] == '\\' && (_fileBuf[k - 2] == ' ' || _fileBuf[k - 2] == 0x09) && lineIdx + 1 < _lineCount){
+							j = _lines[lineIdx + 1];
+							if(_fileBuf[j] == 0 || _fileBuf[j] == '#' || _fileBuf[j] == ';' || _fileBuf[j] == '[') break;
+							lineIdx++;
+							if((i = _endValue(j)) < 0) break;
+							part = k - 1;
+							memmove(&_fileBuf[part], &_fileBuf[j], i - j);
+							k = part + (i - j);
+							_fileBuf[k] = 0;
+						}
+						if(i < 0){
+							if(_syntaxError(lineIdx, -1 - i, CONFREADER_DIAG_COMMENT) != CONFREADER_OK) return CONFREADER_ERROR;
+							continue;
+						}
+						_params[paramIdx].valueEnd = i;
+					}
+				}
+				
+				sects[sectIdx].size++;
+				paramIdx++;
+			}
+		}
+		// Lines of the heredoc blocks were counted as sections and parameters too.
+		sectCount = sectIdx + 1;
+		_hashSections();
+		CONFREADER_PROBE(parse__linked, filename, sectCount, _paramCount);
+
+		// Let's give the new names to the parameters with the old names, so they are found by both.
+		if(_aliasCount > 0){
+			for(i=0; i<sectCount; i++){
+				for(j=0; j<sects[i].size; j++){
+					if((alias = _findAlias(sects[i].params[j].key, sects[i].name)) != nullptr){
+						sects[i].params[j].key = (char *)alias->key;
+						deprecatedHits++;
+					}
+				}
+			}
+		}
+		if(_profileCount > 0) _orderByProfile();
+		_buildBlooms();
+
+		free(_lines);
+		_lines = nullptr;
+		free(_lineEnds);
+		_lineEnds = nullptr;
+
+		// The lines with errors were skipped, the rest of the file can be used.
+		if(diagCount > 0){
+			qsort(diags, diagCount, sizeof(Diagnostic), _compareDiags);
+			errorLineNum = diags[0].lineNum;
+			errorColNum = diags[0].colNum;
+			errorNum = diags[0].kind == CONFREADER_DIAG_UTF8 ? CONFREADER_EENCODING : CONFREADER_EPARSINGFILE;
+			return CONFREADER_ERROR;
+		}
+		errorNum = CONFREADER_OK;
+		return CONFREADER_OK;
+	}
+
+public:
+	int parseFile(const char *filename){
+		int res;
+
+		CONFREADER_PROBE(parse__start, filename);
+		res = _parseFile(filename);
+		_changed();
+		CONFREADER_PROBE(parse__end, filename, errorNum, sectCount, _paramCount);
+		return res;
+	}
+	
+	char * find(Name key, Name section = nullptr){
+		Param *p;
+
+		if((p = _findParam(key, section)) != nullptr){
+			return p->value;
+		}
+		return nullptr;
+	}
+	
+	// The hash of the file read by parseFile(), 0 if there is no file. The same file gives the same hash,
+	// so a program can skip reloading a file which is not changed.
+	unsigned long long fingerprint(){
+		return _fingerprint;
+	}
+
+	// The hash of the section in the file, nullptr for the parameters without section. The overrides
+	// don't change it. If there is no such section, errorNum = CONFREADER_ENOSECT and 0 is returned.
+	unsigned long long sectionFingerprint(Name section = nullptr){
+		int i;
+
+		errorNum = CONFREADER_OK;
+		if(section.str == nullptr) return sectCount > 0 ? sects[0].hash : 0;
+		for(i=1; i<sectCount; i++){
+			if(_equalName(sects[i].name, section)) return sects[i].hash;
+		}
+		errorNum = CONFREADER_ENOSECT;
+		return 0;
+	}
+
+	bool hasSection(Name section){
+		int i;
+
+		for(i=1; i<sectCount; i++){
+			if(_equalName(sects[i].name, section)){
+				return true;
+			}
+		}
+		errorNum = CONFREADER_ENOSECT;
+		return false;
+	}
+	
+	bool has(Name key, Name section = nullptr){
+		if(find(key, section) != nullptr){
+			return true;
+		}
+		return false;
+	}
+
+	char getChar(Name key, Name section = nullptr, char defaultValue = 0){
+		char *val;
+		
+		if((val = find(key, section)) != nullptr){
+			return val[0];
+		}
+		return defaultValue;
+	}
+	
+	char * getString(Name key, Name section = nullptr, const char *defaultValue = nullptr){
+		char *val;
+		
+		if((val = find(key, section)) != nullptr){
+			return val;
+		}
+		return (char *)defaultValue;
+	}
+	
+	int getInt(Name key, Name section = nullptr, int defaultValue = 0){
+		char *val;
+		
+		if((val = find(key, section)) != nullptr){
+			if(!_isInt(val)){
+				errorNum = CONFREADER_EINVVAL;
+				return defaultValue;
+			}
+
+			return strtol(val, NULL, 10);
+		}
+		return defaultValue;
+	}
+	
+	double getDouble(Name key, Name section = nullptr, double defaultValue = 0.0){
+		char *val;
+		
+		if((val = find(key, section)) != nullptr){
+			if(!_isDouble(val)){
+				errorNum = CONFREADER_EINVVAL;
+				return defaultValue;
+			}
+
+			return strtod(val, NULL);
+		}
+		return defaultValue;
+	}
+	
+	bool getBool(Name key, Name section = nullptr, bool defaultValue = false){
+		char *val;
+		bool b;
+		
+		if((val = find(key, section)) != nullptr){
+			if(_parseBool(val, &b)){
+				return b;
+			}
+			
+			errorNum = CONFREADER_EINVVAL;
+			return defaultValue;
+		}
+		return defaultValue;
+	}
+
+	// Duration in milliseconds: 250ms, 30s, 5m, 5min, 2h, 1d, 1w. A bare number means milliseconds.
+	long long getDuration(Name key, Name section = nullptr, long long defaultValue = 0){
+		return _getUnits(key, section, defaultValue, CONFREADER_CACHE_DURATION, _durationUnits());
+	}
+
+	// Size in bytes: 512, 512B, 64K, 64KiB, 64M, 64MiB, 1G, 1GiB, 1T, 1TiB are powers of 1024,
+	// 64KB, 64MB, 1GB, 1TB are powers of 1000. Case doesn't matter.
+	long long getBytes(Name key, Name section = nullptr, long long defaultValue = 0){
+		return _getUnits(key, section, defaultValue, CONFREADER_CACHE_BYTES, _byteUnits());
+	}
+
+	// Rate in events per second: 100, 100/s, 10k/s, 2M/s, 600/min, 1000/h, 50000/d.
+	// A rate per minute, hour or day is not a whole number per second, so the result is double.
+	double getRate(Name key, Name section = nullptr, double defaultValue = 0.0){
+		static const Unit units[] = {
+			{"", 1}, {"k", 1000LL}, {"m", 1000000LL}, {"g", 1000000000LL},
+			{nullptr, 0}
+		};
+		static const Unit periods[] = {
+			{"s", 1}, {"sec", 1}, {"m", 60}, {"min", 60}, {"h", 3600}, {"d", 86400},
+			{nullptr, 0}
+		};
+		Param *p;
+		const Unit *u;
+		long long n;
+		double rate;
+		int k;
+
+		if((p = _findParam(key, section)) != nullptr){
+			if(_cached(p, CONFREADER_CACHE_RATE, nullptr)){
+				return _cacheOf(p)->v.d;
+			}
+			// The value is split into the count and the period.
+			for(k=0; p->value[k] != 0 && p->value[k] != '/'; k++);
+			if(!_parseUnits(p->value, k, units, &n)){
+				errorNum = CONFREADER_EINVVAL;
+				return defaultValue;
+			}
+			rate = (double)n;		// A bare count is per second.
+			if(p->value[k] == '/'){
+				for(u=periods; u->suffix != nullptr; u++){
+					if(strcasecmp(&p->value[k + 1], u->suffix) == 0) break;
+				}
+				if(u->suffix == nullptr){
+					errorNum = CONFREADER_EINVVAL;
+					return defaultValue;
+				}
+				rate /= u->mul;
+			}
+			if(_cacheLock(p)){
+				_cacheOf(p)->v.d = rate;
+				_cacheUnlock(p, CONFREADER_CACHE_RATE, nullptr);
+			}
+			return rate;
+		}
+		return defaultValue;
+	}
+
+	// IP address: 192.168.0.60, ::1 or [::1].
+	bool getIpAddr(Name key, Name section, IpAddr *ip){
+		Param *p;
+		IpAddr *cached;
+
+		if((p = _findParam(key, section)) != nullptr){
+			if(_cached(p, CONFREADER_CACHE_IPADDR, nullptr)){
+				*ip = *(IpAddr *)_cacheOf(p)->v.p;
+				return true;
+			}
+			if(!_parseIpAddr(p->value, strlen(p->value), ip)){
+				errorNum = CONFREADER_EINVVAL;
+				return false;
+			}
+			if(_cacheLock(p)){
+				if((cached = (IpAddr *)_alloc(sizeof(IpAddr))) != nullptr){
+					*cached = *ip;
+					_cacheOf(p)->v.p = cached;
+					_cacheUnlock(p, CONFREADER_CACHE_IPADDR, nullptr);
+				}else{
+					_cacheUnlock(p, CONFREADER_CACHE_NONE, nullptr);
+				}
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// Address and port ready for bind() or connect(): 192.168.0.60:3333, [::]:8080, *:8080.
+	// If the value has no port, defaultPort is used. An explicit :0 is kept.
+	bool getEndpoint(Name key, Name section, Endpoint *ep, int defaultPort = 0){
+		Param *p;
+		Endpoint *cached;
+		bool hasPort;
+
+		if((p = _findParam(key, section)) != nullptr){
+			if(_cached(p, CONFREADER_CACHE_ENDPOINT, nullptr)){
+				cached = (Endpoint *)_cacheOf(p)->v.p;
+				*ep = *cached;
+				hasPort = *(bool *)(cached + 1);
+			}else{
+				if(!_parseEndpoint(p->value, ep, &hasPort)){
+					errorNum = CONFREADER_EINVVAL;
+					return false;
+				}
+				if(_cacheLock(p)){
+					// Whether the value has a port is kept in the byte after the address.
+					if((cached = (Endpoint *)_alloc(sizeof(Endpoint) + 1)) != nullptr){
+						*cached = *ep;
+						*(bool *)(cached + 1) = hasPort;
+						_cacheOf(p)->v.p = cached;
+						_cacheUnlock(p, CONFREADER_CACHE_ENDPOINT, nullptr);
+					}else{
+						_cacheUnlock(p, CONFREADER_CACHE_NONE, nullptr);
+					}
+				}
+			}
+			// The port is at the same place in sockaddr_in and sockaddr_in6.
+			if(!hasPort){
+				ep->addr.sin.sin_port = htons(defaultPort);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// List of prefixes separated by commas or spaces: 10.0.0.0/8, 192.168.0.0/16, ::1.
+	// The list is compiled once, check addresses against it with cidrMatch.
+	const CidrList * getCidrList(Name key, Name section = nullptr){
+		Param *p;
+		CidrList *list;
+		Cache *e;
+		int nodeCount, claim;
+
+		if((p = _findParam(key, section)) != nullptr){
+			if(_cached(p, CONFREADER_CACHE_CIDRLIST, nullptr)){
+				return (CidrList *)_cacheOf(p)->v.p;
+			}
+			if((e = _chained(p, CONFREADER_CACHE_CIDRLIST)) != nullptr){
+				return (CidrList *)e->v.p;
+			}
+			// Nothing is allocated for an invalid list, and the list is built only by the reader that fills the cache.
+			if((nodeCount = _countCidrNodes(p->value)) < 0){
+				errorNum = CONFREADER_EINVVAL;
+				return nullptr;
+			}
+			if((claim = _cacheClaim(p, CONFREADER_CACHE_CIDRLIST, nullptr)) > 0){
+				return (CidrList *)_cacheOf(p)->v.p;
+			}
+			if(claim < 0){
+				// The value is cached as another type, the list goes to an entry chained to the cache.
+				if((e = _chainClaim(p, CONFREADER_CACHE_CIDRLIST)) == nullptr &&
+				   (e = _chainAdd(p, CONFREADER_CACHE_CIDRLIST, _parseCidrList(p->value, nodeCount))) == nullptr){
+					errorNum = CONFREADER_ENOMEM;
+					return nullptr;
+				}
+				return (CidrList *)e->v.p;
+			}
+			if((list = _parseCidrList(p->value, nodeCount)) == nullptr){
+				_cacheUnlock(p, CONFREADER_CACHE_NONE, nullptr);
+				errorNum = CONFREADER_ENOMEM;
+				return nullptr;
+			}
+			_cacheOf(p)->v.p = list;
+			_cacheUnlock(p, CONFREADER_CACHE_CIDRLIST, nullptr);
+			return list;
+		}
+		return nullptr;
+	}
+
+	static bool cidrMatch(const CidrList *list, const IpAddr *ip){
+		const unsigned char *addr;
+		int i, bits, node;
+
+		addr = ip->addr;
+		if(ip->family == AF_INET){
+			node = list->root4;
+			bits = 32;
+		}else
+		// An IPv4-mapped IPv6 address ::ffff:a.b.c.d is checked against the IPv4 prefixes.
+		if(memcmp(addr, "\0\0\0\0\0\0\0\0\0\0\xFF\xFF", 12) == 0){
+			addr += 12;
+			node = list->root4;
+			bits = 32;
+		}else{
+			node = list->root6;
+			bits = 128;
+		}
+
+		for(i=0; ; i++){
+			if(list->nodes[node].match) return true;
+			if(i == bits) return false;
+			node = list->nodes[node].child[(addr[i >> 3] >> (7 - (i & 7))) & 1];
+			if(node == 0) return false;
+		}
+	}
+
+	static bool cidrMatch(const CidrList *list, const struct sockaddr *sa){
+		IpAddr ip;
+
+		if(sa->sa_family == AF_INET){
+			ip.family = AF_INET;
+			memcpy(ip.addr, &((const struct sockaddr_in *)sa)->sin_addr, 4);
+		}else
+		if(sa->sa_family == AF_INET6){
+			ip.family = AF_INET6;
+			memcpy(ip.addr, &((const struct sockaddr_in6 *)sa)->sin6_addr, 16);
+		}else{
+			return false;
+		}
+		return cidrMatch(list, &ip);
+	}
+
+	// List of integers separated by commas or spaces: weights = 10, 20, -30.
+	// Up to maxCount values are written to values. Returns the number of elements in the list, or -1 if
+	// the parameter is not found or the list is invalid.
+	int getIntArray(Name key, Name section, long long *values, int maxCount){
+		Param *p;
+		int count;
+
+		if((p = _findParam(key, section)) != nullptr){
+			if((count = _decodeInts(p->value, values, maxCount)) < 0){
+				errorNum = CONFREADER_EINVVAL;
+			}
+			return count;
+		}
+		return -1;
+	}
+
+	// Decodes the n elements of a valid list into the arena. The number of elements is kept in the 16 bytes before the array.
+	long long * _newIntArray(const char *value, int n){
+		long long *values;
+
+		if((values = (long long *)_alloc(16 + n * sizeof(long long))) == nullptr) return nullptr;
+		*(int *)values = n;
+		values += 2;
+		_decodeInts(value, values, n);
+		return values;
+	}
+
+	// The same, but the array is decoded once into the memory of the object. The number of elements is put to count.
+	const long long * getIntArray(Name key, Name section, int *count){
+		Param *p;
+		long long *values;
+		Cache *e;
+		int n, claim;
+
+		*count = 0;
+		if((p = _findParam(key, section)) != nullptr){
+			if(_cached(p, CONFREADER_CACHE_INTARRAY, nullptr)){
+				values = (long long *)_cacheOf(p)->v.p;
+			}else
+			if((e = _chained(p, CONFREADER_CACHE_INTARRAY)) != nullptr){
+				values = (long long *)e->v.p;
+			}else{
+				// Nothing is allocated for an invalid list, and the array is decoded only by the reader that fills the cache.
+				if((n = _decodeInts(p->value, nullptr, 0)) < 0){
+					errorNum = CONFREADER_EINVVAL;
+					return nullptr;
+				}
+				if((claim = _cacheClaim(p, CONFREADER_CACHE_INTARRAY, nullptr)) == 0){
+					if((values = _newIntArray(p->value, n)) == nullptr){
+						_cacheUnlock(p, CONFREADER_CACHE_NONE, nullptr);
+						errorNum = CONFREADER_ENOMEM;
+						return nullptr;
+					}
+					_cacheOf(p)->v.p = values;
+					_cacheUnlock(p, CONFREADER_CACHE_INTARRAY, nullptr);
+				}else
+				if(claim > 0){
+					values = (long long *)_cacheOf(p)->v.p;
+				}else{
+					// The value is cached as another type, the array goes to an entry chained to the cache.
+					if((e = _chainClaim(p, CONFREADER_CACHE_INTARRAY)) == nullptr &&
+					   (e = _chainAdd(p, CONFREADER_CACHE_INTARRAY, _newIntArray(p->value, n))) == nullptr){
+						errorNum = CONFREADER_ENOMEM;
+						return nullptr;
+					}
+					values = (long long *)e->v.p;
+				}
+			}
+			*count = *(int *)(values - 2);
+			return values;
+		}
+		return nullptr;
+	}
+
+	// List of numbers separated by commas or spaces: weights = 0.25, 0.5, 1e-3.
+	int getDoubleArray(Name key, Name section, double *values, int maxCount){
+		Param *p;
+		int count;
+
+		if((p = _findParam(key, section)) != nullptr){
+			if((count = _decodeDoubles(p->value, values, maxCount)) < 0){
+				errorNum = CONFREADER_EINVVAL;
+			}
+			return count;
+		}
+		return -1;
+	}
+
+	double * _newDoubleArray(const char *value, int n){
+		double *values;
+
+		if((values = (double *)_alloc(16 + n * sizeof(double))) == nullptr) return nullptr;
+		*(int *)values = n;
+		values += 2;
+		_decodeDoubles(value, values, n);
+		return values;
+	}
+
+	const double * getDoubleArray(Name key, Name section, int *count){
+		Param *p;
+		double *values;
+		Cache *e;
+		int n, claim;
+
+		*count = 0;
+		if((p = _findParam(key, section)) != nullptr){
+			if(_cached(p, CONFREADER_CACHE_DOUBLEARRAY, nullptr)){
+				values = (double *)_cacheOf(p)->v.p;
+			}else
+			if((e = _chained(p, CONFREADER_CACHE_DOUBLEARRAY)) != nullptr){
+				values = (double *)e->v.p;
+			}else{
+				// Nothing is allocated for an invalid list, and the array is decoded only by the reader that fills the cache.
+				if((n = _decodeDoubles(p->value, nullptr, 0)) < 0){
+					errorNum = CONFREADER_EINVVAL;
+					return nullptr;
+				}
+				if((claim = _cacheClaim(p, CONFREADER_CACHE_DOUBLEARRAY, nullptr)) == 0){
+					if((values = _newDoubleArray(p->value, n)) == nullptr){
+						_cacheUnlock(p, CONFREADER_CACHE_NONE, nullptr);
+						errorNum = CONFREADER_ENOMEM;
+						return nullptr;
+					}
+					_cacheOf(p)->v.p = values;
+					_cacheUnlock(p, CONFREADER_CACHE_DOUBLEARRAY, nullptr);
+				}else
+				if(claim > 0){
+					values = (double *)_cacheOf(p)->v.p;
+				}else{
+					if((e = _chainClaim(p, CONFREADER_CACHE_DOUBLEARRAY)) == nullptr &&
+					   (e = _chainAdd(p, CONFREADER_CACHE_DOUBLEARRAY, _newDoubleArray(p->value, n))) == nullptr){
+						errorNum = CONFREADER_ENOMEM;
+						return nullptr;
+					}
+					values = (double *)e->v.p;
+				}
+			}
+			*count = *(int *)(values - 2);
+			return values;
+		}
+		return nullptr;
+	}
+
+	// Checks the parsed file against the schema of count entries in one pass over the parameters.
+	// The errors are added to diags. Returns CONFREADER_OK if the file matches the schema.
+	// A schema with the same key twice in a section is rejected with CONFREADER_EINVVAL, without diagnostics.
+	int validate(const SchemaEntry *schema, int count){
+		int *keySlots, *sectSlots;
+		Param *p;
+		char *seen;
+		int size, mask, i, j, k, s, first;
+		unsigned int h;
+		const char *name;
+		bool known, open;
+
+		// Let's put the entries into two hash tables: by the section and the key, and by the section only.
+		// The section table points to the entry with key nullptr if the section has it.
+		for(size=16; size < count * 2; size*=2);
+		mask = size - 1;
+		keySlots = (int *)malloc(size * 2 * sizeof(int) + count);
+		if(keySlots == nullptr){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		sectSlots = keySlots + size;
+		seen = (char *)(sectSlots + size);
+		memset(keySlots, 0xFF, size * 2 * sizeof(int));
+		memset(seen, 0, count);
+
+		for(i=0; i<count; i++){
+			for(h=_hashKey(schema[i].section ? schema[i].section : ""); sectSlots[h & mask] >= 0; h++){
+				if(_sameName(schema[sectSlots[h & mask]].section, schema[i].section)) break;
+			}
+			if(sectSlots[h & mask] < 0 || schema[i].key == nullptr) sectSlots[h & mask] = i;
+			if(schema[i].key == nullptr) continue;
+
+			for(h=_hashKey(schema[i].key, _hashKey(schema[i].section ? schema[i].section : "")); (k = keySlots[h & mask]) >= 0; h++){
+				if(strcasecmp(schema[k].key, schema[i].key) == 0 && _sameName(schema[k].section, schema[i].section)){
+					free(keySlots);
+					errorNum = CONFREADER_EINVVAL;
+					return CONFREADER_ERROR;
+				}
+			}
+			keySlots[h & mask] = i;
+		}
+
+		first = diagCount;
+		for(i=0; i<sectCount; i++){
+			for(h=_hashKey(sects[i].name ? sects[i].name : ""); (s = sectSlots[h & mask]) >= 0; h++){
+				if(_sameName(schema[s].section, sects[i].name)) break;
+			}
+			known = s >= 0;
+			open = known && schema[s].key == nullptr;
+			if(!known && i > 0 && !_addDiag(sects[i].lineNum, 0, CONFREADER_DIAG_UNKNOWN_SECTION, sects[i].name)) break;
+
+			for(j=0; j<sects[i].size; j++){
+				p = &sects[i].params[j];
+				for(h=_hashKey(p->key, _hashKey(sects[i].name ? sects[i].name : "")); (k = keySlots[h & mask]) >= 0; h++){
+					if(strcasecmp(schema[k].key, p->key) == 0 && _sameName(schema[k].section, sects[i].name)) break;
+				}
+				if(k < 0){
+					// The parameters of an unknown section are not reported one by one.
+					if(!open && (known || i == 0) && !_addDiag(p->lineNum, 0, CONFREADER_DIAG_UNKNOWN_KEY, p->key)) break;
+					continue;
+				}
+				seen[k] = 1;
+				if(!_decode(p) || !_checkValue(p, &schema[k])) break;
+			}
+			if(j < sects[i].size) break;
+		}
+
+		for(k=0; k<count && i == sectCount; k++){
+			if(seen[k] || schema[k].key == nullptr || !(schema[k].flags & CONFREADER_SCHEMA_REQUIRED)) continue;
+			// The line of the section is the place where the parameter is missed.
+			name = schema[k].section;
+			for(s=1; s<sectCount && name != nullptr && strcasecmp(name, sects[s].name) != 0; s++);
+			if(!_addDiag(name == nullptr || s == sectCount ? 0 : sects[s].lineNum, 0, CONFREADER_DIAG_MISSING_KEY, schema[k].key)) i = -1;
+		}
+		free(keySlots);
+
+		if(i != sectCount){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		if(diagCount > first){
+			qsort(diags, diagCount, sizeof(Diagnostic), _compareDiags);
+			errorNum = CONFREADER_EINVVAL;
+			return CONFREADER_ERROR;
+		}
+		errorNum = CONFREADER_OK;
+		return CONFREADER_OK;
+	}
+
+	// Writes all the sections and parameters to the file, without the comments. The file is replaced atomically.
+	int writeFile(const char *filename){
+		struct iovec iov;
+		char *buf;
+		size_t size = 0, len;
+		int i, j;
+
+		// Let's count the size of the text first, so that it is built in one buffer.
+		for(i=0; i<sectCount; i++){
+			if(i > 0) size += (size > 0 ? 1 : 0) + strlen(sects[i].name) + 3;
+			for(j=0; j<sects[i].size; j++){
+				if(!_decode(&sects[i].params[j])){
+					errorNum = CONFREADER_ENOMEM;
+					return CONFREADER_ERROR;
+				}
+				size += strlen(sects[i].params[j].key) + 3 + _formatValue(sects[i].params[j].value, nullptr) + 1;
+			}
+		}
+
+		buf = (char *)malloc(size + 1);
+		if(buf == nullptr){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		size = 0;
+		for(i=0; i<sectCount; i++){
+			if(i > 0){
+				if(size > 0) buf[size++] = 0x0A;
+				buf[size++] = '[';
+				len = strlen(sects[i].name);
+				memcpy(&buf[size], sects[i].name, len);
+				size += len;
+				buf[size++] = ']';
+				buf[size++] = 0x0A;
+			}
+			for(j=0; j<sects[i].size; j++){
+				len = strlen(sects[i].params[j].key);
+				memcpy(&buf[size], sects[i].params[j].key, len);
+				size += len;
+				memcpy(&buf[size], " = ", 3);
+				size += 3;
+				size += _formatValue(sects[i].params[j].value, &buf[size]);
+				buf[size++] = 0x0A;
+			}
+		}
+
+		iov.iov_base = buf;
+		iov.iov_len = size;
+		i = _writeAtomic(filename, &iov, 1);
+		free(buf);
+		return i;
+	}
+
+	// Changes the parameters in the file this object was parsed from. Only the changed values are rewritten,
+	// the comments and the layout stay. New parameters are added after the last parameter of the section,
+	// new sections at the end of the file. The file is replaced atomically. The object is not changed,
+	// parse the file again to read the new values. If the file was changed since parsing, errorNum is CONFREADER_EBUSY.
+	// A name that can't be written to the file, or the same parameter changed twice, gives CONFREADER_EINVVAL.
+	int patchFile(const char *filename, const Change *changes, int count){
+		struct iovec *iov;
+		Edit *edits;
+		Param *p;
+		char *text, *buf, *dst;
+		ssize_t size = 0;
+		size_t bufSize = 0;
+		int i, j, k, n, pos, editCount = 0, iovCount = 0;
+		bool lineFeedAdded = false;
+
+		// The names must read back as they are, and a parameter can be changed only once.
+		for(i=0; i<count; i++){
+			if(!_isFileName(changes[i].key, false) || (changes[i].section != nullptr && !_isFileName(changes[i].section, true))){
+				errorNum = CONFREADER_EINVVAL;
+				return CONFREADER_ERROR;
+			}
+			for(j=0; j<i; j++){
+				if(strcasecmp(changes[j].key, changes[i].key) == 0 && _sameName(changes[j].section, changes[i].section)){
+					errorNum = CONFREADER_EINVVAL;
 					return CONFREADER_ERROR;
 				}
-			}else
-			
-			if(_fileBuf[i] != '#' && _fileBuf[i] != ';' && _fileBuf[i] != 0){	// Found a line with a parameter.
-				_params[paramIdx].key = &_fileBuf[i];
-				
-				// If the current section is empty, the detected line will be the first line.
-				if(sects[sectIdx].params == nullptr){
-					sects[sectIdx].params = &_params[paramIdx];
+			}
+		}
+
+		// Let's read the file again, the values are replaced in the original text. The offsets of the values
+		// are right only for the same text, so it must have the size and the hash of the parsed file.
+		text = _readFile(filename, &size);
+		if(text == nullptr && errorNum != CONFREADER_OK) return CONFREADER_ERROR;
+		if(size != _fileSize || (size > 0 && _hash64(text, size, 0) != _fileHash)){
+			free(text);
+			errorNum = CONFREADER_EBUSY;
+			return CONFREADER_ERROR;
+		}
+
+		for(i=0; i<count; i++){
+			bufSize += strlen(changes[i].key) + (changes[i].section ? strlen(changes[i].section) : 0) + 16;
+			if(changes[i].value) bufSize += _formatValue(changes[i].value, nullptr);
+		}
+		edits = (Edit *)malloc((count + 1) * sizeof(Edit));
+		iov = (struct iovec *)malloc((count * 2 + 1) * sizeof(struct iovec));
+		buf = dst = (char *)malloc(bufSize + 1);
+		if(edits == nullptr || iov == nullptr || buf == nullptr){
+			free(edits);
+			free(iov);
+			free(buf);
+			free(text);
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+
+		for(i=0; i<count; i++){
+			edits[editCount].seq = i;
+			edits[editCount].text = dst;
+
+			if((p = _lookup(changes[i].key, changes[i].section)) != nullptr && p->lineNum > 0){
+				if(changes[i].value != nullptr){
+					// Only the value is replaced, the comment after it stays.
+					edits[editCount].start = p->valueStart;
+					edits[editCount].end = p->valueEnd;
+					dst += _formatValue(changes[i].value, dst);
+				}else{
+					// The whole line of the parameter is removed.
+					for(pos=p->valueStart; pos>_bomSize && text[pos - 1] != 0x0A; pos--);
+					edits[editCount].start = pos;
+					for(pos=p->valueEnd; pos<size && text[pos++] != 0x0A; );
+					edits[editCount].end = pos;
+				}
+			}else
+			if(changes[i].value != nullptr){
+				for(k=0; k<sectCount && !_sameName(sects[k].name, changes[i].section); k++);
+				// The sections and parameters added by applyOverrides() are not in the file.
+				if(k > 0 && k < sectCount && sects[k].lineNum == 0) k = sectCount;
+				for(n=(k < sectCount ? sects[k].size : 0); n > 0 && sects[k].params[n - 1].lineNum == 0; n--);
+				if(k < sectCount && (n > 0 || k > 0)){
+					// After the line of the last parameter or the section name. The parameters can be ordered by the profile.
+					pos = k > 0 ? sects[k].name - _fileBuf : 0;
+					for(j=0; j<n; j++){
+						if(sects[k].params[j].valueEnd > pos) pos = sects[k].params[j].valueEnd;
+					}
+					for(; pos<size && text[pos++] != 0x0A; );
+				}else
+				if(changes[i].section == nullptr){
+					pos = size > 0 ? _bomSize : 0;
+				}else{
+					pos = size;
+				}
+
+				if(pos == size && size > 0 && text[size - 1] != 0x0A && !lineFeedAdded){
+					*dst++ = 0x0A;
+					lineFeedAdded = true;
+				}
+				if(k == sectCount && changes[i].section != nullptr){
+					// The first parameter of a new section adds the section.
+					for(j=0; j<i && !(changes[j].value != nullptr && _sameName(changes[j].section, changes[i].section)); j++);
+					if(j == i){
+						if(dst > edits[editCount].text || pos > 0) *dst++ = 0x0A;
+						dst += sprintf(dst, "[%s]\n", changes[i].section);
+					}
+				}
+				dst += sprintf(dst, "%s = ", changes[i].key);
+				dst += _formatValue(changes[i].value, dst);
+				*dst++ = 0x0A;
+				edits[editCount].start = edits[editCount].end = pos;
+			}else{
+				continue;		// There is nothing to remove.
+			}
+			edits[editCount].len = dst - edits[editCount].text;
+			editCount++;
+		}
+
+		// The parts of the file between the edits are written as they are.
+		qsort(edits, editCount, sizeof(Edit), _compareEdits);
+		pos = 0;
+		for(i=0; i<editCount; i++){
+			if(edits[i].start < pos){		// The same parameter is changed twice.
+				break;
+			}
+			if(edits[i].start > pos){
+				iov[iovCount].iov_base = &text[pos];
+				iov[iovCount++].iov_len = edits[i].start - pos;
+			}
+			if(edits[i].len > 0){
+				iov[iovCount].iov_base = (void *)edits[i].text;
+				iov[iovCount++].iov_len = edits[i].len;
+			}
+			pos = edits[i].end;
+		}
+		if(pos < size){
+			iov[iovCount].iov_base = &text[pos];
+			iov[iovCount++].iov_len = size - pos;
+		}
+
+		if(i < editCount){
+			errorNum = CONFREADER_EINVVAL;
+			i = CONFREADER_ERROR;
+		}else{
+			i = _writeAtomic(filename, iov, iovCount);
+		}
+		free(edits);
+		free(iov);
+		free(buf);
+		free(text);
+		return i;
+	}
+
+	// Writes all the sections and parameters as JSON to buf: the parameters without section are the members
+	// of the object, each section is an object member. All values are strings. Works like snprintf: returns
+	// the length of the text without the ending 0, so toJson(nullptr, 0) gives the size of the buffer minus one.
+	// If the text with the ending 0 doesn't fit into size bytes, nothing is written.
+	int toJson(char *buf, int size){
+		return _dumpTo(buf, size, true);
+	}
+
+	// The same as toJson(), but the text is lines of section.key=value, or key=value for the parameters
+	// without section. The values are written as in the file, in double quotes if it is needed.
+	int toFlat(char *buf, int size){
+		return _dumpTo(buf, size, false);
+	}
+
+	// Overrides the parameters with the environment variables and the command line arguments, after parseFile().
+	// The values are put into the parameters, so the lookups find the effective value at once.
+	// The variable of a parameter is the prefix, the section name, "_" and the key, in upper case and with "_"
+	// for the characters other than letters and digits: APP_DBACCESS_PORT for the key port of the section dbaccess.
+	// The arguments are --<argPrefix>section.key=value or --<argPrefix>key=value, as main() gets them, e.g.
+	// --conf.dbaccess.port=3334 with the argPrefix "conf.". They are applied after the environment and can add
+	// the parameters which are not in the file. The arguments without the prefix belong to the program and are skipped.
+	// envPrefix, argPrefix or argv can be nullptr, no arguments are applied without argPrefix.
+	// Call it before other threads read the values, and before derive().
+	int applyOverrides(const char *envPrefix, const char *argPrefix, int argc, char **argv){
+		Change *adds = nullptr;
+		const char *arg, *dot, *eq;
+		char *copy;
+		Param *p;
+		size_t prefixLen;
+		int addCount = 0, i, k;
+		bool ok = true;
+
+		// The parameters may be shared with the snapshots, they are changed only by derive(). The frozen ones are read-only.
+		if(_shared || _frozen){
+			errorNum = CONFREADER_EBUSY;
+			return CONFREADER_ERROR;
+		}
+
+		// The values are changed in the parsed file, call replicate() again after this.
+		_freeReplicas();
+
+		if(envPrefix && !_applyEnv(envPrefix)){
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+
+		if(argPrefix && argv && argc > 1){
+			adds = (Change *)malloc((argc - 1) * sizeof(Change));
+			if(adds == nullptr){
+				errorNum = CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
+			}
+		}
+		prefixLen = argPrefix ? strlen(argPrefix) : 0;
+		for(i=1; adds && i<argc; i++){
+			arg = argv[i];
+			if(strcmp(arg, "--") == 0) break;
+			if(arg[0] != '-' || arg[1] != '-' || strncmp(arg + 2, argPrefix, prefixLen) != 0 || (eq = strchr(arg + 2 + prefixLen, '=')) == nullptr) continue;
+			arg += 2 + prefixLen;
+			// The section name can have dots, the key is after the last one.
+			for(dot=eq; dot>arg && *dot != '.'; dot--);
+			if(eq == arg || (*dot == '.' && dot + 1 == eq)) continue;
+
+			// Let's copy the section, the key and the value as strings.
+			if((copy = _copyString(arg, strlen(arg))) == nullptr){
+				ok = false;
+				break;
+			}
+			copy[eq - arg] = 0;
+			adds[addCount].section = nullptr;
+			adds[addCount].key = copy;
+			adds[addCount].value = &copy[eq - arg + 1];
+			if(*dot == '.'){
+				copy[dot - arg] = 0;
+				adds[addCount].section = copy;
+				adds[addCount].key = &copy[dot - arg + 1];
+			}
+
+			if((p = _lookup(adds[addCount].key, adds[addCount].section)) != nullptr){
+				_setValue(p, (char *)adds[addCount].value);
+				continue;
+			}
+			// The same new parameter can be given again.
+			for(k=0; k<addCount && !(_sameName(adds[k].section, adds[addCount].section) && _sameName(adds[k].key, adds[addCount].key)); k++);
+			if(k < addCount){
+				adds[k].value = adds[addCount].value;
+			}else{
+				addCount++;
+			}
+		}
+
+		if(!ok || (addCount > 0 && !_addParams(adds, addCount))){
+			free(adds);
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		free(adds);
+		errorNum = CONFREADER_OK;
+		return CONFREADER_OK;
+	}
+
+	// Copies the parsed file into the memory of each NUMA node, after parseFile() and applyOverrides().
+	// Then the lookups of a thread read the copy of its node. On a machine with one node nothing is copied.
+	// The memory is bound to the node with mbind(). If the system doesn't allow it, nothing is copied, since all
+	// the copies would be written by this thread and so be in the memory of its node.
+	int replicate(){
+		unsigned char nodes[CONFREADER_MAX_NODES];
+		unsigned long mask[CONFREADER_MAX_NODES / (8 * sizeof(unsigned long))];
+		unsigned char *cpus;
+		char path[64], *buf;
+		Param *params, *p;
+		Section *rs;
+		unsigned long long *blooms, *b;
+		size_t bufSize, bloomWords = 0, memSize;
+		int nodeCount, paramCount = 0, n, i, j;
+
+		_freeReplicas();
+		errorNum = CONFREADER_OK;
+		if(_frozen){
+			errorNum = CONFREADER_EBUSY;
+			return CONFREADER_ERROR;
+		}
+		if(_fileBuf == nullptr) return CONFREADER_OK;
+
+		memset(nodes, 0, sizeof(nodes));
+		nodeCount = _readList("/sys/devices/system/node/online", nodes, CONFREADER_MAX_NODES);
+		_cpuCount = _readList("/sys/devices/system/cpu/possible", nullptr, 0);
+		if(nodeCount <= 1 || nodeCount > CONFREADER_MAX_NODES || _cpuCount <= 0){
+			_cpuCount = 0;
+			return CONFREADER_OK;		// One node or the topology is unknown.
+		}
+
+		_cpuNodes = (int *)calloc(_cpuCount, sizeof(int));
+		cpus = (unsigned char *)malloc(_cpuCount);
+		_replicas = (Replica *)calloc(nodeCount, sizeof(Replica));
+		if(_cpuNodes == nullptr || cpus == nullptr || _replicas == nullptr){
+			free(cpus);
+			_freeReplicas();
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+		_replicaCount = nodeCount;
+		for(n=0; n<nodeCount; n++){
+			if(!nodes[n]) continue;
+			memset(cpus, 0, _cpuCount);
+			sprintf(path, "/sys/devices/system/node/node%d/cpulist", n);
+			_readList(path, cpus, _cpuCount);
+			for(i=0; i<_cpuCount; i++){
+				if(cpus[i]) _cpuNodes[i] = n;
+			}
+		}
+		free(cpus);
+
+		// One block for each node: the file buffer, the parameters, the sections and the filters.
+		bufSize = (_fileSize + 1 + 15) & ~(size_t)15;
+		for(i=0; i<sectCount; i++){
+			paramCount += sects[i].size;
+			if(sects[i].bloom) bloomWords += (sects[i].bloomMask + 1) / 64;
+		}
+		memSize = bufSize + paramCount * sizeof(Param) + sectCount * sizeof(Section) + bloomWords * sizeof(unsigned long long);
+
+		for(n=0; n<nodeCount; n++){
+			if(!nodes[n]) continue;
+			_replicas[n].mem = mmap(nullptr, memSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if(_replicas[n].mem == MAP_FAILED){
+				_replicas[n].mem = nullptr;
+				_freeReplicas();
+				errorNum = CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
+			}
+			_replicas[n].memSize = memSize;
+			memset(mask, 0, sizeof(mask));
+			mask[n / (8 * sizeof(unsigned long))] = 1UL << (n % (8 * sizeof(unsigned long)));
+			// The pages are not touched yet, so they are allocated on the node when they are written below.
+			if(syscall(SYS_mbind, _replicas[n].mem, memSize, CONFREADER_MPOL_BIND, mask, CONFREADER_MAX_NODES, 0) != 0){
+				_freeReplicas();
+				return CONFREADER_OK;
+			}
+
+			buf = (char *)_replicas[n].mem;
+			params = (Param *)(buf + bufSize);
+			rs = (Section *)(params + paramCount);
+			blooms = (unsigned long long *)(rs + sectCount);
+			memcpy(buf, _fileBuf, _fileSize + 1);
+			memcpy(rs, sects, sectCount * sizeof(Section));
+
+			// The sections changed by derive() are not in the block of the parameters, so each one is copied by itself.
+			p = params;
+			b = blooms;
+			for(i=0; i<sectCount; i++){
+				rs[i].name = _rebase(rs[i].name, buf);
+				if(rs[i].params){
+					memcpy(p, sects[i].params, sects[i].size * sizeof(Param));
+					rs[i].params = p;
+					p += sects[i].size;
+				}
+				if(rs[i].bloom){
+					memcpy(b, sects[i].bloom, (sects[i].bloomMask + 1) / 8);
+					rs[i].bloom = b;
+					b += (sects[i].bloomMask + 1) / 64;
 				}
-				
-				// Let's find the end of the parameter name.
-				for(; i<fileBufSize; i++){
-					if(_fileBuf[i] == 0){		// Unexpected end of line after the parameter name.
-						clear();
-						errorLineNum = lineIdx + 1;
-						errorNum = CONFREADER_EPARSINGFILE;
-						return CONFREADER_ERROR;
-					}
-						
-					if(_fileBuf[i] == '=' || _fileBuf[i] == ' ' || _fileBuf[i] == 0x09) break;
+				for(j=0; j<rs[i].size; j++){
+					rs[i].params[j].key = _rebase(rs[i].params[j].key, buf);
+					rs[i].params[j].value = _rebase(rs[i].params[j].value, buf);
 				}
-				_fileBuf[i++] = 0;
+			}
+			_replicas[n].sects = rs;
+		}
+		_changed();
+		CONFREADER_PROBE(replicate, nodeCount, memSize);
+		return CONFREADER_OK;
+	}
 
-				// Let's skip the whitespace characters and get the beginning of the parameter value.
-				for(; i<fileBufSize; i++){
-					if(_fileBuf[i] != '=' && _fileBuf[i] != ' ' && _fileBuf[i] != 0x09) break;
-				}
-				if(_fileBuf[i] == 0 || _fileBuf[i] == '#' || _fileBuf[i] == ';'){
-					// There is no value for the parameter.
-					clear();
-					errorLineNum = lineIdx + 1;
-					errorNum = CONFREADER_EPARSINGFILE;
+	// Moves the parsed data into one block of memory which is made read-only, after parseFile() and applyOverrides().
+	// In a server which forks after it, the pages of the block stay shared by the processes, since nothing writes
+	// them: the values are decoded at once, and the converted values and the counters of the reads are kept in
+	// other memory, like errorNum in the object. replicate(), derive() and applyOverrides() return CONFREADER_EBUSY
+	// after it. clear() frees the block.
+	// The file buffer and the arena are freed, so the strings and the arrays returned before freeze() must not be
+	// used after it, get them again. If the block can't be made read-only, the object stays not frozen.
+	int freeze(){
+		Section *fs;
+		Param *fp, *p;
+		ParamState *states;
+		unsigned long long *fb;
+		char *buf, *tail;
+		void *mem;
+		size_t bufSize, strSize = 0, bloomWords = 0, size, pageSize;
+		int paramCount = 0, i, j;
+
+		errorNum = CONFREADER_OK;
+		if(_frozen || sectCount == 0) return CONFREADER_OK;
+		_freeReplicas();
+
+		// The strings which are not in the file: the decoded values, the overrides and the changes of derive().
+		for(i=0; i<sectCount; i++){
+			if(sects[i].name && !_inFile(sects[i].name)) strSize += strlen(sects[i].name) + 1;
+			if(sects[i].bloom) bloomWords += (sects[i].bloomMask + 1) / 64;
+			for(j=0; j<sects[i].size; j++){
+				p = &sects[i].params[j];
+				if(!_decode(p)){
+					errorNum = CONFREADER_ENOMEM;
 					return CONFREADER_ERROR;
 				}
+				if(!_inFile(p->key)) strSize += strlen(p->key) + 1;
+				if(!_inFile(p->value)) strSize += strlen(p->value) + 1;
+			}
+			paramCount += sects[i].size;
+		}
+		bufSize = _fileBuf ? _fileSize + 1 : 0;
+		pageSize = sysconf(_SC_PAGESIZE);
+		size = sectCount * sizeof(Section) + paramCount * sizeof(Param) + bloomWords * sizeof(unsigned long long) + bufSize + strSize;
+		size = (size + pageSize - 1) & ~(pageSize - 1);
 
-				_params[paramIdx].value = &_fileBuf[i];
-				// Let's find the end of the parameter value.
-				for(; i<fileBufSize; i++){
-					//if(_fileBuf[i] == 0 || _fileBuf[i] == '#' || _fileBuf[i] == ';') break;
-					if(_fileBuf[i] == 0) break;
-					if(_fileBuf[i] == '#' || _fileBuf[i] == ';'){
-						if(_fileBuf[i-1] != ' ' && _fileBuf[i-1] != 0x09){
-							// Error. The comment must be separated by a space character from the value.
-							clear();
-							errorLineNum = lineIdx + 1;
-							errorNum = CONFREADER_EPARSINGFILE;
-							return CONFREADER_ERROR;
-						}
-						break;
-					}
-				}
-				
-				// We clear the whitespace characters at the end of the value and get the end of the parameter value
-				for(--i; i>=0; i--){
-					if(_fileBuf[i] != ' ' && _fileBuf[i] != 0x09) break;
+		states = (ParamState *)calloc(paramCount > 0 ? paramCount : 1, sizeof(ParamState));
+		mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(states == nullptr || mem == MAP_FAILED){
+			free(states);
+			if(mem != MAP_FAILED) munmap(mem, size);
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
+
+		// The sections, the parameters, the filters, the file and the other strings.
+		fs = (Section *)mem;
+		fp = (Param *)(fs + sectCount);
+		fb = (unsigned long long *)(fp + paramCount);
+		buf = (char *)(fb + bloomWords);
+		tail = buf + bufSize;
+		if(bufSize > 0) memcpy(buf, _fileBuf, bufSize);
+		memcpy(fs, sects, sectCount * sizeof(Section));
+		p = fp;
+		for(i=0; i<sectCount; i++){
+			fs[i].name = _freezeString(fs[i].name, buf, &tail);
+			if(fs[i].params){
+				memcpy(p, sects[i].params, sects[i].size * sizeof(Param));
+				fs[i].params = p;
+				for(j=0; j<fs[i].size; j++, p++){
+					p->key = _freezeString(p->key, buf, &tail);
+					p->value = _freezeString(p->value, buf, &tail);
+					memset(&p->cache, 0, sizeof(Cache));
+					states[p - fp].hits = p->hits;
 				}
-				// and then put 0 after the end of the parameter value.
-				_fileBuf[++i] = 0;
-				
-				sects[sectIdx].size++;
-				paramIdx++;
+			}
+			if(fs[i].bloom){
+				memcpy(fb, sects[i].bloom, (sects[i].bloomMask + 1) / 8);
+				fs[i].bloom = fb;
+				fb += (sects[i].bloomMask + 1) / 64;
 			}
 		}
+		if(mprotect(mem, size, PROT_READ) != 0){
+			munmap(mem, size);
+			free(states);
+			errorNum = CONFREADER_ENOMEM;
+			return CONFREADER_ERROR;
+		}
 
+		// The parsed data is not needed any more, the converted values are converted again.
+		if(_shared){
+			_release();
+		}else{
+			free(_fileBuf);
+			free(_params);
+			free(_blooms);
+		}
+		free(sects);
 		free(_lines);
+		free(_lineEnds);
+		_freeArena(&_ownArena);
 		_lines = nullptr;
-		errorNum = CONFREADER_OK;
+		_lineEnds = nullptr;
+		_params = nullptr;
+		_blooms = nullptr;
+
+		sects = fs;
+		_fileBuf = bufSize > 0 ? buf : nullptr;
+		_frozen = mem;
+		_frozenSize = size;
+		_frozenParams = fp;
+		_states = states;
+		_changed();
 		return CONFREADER_OK;
 	}
-	
-	char * find(const char *key, const char *section = nullptr){
-		int j;
 
-		if(_fileBuf){
-			if(section == nullptr){
-				for(j=0; j<sects[0].size; j++){
-					if(strcasecmp(key, sects[0].params[j].key) == 0){
-						errorNum = CONFREADER_OK;
-						return sects[0].params[j].value;
+	// Makes a new object with the changes: a value of nullptr removes the parameter, the parameters and the sections
+	// which are not there are added at the end. This object stays as it is, the new one shares the file and
+	// the sections without changes with it, so a change costs as much as copying its section. The strings of
+	// the changes are copied. It can be called while other threads read this object, e.g. to make the next
+	// object the readers switch to. The objects can be deleted in any order, the memory they share is freed with
+	// the last of them. Returns nullptr on error, errorNum of this object tells it.
+	Confreader * derive(const Change *changes, int count){
+		Confreader *snap;
+		Section *sect;
+		Param *params, *p;
+		char *str;
+		int *target;
+		int newSectCount, n, i, j, k;
+		bool ok = true;
+
+		errorNum = CONFREADER_OK;
+		if(_frozen){
+			errorNum = CONFREADER_EBUSY;
+			return nullptr;
+		}
+		if((target = (int *)malloc((count + 1) * sizeof(int))) == nullptr
+			|| (snap = _snapshot((sectCount > 0 ? sectCount : 1) + count, this)) == nullptr){
+			free(target);
+			errorNum = CONFREADER_ENOMEM;
+			return nullptr;
+		}
+
+		if(sectCount > 0){
+			memcpy(snap->sects, sects, sectCount * sizeof(Section));
+			newSectCount = sectCount;
+		}else{
+			memset(snap->sects, 0, sizeof(Section));		// No file was parsed.
+			newSectCount = 1;
+		}
+		for(i=0; i<count && ok; i++){
+			for(k=0; k<newSectCount && !_sameName(snap->sects[k].name, changes[i].section); k++);
+			if(k == newSectCount){
+				target[i] = -1;			// There is nothing to remove.
+				if(changes[i].value == nullptr) continue;
+				memset(&snap->sects[k], 0, sizeof(Section));
+				snap->sects[k].name = snap->_copyString(changes[i].section, strlen(changes[i].section));
+				ok = snap->sects[k].name != nullptr;
+				newSectCount++;
+			}
+			target[i] = k;
+		}
+		snap->sectCount = newSectCount;
+
+		// Only the sections with changes get new parameters, filters and hashes.
+		for(k=0; k<newSectCount && ok; k++){
+			for(n=0, i=0; i<count; i++){
+				if(target[i] == k) n++;
+			}
+			if(n == 0) continue;
+			sect = &snap->sects[k];
+
+			// The values are converted before they are copied, so that no reader converts them during the copy.
+			for(j=0; j<sect->size && ok; j++){
+				ok = _decode(&sect->params[j]);
+			}
+			if(!ok || (params = (Param *)snap->_sharedAlloc((sect->size + n) * sizeof(Param))) == nullptr){
+				ok = false;
+				break;
+			}
+			if(sect->size > 0) memcpy(params, sect->params, sect->size * sizeof(Param));
+			for(j=0; j<sect->size; j++){
+				memset(&params[j].cache, 0, sizeof(Cache));
+			}
+			sect->params = params;
+
+			for(i=0; i<count && ok; i++){
+				if(target[i] != k) continue;
+				if(changes[i].value == nullptr){
+					// All the parameters with the key are removed, the repeated ones too.
+					for(j=0; j<sect->size; ){
+						if(_sameName(params[j].key, changes[i].key)){
+							memmove(&params[j], &params[j + 1], (sect->size - j - 1) * sizeof(Param));
+							sect->size--;
+						}else{
+							j++;
+						}
 					}
+					continue;
 				}
-			}else{
-				for(int i=1; i<sectCount; i++){
-					if(strcasecmp(section, sects[i].name) == 0){
-						for(j=0; j<sects[i].size; j++){
-							if(strcasecmp(key, sects[i].params[j].key) == 0){
-								errorNum = CONFREADER_OK;
-								return sects[i].params[j].value;
-							}
-						}
+				for(j=0; j<sect->size && !_sameName(params[j].key, changes[i].key); j++);
+				p = &params[j];
+				if(j == sect->size){
+					if((p->key = snap->_copyString(changes[i].key, strlen(changes[i].key))) == nullptr){
+						ok = false;
 						break;
 					}
+					p->lineNum = 0;
+					p->hits = 0;
+					p->valueStart = p->valueEnd = -1;
+					sect->size++;
+				}
+				if((str = snap->_copyString(changes[i].value, strlen(changes[i].value))) == nullptr){
+					ok = false;
+					break;
 				}
+				_setValue(p, str);
+			}
+			if(!ok) break;
+
+			if(sect->size == 0){
+				sect->params = nullptr;
+				sect->bloom = nullptr;
+			}else
+			if(!snap->_arenaBloom(sect)){
+				ok = false;
+				break;
 			}
+			snap->_hashSection(sect);
+			snap->_fingerprint = _hash64((const char *)&sect->hash, sizeof(sect->hash), snap->_fingerprint);
 		}
-		errorNum = CONFREADER_ENOPARAM;
-		return nullptr;
+		free(target);
+
+		if(!ok){
+			delete snap;
+			errorNum = CONFREADER_ENOMEM;
+			return nullptr;
+		}
+		return snap;
 	}
-	
-	bool hasSection(const char *section){
-		int i;
 
-		for(i=1; i<sectCount; i++){
-			if(strcasecmp(section, sects[i].name) == 0){
-				return true;
+	// Collects the changes of the parameters for derive(). build() makes the new object from the base one,
+	// which is not changed:
+	// Confreader::Builder b(conf);
+	// b.set("port", "dbaccess", "5433");
+	// b.erase("timeout", "dbaccess");
+	// next = b.build();
+	class Builder {
+		Confreader *_base;
+		Change *_changes;		// The strings are copies.
+		int _count;
+		int _cap;
+
+		int _add(const char *key, const char *section, const char *value){
+			Change *newChanges, *c;
+
+			errorNum = CONFREADER_OK;
+			if(_count == _cap){
+				newChanges = (Change *)realloc(_changes, (_cap ? _cap * 2 : 16) * sizeof(Change));
+				if(newChanges == nullptr){
+					errorNum = CONFREADER_ENOMEM;
+					return CONFREADER_ERROR;
+				}
+				_changes = newChanges;
+				_cap = _cap ? _cap * 2 : 16;
+			}
+			c = &_changes[_count];
+			c->section = section ? strdup(section) : nullptr;
+			c->key = strdup(key);
+			c->value = value ? strdup(value) : nullptr;
+			if(c->key == nullptr || (section && c->section == nullptr) || (value && c->value == nullptr)){
+				free((char *)c->section);
+				free((char *)c->key);
+				free((char *)c->value);
+				errorNum = CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
 			}
+			_count++;
+			return CONFREADER_OK;
 		}
-		errorNum = CONFREADER_ENOSECT;
-		return false;
-	}
-	
-	bool has(const char *key, const char *section = nullptr){
-		if(find(key, section) != nullptr){
+
+	public:
+		int errorNum;
+
+		Builder(Confreader *base){
+			_base = base;
+			_changes = nullptr;
+			_count = 0;
+			_cap = 0;
+			errorNum = 0;
+		}
+		// The copy would free the same changes.
+		Builder(const Builder &) = delete;
+		Builder & operator=(const Builder &) = delete;
+		~Builder(){
+			reset();
+			free(_changes);
+		}
+
+		// Sets the value of the parameter, it is added if it is not there. The later changes of the same
+		// parameter win.
+		int set(const char *key, const char *section, const char *value){
+			if(key == nullptr || value == nullptr){
+				errorNum = CONFREADER_EINVVAL;
+				return CONFREADER_ERROR;
+			}
+			return _add(key, section, value);
+		}
+
+		// Removes the parameter.
+		int erase(const char *key, const char *section){
+			if(key == nullptr){
+				errorNum = CONFREADER_EINVVAL;
+				return CONFREADER_ERROR;
+			}
+			return _add(key, section, nullptr);
+		}
+
+		// Drops the collected changes.
+		void reset(){
+			int i;
+
+			for(i=0; i<_count; i++){
+				free((char *)_changes[i].section);
+				free((char *)_changes[i].key);
+				free((char *)_changes[i].value);
+			}
+			_count = 0;
+		}
+
+		// Makes the new object with the changes, they are dropped then. Returns nullptr on error.
+		Confreader * build(){
+			Confreader *snap = _base->derive(_changes, _count);
+
+			if(snap == nullptr){
+				errorNum = _base->errorNum;
+				return nullptr;
+			}
+			reset();
+			errorNum = CONFREADER_OK;
+			return snap;
+		}
+	};
+
+	// Keeps the last objects published by the program, so that it can go back to one of them at once, without
+	// reading the file. The threads read current(). A published object shares the sections which are not changed
+	// with the previous one, as derive() does. The objects which are dropped from the history are retired, the
+	// program frees them by freeRetired() when no thread reads them any more.
+	class History {
+		Confreader **_ring;
+		int _cap;
+		int _count;
+		int _head;				// The newest object.
+		int _back;				// How far back from the newest the current object is, after rollback().
+		Confreader *_current;
+		Confreader **_retired;
+		int _retiredCount;
+		int _retiredCap;
+
+		// Makes sure that count more objects can be retired without allocating.
+		bool _reserve(int count){
+			Confreader **newRetired;
+			int cap;
+
+			if(_retiredCount + count <= _retiredCap) return true;
+			for(cap=(_retiredCap ? _retiredCap * 2 : 16); cap < _retiredCount + count; cap*=2);
+			if((newRetired = (Confreader **)realloc(_retired, cap * sizeof(Confreader *))) == nullptr) return false;
+			_retired = newRetired;
+			_retiredCap = cap;
 			return true;
 		}
-		return false;
-	}
 
-	char getChar(const char *key, const char *section = nullptr, char defaultValue = 0){
-		char *val;
-		
-		if((val = find(key, section)) != nullptr){
-			return val[0];
+	public:
+		int errorNum;
+
+		// Keeps size objects, at least 2.
+		History(int size){
+			_cap = size > 2 ? size : 2;
+			_ring = (Confreader **)malloc(_cap * sizeof(Confreader *));
+			_count = 0;
+			_head = _cap - 1;
+			_back = 0;
+			_current = nullptr;
+			_retired = nullptr;
+			_retiredCount = 0;
+			_retiredCap = 0;
+			errorNum = _ring ? CONFREADER_OK : CONFREADER_ENOMEM;
 		}
-		return defaultValue;
-	}
-	
-	char * getString(const char *key, const char *section = nullptr, const char *defaultValue = nullptr){
-		char *val;
-		
-		if((val = find(key, section)) != nullptr){
-			return val;
+		// The copy would delete the same objects.
+		History(const History &) = delete;
+		History & operator=(const History &) = delete;
+		~History(){
+			int i;
+
+			for(i=0; i<_count; i++){
+				delete _ring[(_head - i + _cap) % _cap];
+			}
+			freeRetired();
+			free(_ring);
+			free(_retired);
 		}
-		return (char *)defaultValue;
-	}
-	
-	int getInt(const char *key, const char *section = nullptr, int defaultValue = 0){
-		char *val;
-		int k;
-		
-		if((val = find(key, section)) != nullptr){
-			if((val[0] < '0' || val[0] > '9') && val[0] != '-'){
-				errorNum = CONFREADER_EINVVAL;
-				return defaultValue;
+
+		// The object the threads read, nullptr before the first publish().
+		Confreader * current(){
+			return __atomic_load_n(&_current, __ATOMIC_ACQUIRE);
+		}
+
+		// The number of objects in the history.
+		int count(){
+			return _count;
+		}
+
+		// Makes the parsed object current and the newest in the history, the history takes it. If the current one
+		// was rolled back, the newer ones are retired. The copies of the sections since the file of the oldest
+		// object which shares them were parsed are counted, the sections are not shared any more if the copies
+		// are larger than that file, so the memory stays bounded. The sections are shared through a new object,
+		// so an object with what the new one wouldn't have, the copies on the nodes, the profile, the counters
+		// of the reads or the diagnostics, is kept as it is.
+		int publish(Confreader *conf){
+			Confreader *prev, *snap = conf;
+
+			if(_ring == nullptr || conf == nullptr){
+				errorNum = _ring ? CONFREADER_EINVVAL : CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
 			}
-			for(k=1; val[k]!=0; k++){
-				if(val[k] < '0' || val[k] > '9'){
-					errorNum = CONFREADER_EINVVAL;
-					return defaultValue;
+			if(!_reserve(_back + 1)){
+				errorNum = CONFREADER_ENOMEM;
+				return CONFREADER_ERROR;
+			}
+			for(; _back > 0; _back--, _count--){
+				_retired[_retiredCount++] = _ring[_head];
+				_head = (_head - 1 + _cap) % _cap;
+			}
+
+			prev = _count > 0 ? _ring[_head] : nullptr;
+			if(prev && conf->_shared == nullptr && conf->_frozen == nullptr && (prev->_shared == nullptr || prev->_shared->copied <= (size_t)prev->_fileSize)
+			   && conf->_replicas == nullptr && conf->_profile == nullptr && !(conf->options & CONFREADER_OPT_RECORD_ACCESS)
+			   && conf->diagCount == 0 && conf->deprecatedHits == 0){
+				// Without memory the object is kept as it is.
+				if((snap = conf->_dedup(prev)) != nullptr){
+					delete conf;
+				}else{
+					snap = conf;
 				}
 			}
 
-			return strtol(val, NULL, 10);
+			if(_count == _cap){
+				_retired[_retiredCount++] = _ring[(_head + 1) % _cap];
+				_count--;
+			}
+			_head = (_head + 1) % _cap;
+			_ring[_head] = snap;
+			_count++;
+			__atomic_store_n(&_current, snap, __ATOMIC_RELEASE);
+			errorNum = CONFREADER_OK;
+			return CONFREADER_OK;
 		}
-		return defaultValue;
-	}
-	
-	double getDouble(const char *key, const char *section = nullptr, double defaultValue = 0.0){
-		char *val;
-		int k;
-		
-		if((val = find(key, section)) != nullptr){
-			if((val[0] < '0' || val[0] > '9') && val[0] != '-'){
+
+		// Makes the object n steps older than the current one current again, a negative n goes forward.
+		// The history is not changed until the next publish().
+		int rollback(int n = 1){
+			if(_back + n < 0 || _back + n >= _count){
 				errorNum = CONFREADER_EINVVAL;
-				return defaultValue;
+				return CONFREADER_ERROR;
 			}
-			for(k=1; val[k]!=0; k++){
-				if((val[k] < '0' || val[k] > '9') && val[k] != '.'){
-					errorNum = CONFREADER_EINVVAL;
-					return defaultValue;
+			_back += n;
+			__atomic_store_n(&_current, _ring[(_head - _back + _cap) % _cap], __ATOMIC_RELEASE);
+			errorNum = CONFREADER_OK;
+			return CONFREADER_OK;
+		}
+
+		// Frees the objects dropped from the history. Call it when no thread reads them, e.g. when each thread
+		// has finished the reads it started before publish().
+		void freeRetired(){
+			int i;
+
+			for(i=0; i<_retiredCount; i++){
+				delete _retired[i];
+			}
+			_retiredCount = 0;
+		}
+	};
+
+#if __cplusplus >= 201402L
+	template<typename E>
+	struct EnumName {
+		const char *name;
+		E value;
+	};
+
+	// The table of enum names compiled into a perfect hash. Declare it as static constexpr at the call site:
+	//   static constexpr auto levels = Confreader::enumMap<Level>({{"debug", Level::Debug}, {"warning", Level::Warning}});
+	//   Level level = cfg->getEnum("log_level", nullptr, levels, Level::Warning);
+	// Names are case-insensitive, as are all names in confreader.
+	template<typename E, size_t N>
+	class EnumMap {
+	public:
+		static constexpr size_t _pow2(size_t n, size_t p = 1){
+			return p >= n ? p : _pow2(n, p * 2);
+		}
+
+		static constexpr size_t bucketCount = _pow2(N);
+		static constexpr size_t slotCount = bucketCount * 4;
+
+		EnumName<E> names[N];
+		unsigned short disp[bucketCount];		// Displacement of the slots for every bucket.
+		unsigned short slots[slotCount];		// Index of the name + 1, 0 is an empty slot.
+		bool valid;
+
+		constexpr EnumMap(const EnumName<E> (&entries)[N]) : names{}, disp{}, slots{}, valid(true) {
+			bool done[bucketCount] = {};
+			size_t i = 0, j = 0, b = 0, best = 0, bestSize = 0, size = 0;
+			unsigned int d = 0;
+
+			for(i=0; i<N; i++){
+				names[i] = entries[i];
+			}
+			for(i=0; i<N; i++){
+				for(j=i+1; j<N; j++){
+					if(_sameName(names[i].name, names[j].name)){		// Two names are the same.
+						valid = false;
+						return;
+					}
 				}
 			}
 
-			return strtod(val, NULL);
+			// Hash and displace: the largest buckets are placed first, while the table is still empty.
+			for(b=0; b<bucketCount; b++){
+				best = bucketCount;
+				bestSize = 0;
+				for(i=0; i<bucketCount; i++){
+					if(done[i]) continue;
+					size = 0;
+					for(j=0; j<N; j++){
+						if((_hashKey(names[j].name) & (bucketCount - 1)) == i) size++;
+					}
+					if(best == bucketCount || size > bestSize){
+						best = i;
+						bestSize = size;
+					}
+				}
+				done[best] = true;
+				if(bestSize == 0) continue;
+
+				for(d=0; d<65536; d++){
+					if(_place(best, d, false)) break;
+				}
+				if(d == 65536){
+					valid = false;
+					return;
+				}
+				_place(best, d, true);
+				disp[best] = d;
+			}
 		}
-		return defaultValue;
+
+		constexpr bool ok() const {
+			return valid;
+		}
+
+		static constexpr unsigned int slotOf(unsigned int h, unsigned int d){
+			return _mix(h ^ (d * 0x9E3779B9u)) & (slotCount - 1);
+		}
+
+		// Returns the index of the name or -1.
+		int indexOf(const char *name) const {
+			unsigned int h = _hashKey(name);
+			int idx = slots[slotOf(h, disp[h & (bucketCount - 1)])] - 1;
+
+			if(idx < 0 || strcasecmp(name, names[idx].name) != 0) return -1;
+			return idx;
+		}
+
+	private:
+		static constexpr char _lower(char c){
+			return (c >= 'A' && c <= 'Z') ? c + 32 : c;
+		}
+
+		static constexpr bool _sameName(const char *a, const char *b){
+			while(*a != 0 && _lower(*a) == _lower(*b)){
+				a++;
+				b++;
+			}
+			return _lower(*a) == _lower(*b);
+		}
+
+		static constexpr unsigned int _mix(unsigned int h){
+			return ((h ^ (h >> 15)) * 0x2C1B3C6Du) ^ (((h ^ (h >> 15)) * 0x2C1B3C6Du) >> 12);
+		}
+
+		// Checks that all names of the bucket get free and different slots, and takes them if asked.
+		constexpr bool _place(size_t bucket, unsigned int d, bool take){
+			unsigned short used[slotCount] = {};
+			size_t j = 0;
+			unsigned int h = 0, slot = 0;
+
+			for(j=0; j<N; j++){
+				h = _hashKey(names[j].name);
+				if((h & (bucketCount - 1)) != bucket) continue;
+				slot = slotOf(h, d);
+				if(slots[slot] != 0 || used[slot] != 0) return false;
+				used[slot] = 1;
+				if(take) slots[slot] = j + 1;
+			}
+			return true;
+		}
+	};
+
+	template<typename E, size_t N>
+	static constexpr EnumMap<E, N> enumMap(const EnumName<E> (&entries)[N]){
+		return EnumMap<E, N>(entries);
 	}
-	
-	bool getBool(const char *key, const char *section = nullptr, bool defaultValue = false){
-		char *val;
-		int ret;
-		
-		if((val = find(key, section)) != nullptr){
-			if(strcasecmp(val, "yes") == 0 || strcasecmp(val, "true") == 0 || (val[0] == '1' && val[1] == 0)){
-				return true;
+
+	template<typename E, size_t N>
+	E getEnum(Name key, Name section, const EnumMap<E, N> &map, E defaultValue = E()){
+		Param *p;
+		int idx;
+
+		if((p = _findParam(key, section)) != nullptr){
+			// Another table may be at the same address later, so the cached index is used only if it has the name.
+			if(_cached(p, CONFREADER_CACHE_ENUM, &map)){
+				idx = (int)_cacheOf(p)->v.i;
+				if(idx < (int)N && strcasecmp(p->value, map.names[idx].name) == 0) return map.names[idx].value;
 			}
-			if(strcasecmp(val, "no") == 0 || strcasecmp(val, "false") == 0 || (val[0] == '0' && val[1] == 0)){
-				return false;
+			if(!map.ok() || (idx = map.indexOf(p->value)) < 0){
+				errorNum = CONFREADER_EINVVAL;
+				return defaultValue;
 			}
-			
-			errorNum = CONFREADER_EINVVAL;
-			return defaultValue;
+			if(_cacheLock(p)){
+				_cacheOf(p)->v.i = idx;
+				_cacheUnlock(p, CONFREADER_CACHE_ENUM, &map);
+			}
+			return map.names[idx].value;
 		}
 		return defaultValue;
 	}
+#endif
 	
 };
 
+// The name of a parameter with its length and hash computed at compile time: conf.getInt("port"_ck, "DBAccess"),
+// after using namespace confreader_literals.
+namespace confreader_literals {
+
+constexpr Confreader::Name operator""_ck(const char *s, size_t len){
+	return Confreader::Name(s, (int)len);
+}
+
+}
+
 #endif	// __CONFREADER_HPP_
@@ -0,0 +1,505 @@
+/*
+confreader-test - checks the functions of confreader.h on small files written to /tmp.
+
+The same checks as confreader-test.cpp for the functions for C. The failed checks are printed with their
+line, the program returns 1 if any check failed.
+
+Build and run:
+gcc -std=c99 -O2 -Wall -o confreader-test-c confreader-test.c && ./confreader-test-c
+*/
+
+// mkstemp() and setenv() are not in ISO C.
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../confreader.h"
+
+static int checks;
+static int failures;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(int ok, const char *text, int line){
+	checks++;
+	if(!ok){
+		failures++;
+		printf("line %d: %s\n", line, text);
+	}
+}
+
+static int same(const char *a, const char *b){
+	return a != NULL && b != NULL && strcmp(a, b) == 0;
+}
+
+// Writes the text to a new file in /tmp, the name is put into path.
+static int writeConf(char *path, const char *text){
+	int fd;
+	ssize_t len = strlen(text);
+
+	strcpy(path, "/tmp/confreader-test.XXXXXX");
+	if((fd = mkstemp(path)) == -1) return 0;
+	if(write(fd, text, len) != len){
+		close(fd);
+		unlink(path);
+		return 0;
+	}
+	close(fd);
+	return 1;
+}
+
+// Reads the whole file into a buffer which the caller frees.
+static char * readConf(const char *path){
+	char *buf;
+	long size;
+	FILE *f;
+
+	if((f = fopen(path, "rb")) == NULL) return NULL;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if((buf = (char *)malloc(size + 1)) != NULL){
+		if(fread(buf, 1, size, f) != (size_t)size) size = 0;
+		buf[size] = 0;
+	}
+	fclose(f);
+	return buf;
+}
+
+static void testUnits(){
+	char path[64];
+
+	CHECK(writeConf(path, "t1 = 250ms\nt2 = 2 min\nb1 = 64MiB\nb2 = 2KB\nr1 = 10k/s\nbad = 5 parsecs\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetDuration("t1", NULL, 0) == 250 && confreaderGetDuration("t2", NULL, 0) == 120000);
+	CHECK(confreaderGetDuration("t2", NULL, 0) == 120000 && same(confreaderGetString("t2", NULL, NULL), "2 min"));
+	CHECK(confreaderGetBytes("b1", NULL, 0) == 64LL * 1024 * 1024 && confreaderGetBytes("b2", NULL, 0) == 2000);
+	CHECK(confreaderGetRate("r1", NULL, 0) == 10000.0);
+	CHECK(confreaderGetDuration("bad", NULL, 7) == 7 && confreaderErrorNum == CONFREADER_EINVVAL);
+	confreaderClear();
+	unlink(path);
+}
+
+static void testEnum(){
+	static const ConfreaderEnumName levels[] = {{"debug", 0}, {"info", 1}, {"warning", 2}};
+	ConfreaderEnumName table[3];
+	char path[64];
+
+	CHECK(writeConf(path, "l1 = WARNING\nl2 = verbose\nl3 = warning\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetEnum("l1", NULL, levels, 3, 1) == 2 && confreaderGetEnum("l1", NULL, levels, 3, 1) == 2);
+	CHECK(confreaderGetEnum("l2", NULL, levels, 3, 1) == 1 && confreaderErrorNum == CONFREADER_EINVVAL);
+
+	// Another table at the address of the cached one, as on the stack, doesn't use the index of the other.
+	memcpy(table, levels, sizeof(levels));
+	CHECK(confreaderGetEnum("l3", NULL, table, 3, 1) == 2);
+	table[0].name = "warning";
+	table[0].value = 0;
+	CHECK(confreaderGetEnum("l3", NULL, table, 1, 1) == 0);
+	confreaderClear();
+	unlink(path);
+}
+
+static void testNetwork(){
+	char path[64];
+	ConfreaderIpAddr ip;
+	ConfreaderEndpoint ep;
+	const ConfreaderCidrList *acl;
+
+	CHECK(writeConf(path, "server = 192.168.0.60\nplain = 10.0.0.1\nzero = 10.0.0.1:0\nzero6 = [::]:0\nallow = 10.0.0.0/8, fd00::/8\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetIpAddr("server", NULL, &ip) && ip.family == AF_INET && ip.addr[3] == 60);
+
+	// The default port is for a value without a port, an explicit :0 is kept, also when the value is cached.
+	CHECK(confreaderGetEndpoint("plain", NULL, &ep, 80) && ntohs(ep.addr.sin.sin_port) == 80);
+	CHECK(confreaderGetEndpoint("plain", NULL, &ep, 81) && ntohs(ep.addr.sin.sin_port) == 81);
+	CHECK(confreaderGetEndpoint("zero", NULL, &ep, 80) && ntohs(ep.addr.sin.sin_port) == 0);
+	CHECK(confreaderGetEndpoint("zero", NULL, &ep, 80) && ntohs(ep.addr.sin.sin_port) == 0);
+	CHECK(confreaderGetEndpoint("zero6", NULL, &ep, 80) && ntohs(ep.addr.sin6.sin6_port) == 0);
+
+	CHECK((acl = confreaderGetCidrList("allow", NULL)) != NULL);
+	if(acl){
+		CHECK(!confreaderCidrMatch(acl, &ip));
+		CHECK(confreaderGetIpAddr("plain", NULL, &ip) && confreaderCidrMatch(acl, &ip));
+	}
+	// The value is cached as an address, the list is kept next to it.
+	CHECK((acl = confreaderGetCidrList("server", NULL)) != NULL && confreaderGetCidrList("server", NULL) == acl);
+	CHECK(confreaderGetIpAddr("server", NULL, &ip) && ip.addr[3] == 60);
+	if(acl) CHECK(confreaderCidrMatch(acl, &ip));
+	confreaderClear();
+	unlink(path);
+}
+
+static void testArrays(){
+	char path[64];
+	long long ints[4];
+	double doubles[4];
+	const long long *all;
+	int count;
+
+	CHECK(writeConf(path, "ints = 10, 20 30,-40\ndoubles = 0.5 1.5 -2.25\nbad = 1, x\nttl = 250\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetIntArray("ints", NULL, ints, 4) == 4 && ints[3] == -40);
+	CHECK(confreaderGetDoubleArray("doubles", NULL, doubles, 4) == 3 && doubles[2] == -2.25);
+	CHECK((all = confreaderGetIntArrayPtr("ints", NULL, &count)) != NULL && count == 4 && all[1] == 20);
+	CHECK(confreaderGetIntArrayPtr("ints", NULL, &count) == all);
+	CHECK(confreaderGetIntArrayPtr("bad", NULL, &count) == NULL);
+
+	// A value cached as another type is decoded into an entry chained to the cache.
+	CHECK(confreaderGetDoubleArrayPtr("ints", NULL, &count) != NULL && count == 4);
+	CHECK(confreaderGetDuration("ttl", NULL, 0) == 250);
+	CHECK((all = confreaderGetIntArrayPtr("ttl", NULL, &count)) != NULL && count == 1 && all[0] == 250);
+	CHECK(confreaderGetIntArrayPtr("ttl", NULL, &count) == all && confreaderGetDuration("ttl", NULL, 0) == 250);
+	confreaderClear();
+	unlink(path);
+}
+
+static void testQuoted(){
+	char path[64], *text, value[64];
+	int len = 0, i, ok = 1;
+
+	CHECK(writeConf(path, "plain = a b # comment\nquoted = \"  a;b # c \\t\\\"x\\\" \"\nslash = \"a \\\\\"\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(same(confreaderGetString("plain", NULL, NULL), "a b"));
+	CHECK(same(confreaderGetString("quoted", NULL, NULL), "  a;b # c \t\"x\" "));
+	CHECK(confreaderGetString("quoted", NULL, NULL) == confreaderGetString("quoted", NULL, NULL));
+	CHECK(same(confreaderGetString("slash", NULL, NULL), "a \\"));
+	confreaderClear();
+	unlink(path);
+
+	// Many decoded values, more than a block of the arena.
+	text = (char *)malloc(5000 * 40);
+	for(i=0; i<5000; i++) len += sprintf(&text[len], "k%d = \"v\\t%d\"\n", i, i);
+	CHECK(writeConf(path, text));
+	free(text);
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	for(i=0; i<5000 && ok; i++){
+		sprintf(value, "k%d", i);
+		ok = confreaderGetString(value, NULL, NULL) != NULL && confreaderGetString(value, NULL, NULL)[1] == '\t' && atoi(confreaderGetString(value, NULL, NULL) + 2) == i;
+	}
+	CHECK(ok);
+	confreaderClear();
+	unlink(path);
+}
+
+static void testContinuation(){
+	char path[64];
+
+	CHECK(writeConf(path, "[s]\nlist = one \\\n    two \\\n\tthree\npath = C:\\dir\\\nnext = 1\nstop = x \\\n# comment\ntext = <<END\nline 1\nline 2\nEND\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(same(confreaderGetString("list", "s", NULL), "one two three"));
+	CHECK(same(confreaderGetString("path", "s", NULL), "C:\\dir\\"));
+	CHECK(confreaderGetInt("next", "s", 0) == 1);
+	CHECK(same(confreaderGetString("stop", "s", NULL), "x \\"));
+	CHECK(same(confreaderGetString("text", "s", NULL), "line 1\nline 2"));
+	confreaderClear();
+	unlink(path);
+
+	// A backslash before a section header stays in the value, the header starts the section.
+	CHECK(writeConf(path, "k = a \\\n[t]\nm = 1\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(same(confreaderGetString("k", NULL, NULL), "a \\") && confreaderGetInt("m", "t", 0) == 1);
+	confreaderClear();
+	unlink(path);
+}
+
+static void testEncoding(){
+	char path[64];
+
+	CHECK(writeConf(path, "\xEF\xBB\xBF" "top = 1\r\n[Sect]\nname = caf\xC3\xA9\r\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetInt("top", NULL, 0) == 1 && same(confreaderGetString("name", "Sect", NULL), "caf\xC3\xA9"));
+	confreaderClear();
+	unlink(path);
+
+	CHECK(writeConf(path, "a = 1\nb = 2#no space\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_ERROR);
+	CHECK(confreaderErrorNum == CONFREADER_EPARSINGFILE && confreaderErrorLineNum == 2 && confreaderErrorColNum == 6);
+	confreaderClear();
+	unlink(path);
+
+	confreaderOptions = CONFREADER_OPT_CHECK_UTF8;
+	CHECK(writeConf(path, "a = caf\xC3\xA9\nb = \xFF\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_ERROR && confreaderErrorNum == CONFREADER_EENCODING && confreaderErrorLineNum == 2);
+	confreaderClear();
+	confreaderOptions = 0;
+	unlink(path);
+}
+
+static void testAllErrors(){
+	char path[64];
+
+	// All the errors are collected, a header without the bracket skips its parameters.
+	confreaderOptions = CONFREADER_OPT_ALL_ERRORS;
+	CHECK(writeConf(path, "a = 1\nb =\n[broken\nc = 3\n[good]\nd = \"x\n e = 5\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_ERROR);
+	CHECK(confreaderDiagCount == 3);
+	if(confreaderDiagCount == 3){
+		CHECK(confreaderDiags[0].lineNum == 2 && confreaderDiags[0].kind == CONFREADER_DIAG_NOVALUE);
+		CHECK(confreaderDiags[1].lineNum == 3 && confreaderDiags[1].kind == CONFREADER_DIAG_SECTION);
+		CHECK(confreaderDiags[2].lineNum == 6 && confreaderDiags[2].kind == CONFREADER_DIAG_QUOTE);
+	}
+	CHECK(confreaderGetInt("a", NULL, 0) == 1 && !confreaderHas("c", NULL) && confreaderGetInt("e", "good", 0) == 5);
+	confreaderClear();
+	confreaderOptions = 0;
+	unlink(path);
+}
+
+static void testSchema(){
+	static const ConfreaderSchemaEntry schema[] = {
+		{NULL, "name", CONFREADER_TYPE_STRING, CONFREADER_SCHEMA_REQUIRED, 0, 0, "web-[0-9]*"},
+		{NULL, "port", CONFREADER_TYPE_INT, CONFREADER_SCHEMA_RANGE, 1, 65535, NULL},
+		{"db", "timeout", CONFREADER_TYPE_DURATION, CONFREADER_SCHEMA_REQUIRED, 0, 0, NULL},
+	};
+	static const ConfreaderSchemaEntry twice[] = {
+		{"db", "timeout", CONFREADER_TYPE_DURATION, 0, 0, 0, NULL},
+		{"DB", "Timeout", CONFREADER_TYPE_INT, 0, 0, 0, NULL},
+	};
+	char path[64];
+	int diagCount;
+
+	CHECK(writeConf(path, "name = db-1\nport = 70000\n[db]\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderValidate(schema, 3) == CONFREADER_ERROR && confreaderDiagCount == 3);
+	diagCount = confreaderDiagCount;
+	CHECK(confreaderValidate(twice, 2) == CONFREADER_ERROR && confreaderErrorNum == CONFREADER_EINVVAL && confreaderDiagCount == diagCount);
+	confreaderClear();
+	unlink(path);
+}
+
+static void testPatchFile(){
+	static const ConfreaderChange changes[] = {
+		{NULL, "port", "2223"},
+		{"db", "password", NULL},
+		{"cache", "size", "64MB"},
+	};
+	static const ConfreaderChange badName[] = {
+		{NULL, "key=1", "1"},
+	};
+	static const ConfreaderChange twice[] = {
+		{"db", "user", "a"},
+		{"DB", "USER", "b"},
+	};
+	static const ConfreaderChange xyz[] = {
+		{NULL, "b", "XYZ"},
+	};
+	char path[64], other[64], *text;
+
+	CHECK(writeConf(path, "# top\nport = 2222   # the port\n[db]\nuser = root\npassword = secret\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderPatchFile(path, badName, 1) == CONFREADER_ERROR && confreaderErrorNum == CONFREADER_EINVVAL);
+	CHECK(confreaderPatchFile(path, twice, 2) == CONFREADER_ERROR && confreaderErrorNum == CONFREADER_EINVVAL);
+	CHECK(confreaderPatchFile(path, changes, 3) == CONFREADER_OK);
+	text = readConf(path);
+	CHECK(text != NULL && strstr(text, "# top\n") && strstr(text, "# the port") && !strstr(text, "secret"));
+	free(text);
+	confreaderClear();
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetInt("port", NULL, 0) == 2223 && !confreaderHas("password", "db") && confreaderGetBytes("size", "cache", 0) == 64000000);
+	confreaderClear();
+	unlink(path);
+
+	// Another text of the same size is not patched at the offsets of the parsed one.
+	CHECK(writeConf(path, "a = 1\nb = 2\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(writeConf(other, "b = 1\na = 2\n") && rename(other, path) == 0);
+	CHECK(confreaderPatchFile(path, xyz, 1) == CONFREADER_ERROR && confreaderErrorNum == CONFREADER_EBUSY);
+	text = readConf(path);
+	CHECK(text != NULL && same(text, "b = 1\na = 2\n"));
+	free(text);
+	confreaderClear();
+	unlink(path);
+
+	// A value that starts with = is quoted, otherwise it would be read back without it.
+	CHECK(writeConf(path, "k = \"=abc\"\nm = a=b\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(writeConf(other, "") && confreaderWriteFile(other) == CONFREADER_OK);
+	confreaderClear();
+	CHECK(confreaderParseFile(other) == CONFREADER_OK);
+	CHECK(same(confreaderGetString("k", NULL, NULL), "=abc") && same(confreaderGetString("m", NULL, NULL), "a=b"));
+	confreaderClear();
+	unlink(other);
+	unlink(path);
+}
+
+static void testJson(){
+	char path[64], buf[256];
+	int len;
+
+	CHECK(writeConf(path, "a = 1\n[s]\nc = x\xFFy\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	len = confreaderToJson(NULL, 0);
+	CHECK(len > 0 && len < (int)sizeof(buf) && confreaderToJson(buf, sizeof(buf)) == len);
+	CHECK(same(buf, "{\"a\":\"1\",\"s\":{\"c\":\"x\\ufffdy\"}}"));
+	confreaderClear();
+	unlink(path);
+
+	// A value that starts with = is quoted, so k==abc doesn't read as k=abc.
+	CHECK(writeConf(path, "k = \"=abc\"\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderToFlat(buf, sizeof(buf)) > 0 && strstr(buf, "k=\"=abc\"") != NULL);
+	confreaderClear();
+	unlink(path);
+}
+
+static void testOverrides(){
+	char path[64];
+	char arg0[] = "test", arg1[] = "--conf.db.user=admin", arg2[] = "--conf.n=7", arg3[] = "--port=9";
+	char *argv[] = {arg0, arg1, arg2, arg3};
+
+	CHECK(writeConf(path, "port = 1\n[db]\nport = 2\nuser = root\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	setenv("CRTEST_DB_PORT", "3334", 1);
+	CHECK(confreaderApplyOverrides("CRTEST_", "conf.", 4, argv) == CONFREADER_OK);
+	CHECK(confreaderGetInt("port", "db", 0) == 3334 && confreaderGetInt("port", NULL, 0) == 1);
+	CHECK(same(confreaderGetString("user", "db", NULL), "admin") && confreaderGetInt("n", NULL, 0) == 7);
+	unsetenv("CRTEST_DB_PORT");
+	confreaderClear();
+	unlink(path);
+}
+
+static void testAliases(){
+	static const ConfreaderAlias aliases[] = {
+		{"db", "conn_timeout", "connect_timeout"},
+	};
+	char path[64];
+
+	CHECK(writeConf(path, "[db]\nconn_timeout = 5\n"));
+	confreaderSetAliases(aliases, 1);
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetInt("connect_timeout", "db", 0) == 5 && confreaderGetInt("conn_timeout", "db", 0) == 5);
+	CHECK(confreaderDeprecatedHits >= 2);
+	confreaderClear();
+	confreaderSetAliases(NULL, 0);
+	unlink(path);
+}
+
+static void testMissing(){
+	char path[64], text[4096], name[32];
+	int len, i, ok = 1;
+
+	len = sprintf(text, "[big]\n");
+	for(i=0; i<200; i++) len += sprintf(&text[len], "key_%d = %d\n", i, i);
+	CHECK(writeConf(path, text));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	for(i=0; i<200 && ok; i++){
+		sprintf(name, "KEY_%d", i);
+		ok = confreaderGetInt(name, "big", -1) == i;
+	}
+	CHECK(ok);
+	CHECK(!confreaderHas("absent", "big") && !confreaderHas("key_200", "big"));
+	confreaderClear();
+	unlink(path);
+}
+
+static void testProfile(){
+	char path[64], profile[64];
+
+	// The later duplicate of the section a has more reads, the lookups must still find the first one.
+	CHECK(writeConf(path, "[a]\nx = 1\n[b]\ny = 1\n[a]\nx = 2\nz = 3\n"));
+	CHECK(writeConf(profile, "[a\nx = 100\n[b]\ny = 5\n[a]\nz = 50\n"));
+	CHECK(confreaderSetProfile(profile) == CONFREADER_OK);
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetInt("x", "a", 0) == 1);
+	CHECK(confreaderSectCount == 4 && same(confreaderSects[3].name, "b"));
+	confreaderClear();
+	confreaderSetProfile(NULL);
+	unlink(path);
+	unlink(profile);
+}
+
+static void testReplicate(){
+	char path[64];
+
+	CHECK(writeConf(path, "port = 80\n[s]\nq = \"a\\tb\"\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderReplicate() == CONFREADER_OK);
+	CHECK(confreaderGetInt("port", NULL, 0) == 80 && same(confreaderGetString("q", "s", NULL), "a\tb"));
+	confreaderClear();
+	unlink(path);
+}
+
+static void testFingerprint(){
+	char path[64], other[64];
+	unsigned long long hash, sectHash;
+
+	CHECK(writeConf(path, "[s]\nlist = one \\\n    two \\\n\tthree\n[t]\nv = 1\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	hash = confreaderFingerprint();
+	sectHash = confreaderSectionFingerprint("s");
+	confreaderClear();
+
+	// The indentation of the continued lines doesn't change the hash of the section.
+	CHECK(writeConf(other, "[s]\nlist = one \\\ntwo \\\n  three\n[t]\nv = 2\n"));
+	CHECK(confreaderParseFile(other) == CONFREADER_OK);
+	CHECK(confreaderSectionFingerprint("s") == sectHash && confreaderFingerprint() != hash);
+	confreaderClear();
+	unlink(path);
+	unlink(other);
+}
+
+static void testLookupCache(){
+	char path[64], other[64];
+
+	CHECK(writeConf(path, "[s]\nk = 1\n"));
+	CHECK(writeConf(other, "[s]\nk = 2\n"));
+	confreaderOptions = CONFREADER_OPT_LOOKUP_CACHE;
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetInt("k", "s", 0) == 1 && confreaderGetInt("k", "s", 0) == 1);
+	confreaderClear();
+	CHECK(confreaderParseFile(other) == CONFREADER_OK);
+	CHECK(confreaderGetInt("k", "s", 0) == 2);
+	confreaderClear();
+	confreaderOptions = 0;
+	unlink(path);
+	unlink(other);
+}
+
+static void testFreeze(){
+	char path[64];
+
+	CHECK(writeConf(path, "port = 80\n[s]\nq = \"a\\tb\"\nt = 5s\n"));
+	CHECK(confreaderParseFile(path) == CONFREADER_OK);
+	CHECK(confreaderGetDuration("t", "s", 0) == 5000);
+	CHECK(confreaderFreeze() == CONFREADER_OK);
+	CHECK(confreaderGetInt("port", NULL, 0) == 80 && same(confreaderGetString("q", "s", NULL), "a\tb"));
+	CHECK(confreaderGetDuration("t", "s", 0) == 5000);
+	CHECK(confreaderApplyOverrides(NULL, NULL, 0, NULL) == CONFREADER_ERROR && confreaderErrorNum == CONFREADER_EBUSY);
+	confreaderClear();
+	CHECK(!confreaderHas("port", NULL));
+	unlink(path);
+}
+
+int main(){
+	testUnits();
+	testEnum();
+	testNetwork();
+	testArrays();
+	testQuoted();
+	testContinuation();
+	testEncoding();
+	testAllErrors();
+	testSchema();
+	testPatchFile();
+	testJson();
+	testOverrides();
+	testAliases();
+	testMissing();
+	testProfile();
+	testReplicate();
+	testFingerprint();
+	testLookupCache();
+	testFreeze();
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures > 0 ? 1 : 0;
+}
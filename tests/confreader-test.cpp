@@ -0,0 +1,711 @@
+/*
+confreader-test - checks the features of confreader.hpp on small files written to /tmp.
+
+Each test writes a file, parses it and checks the values, the errors and the written files. The failed
+checks are printed with their line, the program returns 1 if any check failed.
+
+Build and run:
+g++ -std=c++17 -O2 -Wall -o confreader-test confreader-test.cpp && ./confreader-test
+
+The getEnum() test needs C++14, the string_view test needs C++17, they are skipped with an older standard.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <new>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../confreader.hpp"
+
+static int checks;
+static int failures;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *text, int line){
+	checks++;
+	if(!ok){
+		failures++;
+		printf("line %d: %s\n", line, text);
+	}
+}
+
+static bool same(const char *a, const char *b){
+	return a != nullptr && b != nullptr && strcmp(a, b) == 0;
+}
+
+// Writes the text to a new file in /tmp, the name is put into path.
+static bool writeConf(char *path, const char *text){
+	int fd;
+	ssize_t len = strlen(text);
+
+	strcpy(path, "/tmp/confreader-test.XXXXXX");
+	if((fd = mkstemp(path)) == -1) return false;
+	if(write(fd, text, len) != len){
+		close(fd);
+		unlink(path);
+		return false;
+	}
+	close(fd);
+	return true;
+}
+
+// Reads the whole file into a buffer which the caller frees.
+static char * readConf(const char *path){
+	char *buf;
+	long size;
+	FILE *f;
+
+	if((f = fopen(path, "rb")) == nullptr) return nullptr;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if((buf = (char *)malloc(size + 1)) != nullptr){
+		if(fread(buf, 1, size, f) != (size_t)size) size = 0;
+		buf[size] = 0;
+	}
+	fclose(f);
+	return buf;
+}
+
+static void testUnits(){
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "t1 = 250ms\nt2 = 2 min\nt3 = 100\nb1 = 64MiB\nb2 = 2KB\nr1 = 10k/s\nr2 = 120/min\nbad = 5 parsecs\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getDuration("t1") == 250 && conf.getDuration("t2") == 120000 && conf.getDuration("t3") == 100);
+	CHECK(conf.getDuration("t1") == 250);		// From the cache.
+	CHECK(conf.getBytes("b1") == 64LL * 1024 * 1024 && conf.getBytes("b2") == 2000);
+	CHECK(conf.getRate("r1") == 10000.0 && conf.getRate("r2") == 2.0);
+	CHECK(conf.getDuration("bad", nullptr, 7) == 7 && conf.errorNum == CONFREADER_EINVVAL);
+	CHECK(conf.getDuration("missing", nullptr, 9) == 9 && conf.errorNum == CONFREADER_ENOPARAM);
+	CHECK(same(conf.getString("t2"), "2 min"));		// The text is not changed.
+	unlink(path);
+}
+
+#if __cplusplus >= 201402L
+enum class Level { Debug, Info, Warning };
+
+static void testEnum(){
+	static constexpr auto levels = Confreader::enumMap<Level>({{"debug", Level::Debug}, {"info", Level::Info}, {"warning", Level::Warning}});
+	static constexpr auto renamed = Confreader::enumMap<Level>({{"warning", Level::Debug}});
+	alignas(8) unsigned char table[sizeof(levels)];
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "l1 = WARNING\nl2 = verbose\nl3 = warning\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getEnum("l1", nullptr, levels, Level::Info) == Level::Warning);
+	CHECK(conf.getEnum("l1", nullptr, levels, Level::Info) == Level::Warning);
+	CHECK(conf.getEnum("l2", nullptr, levels, Level::Info) == Level::Info && conf.errorNum == CONFREADER_EINVVAL);
+
+	// A smaller table at the address of the cached one, as on the stack, doesn't use the index of the other.
+	CHECK(conf.getEnum("l3", nullptr, *new(table) auto(levels), Level::Info) == Level::Warning);
+	CHECK(conf.getEnum("l3", nullptr, *new(table) auto(renamed), Level::Info) == Level::Debug);
+	unlink(path);
+}
+#endif
+
+static void testNetwork(){
+	char path[64];
+	Confreader conf;
+	Confreader::IpAddr ip;
+	Confreader::Endpoint ep;
+	const Confreader::CidrList *acl;
+
+	CHECK(writeConf(path,
+		"server = 192.168.0.60\n"
+		"listen = [::1]:8080\n"
+		"plain = 10.0.0.1\n"
+		"zero = 10.0.0.1:0\n"
+		"zero6 = [::]:0\n"
+		"allow = 10.0.0.0/8, 192.168.0.0/16, fd00::/8\n"
+		"bad = 10.0.0.0/33\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getIpAddr("server", nullptr, &ip) && ip.family == AF_INET && ip.addr[0] == 192 && ip.addr[3] == 60);
+	CHECK(conf.getEndpoint("listen", nullptr, &ep, 80) && ep.addr.sa.sa_family == AF_INET6 && ntohs(ep.addr.sin6.sin6_port) == 8080);
+
+	// The default port is for a value without a port, an explicit :0 is kept, also when the value is cached.
+	CHECK(conf.getEndpoint("plain", nullptr, &ep, 80) && ntohs(ep.addr.sin.sin_port) == 80);
+	CHECK(conf.getEndpoint("plain", nullptr, &ep, 81) && ntohs(ep.addr.sin.sin_port) == 81);
+	CHECK(conf.getEndpoint("zero", nullptr, &ep, 80) && ntohs(ep.addr.sin.sin_port) == 0);
+	CHECK(conf.getEndpoint("zero", nullptr, &ep, 80) && ntohs(ep.addr.sin.sin_port) == 0);
+	CHECK(conf.getEndpoint("zero6", nullptr, &ep, 80) && ntohs(ep.addr.sin6.sin6_port) == 0);
+
+	CHECK((acl = conf.getCidrList("allow")) != nullptr && acl->count == 3);
+	if(acl){
+		CHECK(Confreader::cidrMatch(acl, &ip));
+		CHECK(conf.getIpAddr("server", nullptr, &ip));
+		ip.addr[0] = 172;
+		CHECK(!Confreader::cidrMatch(acl, &ip));
+	}
+	CHECK(conf.getCidrList("bad") == nullptr && conf.errorNum == CONFREADER_EINVVAL);
+	// The value is cached as an address, the list is kept next to it.
+	CHECK((acl = conf.getCidrList("server")) != nullptr && acl->count == 1);
+	CHECK(conf.getCidrList("server") == acl);
+	CHECK(conf.getIpAddr("server", nullptr, &ip) && ip.addr[0] == 192);
+	if(acl) CHECK(Confreader::cidrMatch(acl, &ip));
+	unlink(path);
+}
+
+static void testArrays(){
+	char path[64], text[16384];
+	Confreader conf;
+	long long ints[4];
+	double doubles[8];
+	const long long *all;
+	int count, len, i;
+
+	len = sprintf(text, "ints = 10, 20 30,-40\ndoubles = 0.5 1.5 -2.25\nbad = 1, x\nttl = 250\nlong = ");
+	for(i=0; i<1000; i++) len += sprintf(&text[len], "%d%s", i * 123456, i < 999 ? "," : "\n");
+	CHECK(writeConf(path, text));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getIntArray("ints", nullptr, ints, 4) == 4 && ints[0] == 10 && ints[3] == -40);
+	CHECK(conf.getIntArray("ints", nullptr, ints, 2) == 4);
+	CHECK(conf.getDoubleArray("doubles", nullptr, doubles, 8) == 3 && doubles[2] == -2.25);
+	CHECK(conf.getIntArray("bad", nullptr, ints, 4) == -1);
+	CHECK(conf.getIntArray("bad", nullptr, &count) == nullptr);
+	CHECK((all = conf.getIntArray("long", nullptr, &count)) != nullptr && count == 1000 && all[999] == 999LL * 123456);
+	CHECK(conf.getIntArray("long", nullptr, &count) == all);
+
+	// A value cached as another type is decoded into an entry chained to the cache.
+	CHECK(conf.getDoubleArray("long", nullptr, &count) != nullptr && count == 1000);
+	CHECK(conf.getIntArray("long", nullptr, &count) == all);
+	CHECK(conf.getDuration("ttl") == 250);
+	CHECK((all = conf.getIntArray("ttl", nullptr, &count)) != nullptr && count == 1 && all[0] == 250);
+	CHECK(conf.getIntArray("ttl", nullptr, &count) == all && conf.getDuration("ttl") == 250);
+	unlink(path);
+}
+
+static void testQuoted(){
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "plain = a b # comment\nquoted = \"  a;b # c \\t\\\"x\\\" \"\nslash = \"a \\\\\"\nempty = \"\"\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(same(conf.getString("plain"), "a b"));
+	CHECK(same(conf.getString("quoted"), "  a;b # c \t\"x\" "));
+	CHECK(conf.getString("quoted") == conf.getString("quoted"));		// Decoded once.
+	CHECK(same(conf.getString("slash"), "a \\") && same(conf.getString("empty"), ""));
+	unlink(path);
+
+	conf.clear();
+	CHECK(writeConf(path, "a = 1\nb = \"x\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EPARSINGFILE && conf.errorLineNum == 2);
+	unlink(path);
+}
+
+// Many decoded values and one larger than a block of the arena.
+static void testArena(){
+	char path[64], *text, value[64];
+	Confreader conf;
+	int len = 0, i;
+	bool ok = true;
+
+	text = (char *)malloc(5000 * 40 + 200000);
+	for(i=0; i<5000; i++) len += sprintf(&text[len], "k%d = \"v\\t%d\"\n", i, i);
+	len += sprintf(&text[len], "big = \"");
+	for(i=0; i<40000; i++) len += sprintf(&text[len], "\\n");
+	sprintf(&text[len], "\"\n");
+	CHECK(writeConf(path, text));
+	free(text);
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	for(i=0; i<5000 && ok; i++){
+		sprintf(value, "k%d", i);
+		ok = conf.getString(value) != nullptr && conf.getString(value)[0] == 'v' && conf.getString(value)[1] == '\t' && atoi(conf.getString(value) + 2) == i;
+	}
+	CHECK(ok);
+	CHECK(conf.getString("big") != nullptr && strlen(conf.getString("big")) == 40000 && conf.getString("big")[39999] == '\n');
+	unlink(path);
+}
+
+static void testContinuation(){
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path,
+		"[s]\n"
+		"list = one \\\n"
+		"    two \\\n"
+		"\tthree\n"
+		"path = C:\\dir\\\n"
+		"next = 1\n"
+		"quoted = \"a \\\\\" \n"
+		"stop = x \\\n"
+		"# comment\n"
+		"after = 2\n"
+		"text = <<END\n"
+		"line 1\n"
+		"  line 2\n"
+		"END\n"
+		"last = 3\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(same(conf.getString("list", "s"), "one two three"));
+	CHECK(same(conf.getString("path", "s"), "C:\\dir\\"));
+	CHECK(conf.getInt("next", "s") == 1);
+	CHECK(same(conf.getString("quoted", "s"), "a \\"));
+	CHECK(same(conf.getString("stop", "s"), "x \\"));
+	CHECK(conf.getInt("after", "s") == 2);
+	CHECK(same(conf.getString("text", "s"), "line 1\n  line 2"));
+	CHECK(conf.getInt("last", "s") == 3);
+	unlink(path);
+
+	// A backslash before a section header stays in the value, the header starts the section.
+	conf.clear();
+	CHECK(writeConf(path, "k = a \\\n  [t]\nm = 1\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(same(conf.getString("k"), "a \\") && conf.getInt("m", "t") == 1);
+	unlink(path);
+
+	// A block without its end marker.
+	conf.clear();
+	CHECK(writeConf(path, "text = <<END\nline\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EPARSINGFILE);
+	unlink(path);
+}
+
+static void testEncoding(){
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "\xEF\xBB\xBF" "top = 1\r\n[Sect]\nname = caf\xC3\xA9\r\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getInt("top") == 1 && same(conf.getString("name", "Sect"), "caf\xC3\xA9"));
+	unlink(path);
+
+	// The first error stops the parsing, its line and column are kept.
+	conf.clear();
+	CHECK(writeConf(path, "a = 1\nb = 2#no space\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_ERROR);
+	CHECK(conf.errorNum == CONFREADER_EPARSINGFILE && conf.errorLineNum == 2 && conf.errorColNum == 6);
+	unlink(path);
+
+	// Not valid UTF-8 with the check.
+	conf.clear();
+	conf.options = CONFREADER_OPT_CHECK_UTF8;
+	CHECK(writeConf(path, "a = caf\xC3\xA9\nb = \xFF\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EENCODING && conf.errorLineNum == 2);
+	unlink(path);
+}
+
+static void testAllErrors(){
+	char path[64];
+	Confreader conf;
+
+	// All the errors are collected, a header without the bracket skips its parameters.
+	conf.options = CONFREADER_OPT_ALL_ERRORS;
+	CHECK(writeConf(path, "a = 1\nb =\n[broken\nc = 3\n[good]\nd = \"x\n e = 5\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_ERROR);
+	CHECK(conf.diagCount == 3);
+	if(conf.diagCount == 3){
+		CHECK(conf.diags[0].lineNum == 2 && conf.diags[0].kind == CONFREADER_DIAG_NOVALUE);
+		CHECK(conf.diags[1].lineNum == 3 && conf.diags[1].kind == CONFREADER_DIAG_SECTION);
+		CHECK(conf.diags[2].lineNum == 6 && conf.diags[2].kind == CONFREADER_DIAG_QUOTE);
+	}
+	CHECK(conf.getInt("a") == 1 && !conf.has("c") && !conf.has("c", "broken") && conf.getInt("e", "good") == 5);
+	unlink(path);
+}
+
+static void testSchema(){
+	static const Confreader::SchemaEntry schema[] = {
+		{nullptr, "name", CONFREADER_TYPE_STRING, CONFREADER_SCHEMA_REQUIRED, 0, 0, "web-[0-9]*"},
+		{nullptr, "port", CONFREADER_TYPE_INT, CONFREADER_SCHEMA_RANGE, 1, 65535, nullptr},
+		{"db", "timeout", CONFREADER_TYPE_DURATION, CONFREADER_SCHEMA_RANGE | CONFREADER_SCHEMA_REQUIRED, 0, 60000, nullptr},
+		{"plugins", nullptr, 0, 0, 0, 0, nullptr},
+	};
+	static const Confreader::SchemaEntry twice[] = {
+		{"db", "timeout", CONFREADER_TYPE_DURATION, 0, 0, 0, nullptr},
+		{"DB", "Timeout", CONFREADER_TYPE_INT, 0, 0, 0, nullptr},
+	};
+	char path[64];
+	Confreader conf;
+	int i, diagCount, kinds = 0;
+
+	CHECK(writeConf(path, "name = web-12\nport = 70000\nextra = 1\n[db]\ntimeout = 2 min\n[plugins]\nanything = x\n[other]\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.validate(schema, sizeof(schema) / sizeof(schema[0])) == CONFREADER_ERROR);
+	for(i=0; i<conf.diagCount; i++){
+		kinds |= 1 << conf.diags[i].kind;
+	}
+	CHECK(conf.diagCount == 4);
+	CHECK(kinds == (1 << CONFREADER_DIAG_RANGE | 1 << CONFREADER_DIAG_UNKNOWN_KEY | 1 << CONFREADER_DIAG_UNKNOWN_SECTION));
+	// The diagnostics are added to the ones there are.
+	diagCount = conf.diagCount;
+	CHECK(conf.validate(twice, 2) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EINVVAL && conf.diagCount == diagCount);
+	unlink(path);
+}
+
+static void testPatchFile(){
+	static const Confreader::Change changes[] = {
+		{nullptr, "port", "2223"},
+		{"db", "password", nullptr},
+		{"db", "user", "has space"},
+		{"cache", "size", "64MB"},
+	};
+	static const Confreader::Change badName[] = {
+		{nullptr, "new\nkey", "1"},
+	};
+	static const Confreader::Change badSection[] = {
+		{"a]b", "key", "1"},
+	};
+	static const Confreader::Change twice[] = {
+		{"db", "user", "a"},
+		{"DB", "USER", "b"},
+	};
+	static const Confreader::Change xyz[] = {
+		{nullptr, "b", "XYZ"},
+	};
+	char path[64], other[64], *text;
+	Confreader conf, check2;
+
+	CHECK(writeConf(path, "# top\nport = 2222   # the port\n\n[db]\nuser = root\npassword = secret\n; end\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.patchFile(path, badName, 1) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EINVVAL);
+	CHECK(conf.patchFile(path, badSection, 1) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EINVVAL);
+	CHECK(conf.patchFile(path, twice, 2) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EINVVAL);
+	CHECK(conf.patchFile(path, changes, sizeof(changes) / sizeof(changes[0])) == CONFREADER_OK);
+	text = readConf(path);
+	CHECK(text != nullptr && strstr(text, "# top\n") && strstr(text, "# the port") && strstr(text, "; end") && !strstr(text, "secret"));
+	free(text);
+	CHECK(check2.parseFile(path) == CONFREADER_OK);
+	CHECK(check2.getInt("port") == 2223 && same(check2.getString("user", "db"), "has space") && !check2.has("password", "db"));
+	CHECK(check2.getBytes("size", "cache") == 64000000);
+	// The file was changed after conf parsed it.
+	CHECK(conf.patchFile(path, changes, 1) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EBUSY);
+	unlink(path);
+
+	// Another text of the same size is not patched at the offsets of the parsed one.
+	conf.clear();
+	CHECK(writeConf(path, "a = 1\nb = 2\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(writeConf(other, "b = 1\na = 2\n") && rename(other, path) == 0);
+	CHECK(conf.patchFile(path, xyz, 1) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EBUSY);
+	text = readConf(path);
+	CHECK(text != nullptr && same(text, "b = 1\na = 2\n"));
+	free(text);
+	unlink(path);
+
+	// A value that starts with = is quoted, otherwise it would be read back without it.
+	conf.clear();
+	check2.clear();
+	CHECK(writeConf(path, "k = \"=abc\"\nm = a=b\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(writeConf(other, "") && conf.writeFile(other) == CONFREADER_OK);
+	CHECK(check2.parseFile(other) == CONFREADER_OK);
+	CHECK(same(check2.getString("k"), "=abc") && same(check2.getString("m"), "a=b"));
+	unlink(other);
+	unlink(path);
+}
+
+static void testJson(){
+	char path[64], buf[256];
+	Confreader conf;
+	int len;
+
+	CHECK(writeConf(path, "a = 1\nb = \"q\\\"\\\\\"\n[s]\nc = x\xFFy\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	len = conf.toJson(nullptr, 0);
+	CHECK(len > 0 && len < (int)sizeof(buf) && conf.toJson(buf, sizeof(buf)) == len);
+	CHECK(same(buf, "{\"a\":\"1\",\"b\":\"q\\\"\\\\\",\"s\":{\"c\":\"x\\ufffdy\"}}"));
+	CHECK(conf.toJson(buf, len) == len);
+	len = conf.toFlat(buf, sizeof(buf));
+	CHECK(len > 0 && strstr(buf, "s.c=") != nullptr);
+	unlink(path);
+
+	// A value that starts with = is quoted, so k==abc doesn't read as k=abc.
+	conf.clear();
+	CHECK(writeConf(path, "k = \"=abc\"\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.toFlat(buf, sizeof(buf)) > 0 && strstr(buf, "k=\"=abc\"") != nullptr);
+	unlink(path);
+}
+
+static void testOverrides(){
+	char path[64];
+	char arg0[] = "test", arg1[] = "--conf.db.user=admin", arg2[] = "--conf.newkey=5", arg3[] = "--conf.n=7", arg4[] = "--port=9";
+	char arg5[] = "--", arg6[] = "--conf.after=1";
+	char *argv[] = {arg0, arg1, arg2, arg3, arg4, arg5, arg6};
+	Confreader conf, plain;
+
+	CHECK(writeConf(path, "port = 1\n[db]\nport = 2\nuser = root\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	setenv("CRTEST_DB_PORT", "3334", 1);
+	setenv("CRTEST_NOTHERE", "1", 1);
+	CHECK(conf.applyOverrides("CRTEST_", "conf.", 7, argv) == CONFREADER_OK);
+	CHECK(conf.getInt("port", "db") == 3334 && conf.getInt("port") == 1);
+	CHECK(same(conf.getString("user", "db"), "admin"));
+	CHECK(conf.getInt("newkey") == 5 && conf.getInt("n") == 7 && !conf.has("after") && !conf.has("nothere"));
+
+	// Without the prefix of the arguments only the environment is applied.
+	CHECK(plain.parseFile(path) == CONFREADER_OK);
+	CHECK(plain.applyOverrides("CRTEST_", nullptr, 7, argv) == CONFREADER_OK);
+	CHECK(plain.getInt("port", "db") == 3334 && same(plain.getString("user", "db"), "root") && !plain.has("newkey"));
+	unsetenv("CRTEST_DB_PORT");
+	unsetenv("CRTEST_NOTHERE");
+	unlink(path);
+}
+
+static void testAliases(){
+	static const Confreader::Alias aliases[] = {
+		{nullptr, "hostname", "host"},
+		{"db", "conn_timeout", "connect_timeout"},
+	};
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "hostname = a\n[db]\nconn_timeout = 5\n"));
+	conf.setAliases(aliases, 2);
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(same(conf.getString("host"), "a") && conf.getInt("connect_timeout", "db") == 5);
+	CHECK(conf.getInt("conn_timeout", "db") == 5 && conf.deprecatedHits >= 2);
+	unlink(path);
+}
+
+static void testMissing(){
+	char path[64], text[4096], name[32];
+	Confreader conf;
+	int len, i;
+	bool ok = true;
+
+	len = sprintf(text, "[big]\n");
+	for(i=0; i<200; i++) len += sprintf(&text[len], "key_%d = %d\n", i, i);
+	CHECK(writeConf(path, text));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	for(i=0; i<200 && ok; i++){
+		sprintf(name, "KEY_%d", i);
+		ok = conf.getInt(name, "big", -1) == i;
+	}
+	CHECK(ok);
+	CHECK(!conf.has("absent", "big") && !conf.has("key_200", "big") && !conf.has("key_1"));
+	unlink(path);
+}
+
+static void testProfile(){
+	char path[64], profile[64], *text;
+	Confreader conf, recorded;
+
+	// The later duplicate of the section a has more reads, the lookups must still find the first one.
+	CHECK(writeConf(path, "[a]\nx = 1\n[b]\ny = 1\n[a]\nx = 2\nz = 3\n"));
+	CHECK(writeConf(profile, "[a\nx = 100\n[b]\ny = 5\n[a]\nz = 50\n"));
+	CHECK(conf.setProfile(profile) == CONFREADER_OK);
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getInt("x", "a") == 1);
+	CHECK(conf.sectCount == 4 && same(conf.sects[1].name, "a") && same(conf.sects[2].name, "a") && same(conf.sects[3].name, "b"));
+	conf.setProfile(nullptr);
+
+	// The reads are recorded and saved.
+	recorded.options = CONFREADER_OPT_RECORD_ACCESS;
+	CHECK(recorded.parseFile(path) == CONFREADER_OK);
+	CHECK(recorded.getInt("y", "b") == 1 && recorded.getInt("y", "b") == 1);
+	CHECK(recorded.saveProfile(profile) == CONFREADER_OK);
+	text = readConf(profile);
+	CHECK(text != nullptr && strstr(text, "[b]") != nullptr && strstr(text, "y = 2") != nullptr);
+	free(text);
+	unlink(path);
+	unlink(profile);
+}
+
+static void testReplicate(){
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "port = 80\n[s]\nq = \"a\\tb\"\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.replicate() == CONFREADER_OK);
+	CHECK(conf.getInt("port") == 80 && same(conf.getString("q", "s"), "a\tb"));
+	CHECK(conf.replicate() == CONFREADER_OK && conf.getInt("port") == 80);
+	unlink(path);
+}
+
+static void testFingerprint(){
+	char path[64], other[64];
+	Confreader conf, same2, changed;
+
+	CHECK(writeConf(path, "[s]\nlist = one \\\n    two \\\n\tthree\nquoted = \"a \\\\\" \n[t]\nv = 1\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(same2.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.fingerprint() == same2.fingerprint() && conf.sectionFingerprint("t") == same2.sectionFingerprint("t"));
+	unlink(path);
+
+	// The indentation of the continued lines and the comments don't change the hash of the section.
+	CHECK(writeConf(other, "# comment\n[s]\nlist = one \\\ntwo \\\n  three\nquoted = \"a \\\\\"\n[t]\nv = 2\n"));
+	CHECK(changed.parseFile(other) == CONFREADER_OK);
+	CHECK(conf.sectionFingerprint("s") == changed.sectionFingerprint("s"));
+	CHECK(conf.sectionFingerprint("t") != changed.sectionFingerprint("t") && conf.fingerprint() != changed.fingerprint());
+	unlink(other);
+}
+
+static void testNames(){
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "[big]\nkey_7 = 7\nkey_42 = 42\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	{
+		using namespace confreader_literals;
+		CHECK(conf.getInt("key_7"_ck, "BIG") == 7 && conf.getInt("KEY_7"_ck, "big") == 7);
+	}
+#if __cplusplus >= 201703L
+	std::string_view name("key_42=x", 6);
+	CHECK(conf.getInt(name, "big") == 42);
+	CHECK(conf.getInt(std::string_view("key_42\0x", 8), "big", -1) == -1);
+#endif
+	unlink(path);
+}
+
+static void testLookupCache(){
+	char path[64], other[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "[s]\nk = 1\n"));
+	CHECK(writeConf(other, "[s]\nk = 2\n"));
+	conf.options = CONFREADER_OPT_LOOKUP_CACHE;
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getInt("k", "s") == 1 && conf.getInt("k", "s") == 1);
+	CHECK(!conf.has("absent", "s") && !conf.has("absent", "s"));
+	// The cached lookups of the parsed file are not used for the next one.
+	conf.clear();
+	conf.options = CONFREADER_OPT_LOOKUP_CACHE;
+	CHECK(conf.parseFile(other) == CONFREADER_OK);
+	CHECK(conf.getInt("k", "s") == 2);
+	unlink(path);
+	unlink(other);
+}
+
+static void testDerive(){
+	char path[64];
+	Confreader *base = new Confreader(), *next;
+	unsigned long long dbHash;
+
+	CHECK(writeConf(path, "port = 1\n[db]\nport = 5432\ntimeout = 5s\n[web]\nport = 80\n"));
+	CHECK(base->parseFile(path) == CONFREADER_OK);
+	dbHash = base->sectionFingerprint("db");
+	{
+		Confreader::Builder b(base);
+		CHECK(b.set("port", "db", "5433") == CONFREADER_OK);
+		CHECK(b.erase("timeout", "db") == CONFREADER_OK);
+		CHECK(b.set("size", "cache", "1MB") == CONFREADER_OK);
+		next = b.build();
+	}
+	CHECK(next != nullptr);
+	if(next){
+		CHECK(base->getInt("port", "db") == 5432 && base->has("timeout", "db"));
+		CHECK(next->getInt("port", "db") == 5433 && !next->has("timeout", "db") && next->getBytes("size", "cache") == 1000000);
+		CHECK(next->getInt("port", "web") == 80 && next->getInt("port") == 1);
+		CHECK(next->sectionFingerprint("db") != dbHash && next->sectionFingerprint("web") == base->sectionFingerprint("web"));
+		CHECK(next->applyOverrides(nullptr, nullptr, 0, nullptr) == CONFREADER_ERROR && next->errorNum == CONFREADER_EBUSY);
+	}
+	// The objects share memory and can be deleted in any order.
+	delete base;
+	if(next){
+		CHECK(next->getInt("port", "web") == 80);
+		delete next;
+	}
+	unlink(path);
+}
+
+static Confreader * parsed(const char *text){
+	char path[64];
+	Confreader *conf = new Confreader();
+
+	if(!writeConf(path, text)){
+		delete conf;
+		return nullptr;
+	}
+	if(conf->parseFile(path) != CONFREADER_OK){
+		delete conf;
+		conf = nullptr;
+	}
+	unlink(path);
+	return conf;
+}
+
+static void testHistory(){
+	static const Confreader::SchemaEntry schema[] = {
+		{"b", "w", CONFREADER_TYPE_INT, CONFREADER_SCHEMA_RANGE, 0, 3, nullptr},
+	};
+	Confreader::History history(2), kept(3);
+	Confreader *conf;
+
+	CHECK(history.current() == nullptr && history.rollback(1) == CONFREADER_ERROR);
+	CHECK(history.publish(parsed("[a]\nv = 1\n[b]\nw = 1\n")) == CONFREADER_OK);
+	CHECK(history.publish(parsed("[a]\nv = 1\n[b]\nw = 2\n")) == CONFREADER_OK);
+	CHECK(history.current()->getInt("w", "b") == 2 && history.current()->getInt("v", "a") == 1);
+	CHECK(history.rollback(1) == CONFREADER_OK && history.current()->getInt("w", "b") == 1);
+	CHECK(history.rollback(1) == CONFREADER_ERROR);
+	CHECK(history.rollback(-1) == CONFREADER_OK && history.current()->getInt("w", "b") == 2);
+	// The oldest object is dropped, the others still read their values.
+	CHECK(history.publish(parsed("[a]\nv = 3\n[b]\nw = 2\n")) == CONFREADER_OK);
+	CHECK(history.count() == 2 && history.current()->getInt("v", "a") == 3 && history.current()->getInt("w", "b") == 2);
+	history.freeRetired();
+	CHECK(history.rollback(1) == CONFREADER_OK && history.current()->getInt("v", "a") == 1);
+	CHECK(history.publish(nullptr) == CONFREADER_ERROR && history.errorNum == CONFREADER_EINVVAL);
+
+	// An object with the counters of the reads or the diagnostics is not replaced by a new one.
+	CHECK(kept.publish(parsed("[a]\nv = 1\n[b]\nw = 4\n")) == CONFREADER_OK);
+	if((conf = parsed("[a]\nv = 1\n[b]\nw = 4\n")) != nullptr){
+		conf->options |= CONFREADER_OPT_RECORD_ACCESS;
+		CHECK(conf->getInt("v", "a") == 1);
+		CHECK(kept.publish(conf) == CONFREADER_OK && kept.current() == conf && (conf->options & CONFREADER_OPT_RECORD_ACCESS));
+	}
+	if((conf = parsed("[a]\nv = 1\n[b]\nw = 4\n")) != nullptr){
+		CHECK(conf->validate(schema, 1) == CONFREADER_ERROR && conf->diagCount > 0);
+		CHECK(kept.publish(conf) == CONFREADER_OK && kept.current() == conf && conf->diagCount > 0);
+	}
+}
+
+static void testFreeze(){
+	char path[64];
+	Confreader conf;
+
+	CHECK(writeConf(path, "port = 80\n[s]\nq = \"a\\tb\"\nt = 5s\n"));
+	CHECK(conf.parseFile(path) == CONFREADER_OK);
+	CHECK(conf.getDuration("t", "s") == 5000);
+	CHECK(conf.freeze() == CONFREADER_OK);
+	CHECK(conf.getInt("port") == 80 && same(conf.getString("q", "s"), "a\tb") && conf.getDuration("t", "s") == 5000);
+	CHECK(conf.applyOverrides(nullptr, nullptr, 0, nullptr) == CONFREADER_ERROR && conf.errorNum == CONFREADER_EBUSY);
+	CHECK(conf.replicate() == CONFREADER_ERROR && conf.errorNum == CONFREADER_EBUSY);
+	CHECK(conf.freeze() == CONFREADER_OK);
+	conf.clear();
+	CHECK(!conf.has("port"));
+	unlink(path);
+}
+
+int main(){
+	testUnits();
+#if __cplusplus >= 201402L
+	testEnum();
+#endif
+	testNetwork();
+	testArrays();
+	testQuoted();
+	testArena();
+	testContinuation();
+	testEncoding();
+	testAllErrors();
+	testSchema();
+	testPatchFile();
+	testJson();
+	testOverrides();
+	testAliases();
+	testMissing();
+	testProfile();
+	testReplicate();
+	testFingerprint();
+	testNames();
+	testLookupCache();
+	testDerive();
+	testHistory();
+	testFreeze();
+
+	printf("%d checks, %d failed\n", checks, failures);
+	return failures > 0 ? 1 : 0;
+}
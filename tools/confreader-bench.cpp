@@ -0,0 +1,275 @@
+/*
+confreader-bench - reads the parameters in several threads while the file is reloaded.
+
+The reader threads call find() and getInt() with the keys of the file and some missing keys as fast as they
+can, each call is timed. Another thread parses the file again at the given rate and replaces the Confreader
+the readers use. The old one is freed when no reader uses it any more: each reader counts its calls, the
+counter is odd during a call, and the reloading thread waits for the odd counters to change.
+The readers share the Confreader as a server would, so each call also writes its errorNum, which nobody reads
+here. These writes to one cache line from all the readers are part of the measured time.
+
+The output is the percentiles of the time of the reads, the time of the reloads (parsing and waiting for
+the readers) and the high-water mark of the memory of the process.
+
+Build:
+g++ -O2 -pthread -o confreader-bench confreader-bench.cpp
+
+Usage:
+confreader-bench [-t threads] [-r reloads] [-d seconds] file
+
+-t	number of reader threads, by default the number of processors minus one
+-r	number of reloads per second, 0 for no reloads, by default 10
+-d	duration of the test in seconds, by default 5
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "../confreader.hpp"
+
+// The times are counted in buckets with 16 steps for each power of two, so a percentile is within 6%.
+#define BENCH_SUB_BITS		4
+#define BENCH_BUCKETS		((64 - BENCH_SUB_BITS) << BENCH_SUB_BITS)
+
+typedef struct histogram {
+	unsigned long long counts[BENCH_BUCKETS];
+	unsigned long long total;
+	unsigned long long max;
+} Histogram;
+
+typedef struct reader {
+	unsigned long long seq;		// Odd while the reader uses the Confreader.
+	Histogram hist;
+	char pad[64];
+} Reader;
+
+typedef struct key {
+	char *key;
+	char *section;				// nullptr for the parameters without section.
+} Key;
+
+static const char *fileName;
+static Confreader *current;
+static Reader *readers;
+static int readerCount;
+static Key *keys;
+static int keyCount;
+static bool stop = false;
+static Histogram reloadHist;
+static int reloadErrors = 0;
+
+static unsigned long long now(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void addTime(Histogram *h, unsigned long long ns){
+	int e, idx;
+
+	if(ns < (1ULL << BENCH_SUB_BITS)){
+		idx = (int)ns;
+	}else{
+		e = 63 - __builtin_clzll(ns);
+		idx = ((e - BENCH_SUB_BITS + 1) << BENCH_SUB_BITS) + (int)((ns >> (e - BENCH_SUB_BITS)) & ((1 << BENCH_SUB_BITS) - 1));
+	}
+	h->counts[idx]++;
+	h->total++;
+	if(ns > h->max) h->max = ns;
+}
+
+// The upper bound of the times of the bucket.
+static unsigned long long bucketTime(int idx){
+	int e;
+
+	if(idx < (1 << BENCH_SUB_BITS)) return idx;
+	e = (idx >> BENCH_SUB_BITS) + BENCH_SUB_BITS - 1;
+	return ((1ULL << BENCH_SUB_BITS) + (idx & ((1 << BENCH_SUB_BITS) - 1)) + 1) << (e - BENCH_SUB_BITS);
+}
+
+static unsigned long long percentile(const Histogram *h, double p){
+	unsigned long long rank, sum = 0;
+	int i;
+
+	if(h->total == 0) return 0;
+	rank = (unsigned long long)(h->total * p);
+	if(rank >= h->total) rank = h->total - 1;
+	for(i=0; i<BENCH_BUCKETS; i++){
+		sum += h->counts[i];
+		if(sum > rank) break;
+	}
+	return bucketTime(i) < h->max ? bucketTime(i) : h->max;
+}
+
+static void printTimes(const char *name, const Histogram *h){
+	printf("%-8s %12llu  p50 %8llu  p99 %8llu  p99.9 %8llu  max %10llu ns\n", name, h->total,
+		percentile(h, 0.5), percentile(h, 0.99), percentile(h, 0.999), h->max);
+}
+
+// The keys of all sections, and one missing key for each section.
+static bool collectKeys(Confreader *conf){
+	int i, j;
+
+	for(i=0; i<conf->sectCount; i++) keyCount += conf->sects[i].size + 1;
+	keys = (Key *)malloc(keyCount * sizeof(Key));
+	if(keys == nullptr) return false;
+	keyCount = 0;
+	for(i=0; i<conf->sectCount; i++){
+		for(j=0; j<=conf->sects[i].size; j++){
+			keys[keyCount].key = strdup(j < conf->sects[i].size ? conf->sects[i].params[j].key : "confreader-bench-missing");
+			keys[keyCount].section = i > 0 ? strdup(conf->sects[i].name) : nullptr;
+			if(keys[keyCount].key == nullptr || (i > 0 && keys[keyCount].section == nullptr)) return false;
+			keyCount++;
+		}
+	}
+	return true;
+}
+
+static void * readerThread(void *arg){
+	Reader *r = (Reader *)arg;
+	Confreader *conf;
+	unsigned long long start;
+	unsigned int k = (unsigned int)(r - readers) * 7919;
+	Key *key;
+
+	while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)){
+		key = &keys[k++ % keyCount];
+		start = now();
+		// The store of the counter and the load of the pointer are both SEQ_CST, like the exchange and the load
+		// in waitReaders(), so either the reloading thread sees the odd counter or the reader sees the new pointer.
+		__atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_SEQ_CST);
+		conf = __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+		if(k & 1){
+			conf->find(key->key, key->section);
+		}else{
+			conf->getInt(key->key, key->section, 0);
+		}
+		__atomic_store_n(&r->seq, r->seq + 1, __ATOMIC_RELEASE);
+		addTime(&r->hist, now() - start);
+	}
+	return nullptr;
+}
+
+// Waits until every reader which was using the old Confreader has finished the call.
+static void waitReaders(){
+	unsigned long long seq;
+	int i;
+
+	for(i=0; i<readerCount; i++){
+		seq = __atomic_load_n(&readers[i].seq, __ATOMIC_SEQ_CST);
+		if((seq & 1) == 0) continue;
+		while(__atomic_load_n(&readers[i].seq, __ATOMIC_ACQUIRE) == seq) sched_yield();
+	}
+}
+
+static void * reloadThread(void *arg){
+	int rate = *(int *)arg;
+	unsigned long long start;
+	struct timespec next;
+	Confreader *conf, *old;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while(!__atomic_load_n(&stop, __ATOMIC_RELAXED)){
+		next.tv_nsec += 1000000000L / rate;
+		while(next.tv_nsec >= 1000000000L){
+			next.tv_nsec -= 1000000000L;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+		if(__atomic_load_n(&stop, __ATOMIC_RELAXED)) break;
+
+		start = now();
+		conf = new Confreader();
+		if(conf->parseFile(fileName) != CONFREADER_OK){
+			reloadErrors++;
+			delete conf;
+			continue;
+		}
+		old = __atomic_exchange_n(&current, conf, __ATOMIC_SEQ_CST);
+		CONFREADER_PROBE(reload__swap, old, conf);
+		waitReaders();
+		delete old;
+		addTime(&reloadHist, now() - start);
+	}
+	return nullptr;
+}
+
+int main(int argc, char **argv){
+	pthread_t *threads, reloader;
+	Histogram all;
+	struct rusage usage;
+	long baseRss;
+	int rate = 10, seconds = 5, i, j, argIdx;
+
+	readerCount = (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	for(argIdx=1; argIdx<argc && argv[argIdx][0] == '-'; argIdx++){
+		if(strcmp(argv[argIdx], "-t") == 0 && argIdx + 1 < argc){
+			readerCount = atoi(argv[++argIdx]);
+		}else
+		if(strcmp(argv[argIdx], "-r") == 0 && argIdx + 1 < argc){
+			rate = atoi(argv[++argIdx]);
+		}else
+		if(strcmp(argv[argIdx], "-d") == 0 && argIdx + 1 < argc){
+			seconds = atoi(argv[++argIdx]);
+		}else{
+			argIdx = argc;
+			break;
+		}
+	}
+	if(argIdx != argc - 1 || rate < 0 || seconds <= 0){
+		fprintf(stderr, "Usage: %s [-t threads] [-r reloads] [-d seconds] file\n", argv[0]);
+		return 2;
+	}
+	if(readerCount <= 0) readerCount = 1;
+	fileName = argv[argIdx];
+
+	current = new Confreader();
+	if(current->parseFile(fileName) != CONFREADER_OK){
+		fprintf(stderr, "%s: cannot parse %s, error %d at line %d\n", argv[0], fileName, current->errorNum, current->errorLineNum);
+		return 1;
+	}
+	readers = (Reader *)calloc(readerCount, sizeof(Reader));
+	threads = (pthread_t *)malloc(readerCount * sizeof(pthread_t));
+	if(readers == nullptr || threads == nullptr || !collectKeys(current)){
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return 1;
+	}
+	getrusage(RUSAGE_SELF, &usage);
+	baseRss = usage.ru_maxrss;
+
+	for(i=0; i<readerCount; i++){
+		if(pthread_create(&threads[i], nullptr, readerThread, &readers[i]) != 0) break;
+	}
+	readerCount = i;
+	if(rate > 0 && pthread_create(&reloader, nullptr, reloadThread, &rate) != 0) rate = 0;
+	sleep(seconds);
+	__atomic_store_n(&stop, true, __ATOMIC_RELAXED);
+	for(i=0; i<readerCount; i++){
+		pthread_join(threads[i], nullptr);
+	}
+	if(rate > 0) pthread_join(reloader, nullptr);
+	getrusage(RUSAGE_SELF, &usage);
+
+	memset(&all, 0, sizeof(all));
+	for(i=0; i<readerCount; i++){
+		for(j=0; j<BENCH_BUCKETS; j++) all.counts[j] += readers[i].hist.counts[j];
+		all.total += readers[i].hist.total;
+		if(readers[i].hist.max > all.max) all.max = readers[i].hist.max;
+	}
+	printf("%s: %d parameters, %d readers, %d reloads per second, %d s\n", fileName, keyCount - current->sectCount, readerCount, rate, seconds);
+	printTimes("read", &all);
+	printTimes("reload", &reloadHist);
+	if(reloadErrors > 0) printf("reload errors %d\n", reloadErrors);
+	printf("memory   high-water %ld KB, %ld KB after the first parse\n", usage.ru_maxrss, baseRss);
+	delete current;
+	return 0;
+}
@@ -0,0 +1,41 @@
+#!/bin/sh
+# confreader-compare-size - prints the size of the code of each parser of confreader-compare.
+#
+# The program is built with only one parser, -DONLY_CONFREADER, -DONLY_INIH, -DONLY_SIMPLEINI or -DONLY_BOOST,
+# and with none of them, -DONLY_NONE. The size of a parser is the difference of the text sizes. The unused
+# functions are removed by the linker, so the sources of inih can be given for all of the builds.
+#
+# Usage:
+# sh confreader-compare-size.sh [options and sources of the parsers]
+# sh confreader-compare-size.sh -I inih -I inih/cpp -I simpleini inih/ini.c inih/cpp/INIReader.cpp
+#
+# The compiler is $CXX, by default g++.
+
+dir=$(dirname "$0")
+tmp=$(mktemp -d) || exit 1
+trap 'rm -rf "$tmp"' EXIT
+cxx=${CXX:-g++}
+
+build(){
+	p=$1
+	shift
+	$cxx -O2 -s -ffunction-sections -fdata-sections -Wl,--gc-sections -DONLY_$p -o "$tmp/$p" "$dir/confreader-compare.cpp" "$@" 2>"$tmp/$p.err"
+}
+
+textSize(){
+	size -B "$tmp/$1" | awk 'NR == 2 {print $1}'
+}
+
+if ! build NONE "$@"; then
+	cat "$tmp/NONE.err" >&2
+	exit 1
+fi
+base=$(textSize NONE)
+printf "%-12s %12s\n" parser "code bytes"
+for name in CONFREADER INIH SIMPLEINI BOOST; do
+	if build $name "$@"; then
+		printf "%-12s %12d\n" $name $(( $(textSize $name) - base ))
+	else
+		printf "%-12s not built, see the errors with -DONLY_%s\n" $name $name
+	fi
+done
@@ -0,0 +1,367 @@
+/*
+confreader-compare - compares confreader with other INI parsers on the same generated file.
+
+The parsers are inih (its INIReader class), SimpleIni and the INI reader of boost::property_tree. Each of them
+is compiled in if its header is found, the others are skipped and named in the output. If none of them is found
+the build fails, build with -DONLY_CONFREADER to measure confreader alone. For every parser the program measures:
+- the parsing speed in MB per second, the best of several runs;
+- the average time of a lookup, over all the keys of the file and as many missing keys;
+- the memory allocated with malloc() and new and not freed after the parsing, with mallinfo2() of glibc.
+
+Build:
+g++ -O2 -o confreader-compare confreader-compare.cpp
+With inih and SimpleIni:
+g++ -O2 -I inih -I inih/cpp -I simpleini -o confreader-compare confreader-compare.cpp inih/ini.c inih/cpp/INIReader.cpp
+
+The size of the code of one parser is the difference of the sizes of the program built with -DONLY_CONFREADER,
+-DONLY_INIH, -DONLY_SIMPLEINI or -DONLY_BOOST and of the program built with -DONLY_NONE. The script
+confreader-compare-size.sh builds them and prints the differences, it takes the same options and sources:
+sh confreader-compare-size.sh -I inih -I inih/cpp -I simpleini inih/ini.c inih/cpp/INIReader.cpp
+
+Usage:
+confreader-compare [-s sections] [-k keys] [-r runs]
+
+-s	number of sections of the generated file, by default 100
+-k	number of keys in each section, by default 50
+-r	number of runs of parsing and of the lookups, by default 20
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#include <malloc.h>
+
+#if !defined(ONLY_NONE) && !defined(ONLY_CONFREADER) && !defined(ONLY_INIH) && !defined(ONLY_SIMPLEINI) && !defined(ONLY_BOOST)
+#define WITH_CONFREADER
+#if __has_include("INIReader.h")
+#define WITH_INIH
+#endif
+#if __has_include("SimpleIni.h")
+#define WITH_SIMPLEINI
+#endif
+#if __has_include(<boost/property_tree/ini_parser.hpp>)
+#define WITH_BOOST
+#endif
+#endif
+#ifdef ONLY_CONFREADER
+#define WITH_CONFREADER
+#endif
+#ifdef ONLY_INIH
+#define WITH_INIH
+#endif
+#ifdef ONLY_SIMPLEINI
+#define WITH_SIMPLEINI
+#endif
+#ifdef ONLY_BOOST
+#define WITH_BOOST
+#endif
+#if !defined(ONLY_NONE) && !defined(ONLY_CONFREADER) && !defined(WITH_INIH) && !defined(WITH_SIMPLEINI) && !defined(WITH_BOOST)
+#error "None of INIReader.h, SimpleIni.h and boost/property_tree is found, give their directories with -I or build with -DONLY_CONFREADER"
+#endif
+
+#ifdef WITH_CONFREADER
+#include "../confreader.hpp"
+#endif
+#ifdef WITH_INIH
+#include "INIReader.h"
+#endif
+#ifdef WITH_SIMPLEINI
+#include "SimpleIni.h"
+#endif
+#ifdef WITH_BOOST
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/ini_parser.hpp>
+#endif
+
+typedef struct key {
+	char *section;			// nullptr for the keys without section.
+	char *key;
+	char *path;				// "section.key" for boost::property_tree.
+} Key;
+
+// The functions of one parser. get() returns the length of the value, 0 if the key is not found.
+typedef struct parser {
+	const char *name;
+	void * (*parse)(const char *filename);
+	size_t (*get)(void *conf, const Key *key);
+	void (*release)(void *conf);
+} Parser;
+
+#ifdef WITH_CONFREADER
+static void * confreaderParse(const char *filename){
+	Confreader *conf = new Confreader();
+
+	if(conf->parseFile(filename) != CONFREADER_OK){
+		delete conf;
+		return nullptr;
+	}
+	return conf;
+}
+
+static size_t confreaderGet(void *conf, const Key *key){
+	char *val = ((Confreader *)conf)->getString(key->key, key->section);
+
+	return val ? strlen(val) : 0;
+}
+
+static void confreaderRelease(void *conf){
+	delete (Confreader *)conf;
+}
+#endif
+
+#ifdef WITH_INIH
+static void * inihParse(const char *filename){
+	INIReader *conf = new INIReader(filename);
+
+	if(conf->ParseError() != 0){
+		delete conf;
+		return nullptr;
+	}
+	return conf;
+}
+
+static size_t inihGet(void *conf, const Key *key){
+	return ((INIReader *)conf)->Get(key->section ? key->section : "", key->key, "").size();
+}
+
+static void inihRelease(void *conf){
+	delete (INIReader *)conf;
+}
+#endif
+
+#ifdef WITH_SIMPLEINI
+static void * simpleIniParse(const char *filename){
+	CSimpleIniA *conf = new CSimpleIniA();
+
+	if(conf->LoadFile(filename) < 0){
+		delete conf;
+		return nullptr;
+	}
+	return conf;
+}
+
+static size_t simpleIniGet(void *conf, const Key *key){
+	const char *val = ((CSimpleIniA *)conf)->GetValue(key->section ? key->section : "", key->key, nullptr);
+
+	return val ? strlen(val) : 0;
+}
+
+static void simpleIniRelease(void *conf){
+	delete (CSimpleIniA *)conf;
+}
+#endif
+
+#ifdef WITH_BOOST
+static void * boostParse(const char *filename){
+	boost::property_tree::ptree *conf = new boost::property_tree::ptree();
+
+	try{
+		boost::property_tree::ini_parser::read_ini(filename, *conf);
+	}catch(const boost::property_tree::ptree_error &){
+		delete conf;
+		return nullptr;
+	}
+	return conf;
+}
+
+static size_t boostGet(void *conf, const Key *key){
+	boost::optional<std::string> val = ((boost::property_tree::ptree *)conf)->get_optional<std::string>(key->path);
+
+	return val ? val->size() : 0;
+}
+
+static void boostRelease(void *conf){
+	delete (boost::property_tree::ptree *)conf;
+}
+#endif
+
+static const Parser parsers[] = {
+#ifdef WITH_CONFREADER
+	{"confreader", confreaderParse, confreaderGet, confreaderRelease},
+#endif
+#ifdef WITH_INIH
+	{"inih", inihParse, inihGet, inihRelease},
+#endif
+#ifdef WITH_SIMPLEINI
+	{"SimpleIni", simpleIniParse, simpleIniGet, simpleIniRelease},
+#endif
+#ifdef WITH_BOOST
+	{"boost", boostParse, boostGet, boostRelease},
+#endif
+	{nullptr, nullptr, nullptr, nullptr}
+};
+
+// The parsers which are not compiled in.
+static const char *skipped[] = {
+#ifndef WITH_INIH
+	"inih",
+#endif
+#ifndef WITH_SIMPLEINI
+	"SimpleIni",
+#endif
+#ifndef WITH_BOOST
+	"boost",
+#endif
+	nullptr
+};
+
+static Key *keys;
+static int keyCount;
+static volatile size_t sink;
+
+static unsigned long long now(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static bool addKey(const char *section, const char *key, bool missing){
+	char path[128];
+	Key *k = &keys[keyCount++];
+
+	snprintf(path, sizeof(path), "%s%s%s", section ? section : "", section ? "." : "", key);
+	k->section = section ? strdup(section) : nullptr;
+	k->key = strdup(key);
+	k->path = strdup(path);
+	if(k->key == nullptr || k->path == nullptr || (section && k->section == nullptr)) return false;
+	if(missing) k->key[0] = k->path[strlen(path) - strlen(key)] = 'X';
+	return true;
+}
+
+// Writes the file: some keys without section, then the sections with numbers, words, addresses and comments.
+static bool generate(const char *filename, int sectCount, int keyCountPerSect, size_t *fileSize){
+	static const char *words[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel"};
+	char section[32], key[64];
+	FILE *f;
+	int i, j;
+
+	keys = (Key *)malloc(2 * (sectCount + 1) * keyCountPerSect * sizeof(Key));
+	if(keys == nullptr || (f = fopen(filename, "w")) == nullptr) return false;
+	fprintf(f, "; Generated by confreader-compare\n");
+	for(i=0; i<=sectCount; i++){
+		if(i > 0){
+			sprintf(section, "section_%d", i);
+			fprintf(f, "\n[%s]\n", section);
+		}
+		for(j=0; j<keyCountPerSect; j++){
+			sprintf(key, "key_%d_%d", i, j);
+			switch(j % 4){
+			case 0:
+				fprintf(f, "%s = %d\n", key, rand());
+				break;
+			case 1:
+				fprintf(f, "%s = %s %s %s\n", key, words[rand() % 8], words[rand() % 8], words[rand() % 8]);
+				break;
+			case 2:
+				fprintf(f, "; The address of %s\n%s = 10.%d.%d.%d:%d\n", key, key, rand() % 256, rand() % 256, rand() % 256, rand() % 65536);
+				break;
+			default:
+				fprintf(f, "%s = %d.%03d\n", key, rand() % 1000, rand() % 1000);
+			}
+			if(!addKey(i > 0 ? section : nullptr, key, false) || !addKey(i > 0 ? section : nullptr, key, true)){
+				fclose(f);
+				return false;
+			}
+		}
+	}
+	*fileSize = ftell(f);
+	return fclose(f) == 0;
+}
+
+// The memory in use by malloc(), in the heap and in the blocks mapped by it, or -1 if it is unknown.
+static long long heapUsed(){
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	struct mallinfo2 mi = mallinfo2();
+
+	return (long long)(mi.uordblks + mi.hblkhd);
+#else
+	return -1;
+#endif
+}
+
+int main(int argc, char **argv){
+	char filename[] = "/tmp/confreader-compare-XXXXXX";
+	unsigned long long start, best, total;
+	long long before, memory;
+	size_t fileSize;
+	void *conf;
+	const char **name;
+	int sectCount = 100, keyCountPerSect = 50, runs = 20, fd, i, r, argIdx;
+	const Parser *p;
+
+	for(argIdx=1; argIdx<argc; argIdx++){
+		if(strcmp(argv[argIdx], "-s") == 0 && argIdx + 1 < argc){
+			sectCount = atoi(argv[++argIdx]);
+		}else
+		if(strcmp(argv[argIdx], "-k") == 0 && argIdx + 1 < argc){
+			keyCountPerSect = atoi(argv[++argIdx]);
+		}else
+		if(strcmp(argv[argIdx], "-r") == 0 && argIdx + 1 < argc){
+			runs = atoi(argv[++argIdx]);
+		}else{
+			break;
+		}
+	}
+	if(argIdx < argc || sectCount < 0 || keyCountPerSect <= 0 || runs <= 0){
+		fprintf(stderr, "Usage: %s [-s sections] [-k keys] [-r runs]\n", argv[0]);
+		return 2;
+	}
+
+	if((fd = mkstemp(filename)) == -1){
+		fprintf(stderr, "%s: cannot create %s\n", argv[0], filename);
+		return 1;
+	}
+	close(fd);
+	srand(1);
+	if(!generate(filename, sectCount, keyCountPerSect, &fileSize)){
+		fprintf(stderr, "%s: cannot write %s\n", argv[0], filename);
+		unlink(filename);
+		return 1;
+	}
+	printf("%d sections, %d keys, %zu bytes\n\n", sectCount, keyCount / 2, fileSize);
+	printf("%-12s %12s %12s %12s\n", "parser", "parse MB/s", "lookup ns", "memory KB");
+
+	for(p=parsers; p->name; p++){
+		best = ~0ULL;
+		conf = nullptr;
+		memory = -1;
+		for(r=0; r<runs; r++){
+			if(conf) p->release(conf);
+			before = heapUsed();
+			start = now();
+			conf = p->parse(filename);
+			if(now() - start < best) best = now() - start;
+			if(conf == nullptr) break;
+			if(before >= 0) memory = heapUsed() - before;
+		}
+		if(conf == nullptr){
+			printf("%-12s cannot parse the file\n", p->name);
+			continue;
+		}
+
+		start = now();
+		for(r=0; r<runs; r++){
+			for(i=0; i<keyCount; i++) sink += p->get(conf, &keys[i]);
+		}
+		total = now() - start;
+		p->release(conf);
+
+		if(memory >= 0){
+			printf("%-12s %12.1f %12.1f %12lld\n", p->name, fileSize * 1000.0 / best, (double)total / ((double)runs * keyCount),
+				memory / 1024);
+		}else{
+			printf("%-12s %12.1f %12.1f %12s\n", p->name, fileSize * 1000.0 / best, (double)total / ((double)runs * keyCount), "-");
+		}
+	}
+	for(name=skipped; *name; name++){
+		printf("%-12s not built in\n", *name);
+	}
+	unlink(filename);
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+confreader-lint - checks the syntax of config files with confreader.
+
+Every file is parsed once with CONFREADER_OPT_ALL_ERRORS and CONFREADER_OPT_CHECK_UTF8, so all the errors
+of the file are reported, not only the first one. The files are checked by several threads, the output is
+in the order of the files on the command line.
+
+Build:
+g++ -O2 -pthread -o confreader-lint confreader-lint.cpp
+
+Usage:
+confreader-lint [-j threads] [-q] file...
+confreader-lint [-j threads] [-q] - < list_of_files
+
+-j	number of threads, by default the number of processors
+-q	don't print the errors, only the exit status
+-	read the names of the files from the standard input, one per line
+
+Exit status: 0 if all the files are valid, 1 if there are errors, 2 if the arguments are wrong.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../confreader.hpp"
+
+typedef struct result {
+	int errorNum;
+	int diagCount;
+	Confreader::Diagnostic *diags;
+} Result;
+
+static char **files;
+static int fileCount;
+static Result *results;
+static int nextFile = 0;
+
+static void * worker(void *arg){
+	Confreader conf;
+	Result *res;
+	int i;
+
+	(void)arg;
+	while((i = __atomic_fetch_add(&nextFile, 1, __ATOMIC_RELAXED)) < fileCount){
+		res = &results[i];
+		conf.options = CONFREADER_OPT_ALL_ERRORS | CONFREADER_OPT_CHECK_UTF8;
+		conf.parseFile(files[i]);
+		res->errorNum = conf.errorNum;
+		res->diagCount = 0;
+		res->diags = nullptr;
+		if(conf.diagCount > 0){
+			res->diags = (Confreader::Diagnostic *)malloc(conf.diagCount * sizeof(Confreader::Diagnostic));
+			if(res->diags == nullptr){
+				res->errorNum = CONFREADER_ENOMEM;
+			}else{
+				memcpy(res->diags, conf.diags, conf.diagCount * sizeof(Confreader::Diagnostic));
+				res->diagCount = conf.diagCount;
+			}
+		}
+		conf.clear();
+	}
+	return nullptr;
+}
+
+// Reads the names of the files from the standard input, one per line.
+static int readFileList(){
+	char line[4096];
+	char **newFiles;
+	int size = 0, cap = 0;
+	size_t len;
+
+	files = nullptr;
+	while(fgets(line, sizeof(line), stdin)){
+		len = strlen(line);
+		while(len > 0 && (line[len - 1] == 0x0A || line[len - 1] == 0x0D)) line[--len] = 0;
+		if(len == 0) continue;
+		if(size == cap){
+			cap = cap ? cap * 2 : 256;
+			newFiles = (char **)realloc(files, cap * sizeof(char *));
+			if(newFiles == nullptr) return -1;
+			files = newFiles;
+		}
+		if((files[size] = strdup(line)) == nullptr) return -1;
+		size++;
+	}
+	return size;
+}
+
+int main(int argc, char **argv){
+	pthread_t *threads;
+	int threadCount = 0, i, j, argIdx;
+	bool quiet = false;
+	int status = 0;
+
+	for(argIdx=1; argIdx<argc && argv[argIdx][0] == '-' && argv[argIdx][1] != 0; argIdx++){
+		if(strcmp(argv[argIdx], "-j") == 0 && argIdx + 1 < argc){
+			threadCount = atoi(argv[++argIdx]);
+		}else
+		if(strcmp(argv[argIdx], "-q") == 0){
+			quiet = true;
+		}else{
+			argIdx = argc;
+			break;
+		}
+	}
+	if(argIdx >= argc){
+		fprintf(stderr, "Usage: %s [-j threads] [-q] file... | -\n", argv[0]);
+		return 2;
+	}
+
+	if(strcmp(argv[argIdx], "-") == 0){
+		if((fileCount = readFileList()) < 0){
+			fprintf(stderr, "%s: out of memory\n", argv[0]);
+			return 2;
+		}
+	}else{
+		files = &argv[argIdx];
+		fileCount = argc - argIdx;
+	}
+	if(fileCount == 0) return 0;
+
+	if(threadCount <= 0) threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(threadCount <= 0) threadCount = 1;
+	if(threadCount > fileCount) threadCount = fileCount;
+
+	results = (Result *)calloc(fileCount, sizeof(Result));
+	threads = (pthread_t *)malloc(threadCount * sizeof(pthread_t));
+	if(results == nullptr || threads == nullptr){
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return 2;
+	}
+
+	// Let's start the threads, the main thread is one of them.
+	for(i=1; i<threadCount; i++){
+		if(pthread_create(&threads[i], nullptr, worker, nullptr) != 0) break;
+	}
+	threadCount = i;
+	worker(nullptr);
+	for(i=1; i<threadCount; i++){
+		pthread_join(threads[i], nullptr);
+	}
+
+	for(i=0; i<fileCount; i++){
+		if(results[i].errorNum == CONFREADER_OK) continue;
+		status = 1;
+		if(!quiet){
+			if(results[i].diagCount == 0){
+				fprintf(stdout, "%s: %s\n", files[i], results[i].errorNum == CONFREADER_ENOMEM ? "out of memory" : "cannot read the file");
+			}
+			for(j=0; j<results[i].diagCount; j++){
+				fprintf(stdout, "%s:%d:%d: %s\n", files[i], results[i].diags[j].lineNum, results[i].diags[j].colNum,
+					Confreader::diagMessage(results[i].diags[j].kind));
+			}
+		}
+		free(results[i].diags);
+	}
+	return status;
+}
@@ -0,0 +1,87 @@
+/*
+confreader-missing - times the lookups of keys which are not in a large section.
+
+A file with one section of the given number of keys is written to a temporary file and parsed. Then the
+keys which are not in the section are looked up with find() in a loop, and the time per lookup is printed.
+Without the Bloom filter of the section each of these lookups compares the key with all keys of the section.
+
+Build:
+g++ -O2 -o confreader-missing confreader-missing.cpp
+
+Usage:
+confreader-missing [-k keys] [-n lookups]
+
+-k	number of keys in the section, by default 200
+-n	number of lookups, by default 2000000
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../confreader.hpp"
+
+#define MISSING_NAMES		64		// Different missing keys, looked up in turn.
+
+static unsigned long long now(){
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]){
+	char fileName[] = "/tmp/confreader-missing.XXXXXX";
+	char missing[MISSING_NAMES][32];
+	Confreader conf;
+	unsigned long long start, ns;
+	long long lookups = 2000000, i;
+	int keyCount = 200, found = 0, opt, fd, k;
+	FILE *f;
+
+	while((opt = getopt(argc, argv, "k:n:")) != -1){
+		switch(opt){
+			case 'k': keyCount = atoi(optarg); break;
+			case 'n': lookups = atoll(optarg); break;
+			default:
+				fprintf(stderr, "Usage: %s [-k keys] [-n lookups]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	fd = mkstemp(fileName);
+	if(fd == -1 || (f = fdopen(fd, "w")) == nullptr){
+		fprintf(stderr, "Can't create a temporary file\n");
+		return 1;
+	}
+	fprintf(f, "[sect]\n");
+	for(k=0; k<keyCount; k++){
+		fprintf(f, "key_%d = %d\n", k, k);
+	}
+	fclose(f);
+	for(k=0; k<MISSING_NAMES; k++){
+		sprintf(missing[k], "absent_%d", k);
+	}
+
+	if(conf.parseFile(fileName) != CONFREADER_OK){
+		fprintf(stderr, "%s: error %d at line %d\n", fileName, conf.errorNum, conf.errorLineNum);
+		unlink(fileName);
+		return 1;
+	}
+	unlink(fileName);
+
+	start = now();
+	for(i=0; i<lookups; i++){
+		if(conf.find(missing[i & (MISSING_NAMES - 1)], "sect") != nullptr) found++;
+	}
+	ns = now() - start;
+
+	printf("keys %d  lookups %lld  found %d  total %.3f s  %.1f ns per lookup\n", keyCount, lookups, found,
+		ns / 1e9, (double)ns / (lookups > 0 ? lookups : 1));
+	return 0;
+}